@@ -85,7 +85,242 @@
 (setf (get '$inchar 'assign) 'neverset)
 (setf (get '$outchar 'assign) 'neverset)
 
-(defvar *var-tag* '("<v>" "</v>"))
+;;
+;; Sending several commands at once
+;;
+;; If evaluation is to be aborted on errors wxMaxima sends the line
+;; :lisp-quiet (wx-batch-start) in front of the first command of a batch
+;; and :lisp-quiet (wx-batch-guard) in front of every other one. Every
+;; command is sent as a single line. The guard checks if the command in
+;; front of it has got an output label: If it hasn't it has failed and
+;; the guard discards the line with the next command and so do all guards
+;; that follow in this batch. The failure itself already has printed the
+;; error message and the prompt wxMaxima waits for.
+
+(defvar *wx-batch-failed* nil)
+(defvar *wx-batch-linenum* nil)
+
+(defun wx-batch-start ()
+  (setq *wx-batch-failed* nil)
+  (setq *wx-batch-linenum* $linenum))
+
+;; The name of a label like makelabel builds it, but without registering
+;; it in $labels.
+(defun wx-batch-label (char linenum)
+  ($concat '|| char linenum))
+
+(defun wx-batch-command-failed-p (linenum)
+  (and (not $nolabels)
+       ;; kill(all) resets the line number.
+       (>= $linenum linenum)
+       ;; If the command is still running it has asked a question and
+       ;; the guard is read as the answer.
+       (not (and (= $linenum linenum)
+                 (boundp (wx-batch-label $inchar linenum))))
+       (not (boundp (wx-batch-label $outchar linenum)))))
+
+(defun wx-batch-guard ()
+  (cond (*wx-batch-failed*)
+        ((and *wx-batch-linenum*
+              (wx-batch-command-failed-p *wx-batch-linenum*))
+         (setq *wx-batch-failed* t))
+        (t
+         (setq *wx-batch-linenum* $linenum)))
+  (when *wx-batch-failed*
+    (read-line *standard-input* nil)))
+
+;;
+;; Compact framing
+;;
+;; If wxMaxima offers it during the setup math isn't sent as <mth>...</mth>
+;; but as a frame STX <length of the payload> : <payload> ETX that wxMaxima
+;; can find without searching for an end marker. In the payload SO followed
+;; by a one-character code starts an element: the code is the element's
+;; position in *wxxml-compact-tags* plus 33; other elements are written as
+;; SO SUB name US. Each attribute follows its start tag as DC1 name US value
+;; US. SI closes the innermost open element. In text and attribute values
+;; DLE followed by a character c stands for the character whose code is the
+;; one of c xor 64. This way neither a control character nor a < or & is
+;; ever sent verbatim.
+;;
+;; The emitters below produce the tokens of the current framing directly:
+;; text is escaped by wxxml-fix-string and tags that aren't constant are
+;; built by wxxml-start-tag, wxxml-end-tag and wxxml-element. Only the
+;; constant markup fragments of the emitters and of the wxxmlword and
+;; wxxmlsym properties are written as xml; each of them is translated once
+;; and then looked up in *wxxml-compact-markup*.
+;;
+;; The list of tags has to match the one in wxMaxima's XmlPullParser.cpp.
+
+(defvar *wxxml-compact-framing* nil)
+
+(defvar *wxxml-compact-tags*
+  #("mth" "v" "t" "n" "h" "p" "f" "e" "i" "g" "s" "q" "d" "a" "r"
+    "fn" "sm" "st" "in" "ie" "at" "cj" "lm" "tb" "hl" "fnm" "lbl"
+    "img" "line" "slide" "ascii" "mspace" "mtr" "mtd"))
+
+(defvar *wxxml-compact-markup* (make-hash-table :test #'equal))
+
+(defun wx-offer-framing (&rest framings)
+  "Called by wxMaxima during the setup with the framings it understands.
+Switches to compact framing if it is offered."
+  (setq *wxxml-compact-framing*
+        (if (member "compact" framings :test #'equal) t nil)))
+
+(defun wxxml-compact-char (c out)
+  (if (or (char< c #\Space) (char= c #\<) (char= c #\&))
+      (progn
+        (write-char (code-char 16) out)
+        (write-char (code-char (logxor (char-code c) 64)) out))
+      (write-char c out)))
+
+(defun wxxml-compact-open (tag out)
+  (let ((code (position tag *wxxml-compact-tags* :test #'string=)))
+    (write-char (code-char 14) out)
+    (cond (code
+           (write-char (code-char (+ code 33)) out))
+          (t
+           (write-char (code-char 26) out)
+           (write-string tag out)
+           (write-char (code-char 31) out)))))
+
+(defun wxxml-start-tag (tag &optional attributes)
+  "The start tag of an element in the current framing. attributes is a
+list of (name value) lists; the values are text that still needs escaping."
+  (if *wxxml-compact-framing*
+      (with-output-to-string (out)
+        (wxxml-compact-open tag out)
+        (dolist (attribute attributes)
+          (write-char (code-char 17) out)
+          (write-string (car attribute) out)
+          (write-char (code-char 31) out)
+          (write-string (wxxml-fix-string (cadr attribute)) out)
+          (write-char (code-char 31) out)))
+      (format nil "<~a~{ ~a=\"~a\"~}>" tag
+              (mapcan #'(lambda (attribute)
+                          (list (car attribute)
+                                (wxxml-fix-string (cadr attribute))))
+                      attributes))))
+
+(defun wxxml-end-tag (tag)
+  (if *wxxml-compact-framing*
+      (string (code-char 15))
+      (format nil "</~a>" tag)))
+
+(defun wxxml-element (tag text &optional attributes)
+  "An element containing text that already has been escaped."
+  (concatenate 'string (wxxml-start-tag tag attributes) text
+               (wxxml-end-tag tag)))
+
+;; The following functions translate xml to compact tokens. They are used
+;; for the constant markup fragments only and for the markup users pass to
+;; wxxmltag.
+
+(defun wxxml-compact-entity (s pos out)
+  "Writes the character the xml entity at pos stands for. Returns the
+position after the entity."
+  (let* ((end (position #\; s :start pos))
+         (name (if end (subseq s (1+ pos) end) ""))
+         (c (cond ((null end) nil)
+                  ((string= name "lt") #\<)
+                  ((string= name "gt") #\>)
+                  ((string= name "amp") #\&)
+                  ((string= name "quot") #\")
+                  ((string= name "apos") #\')
+                  ((and (> (length name) 2) (char= (char name 0) #\#)
+                        (char-equal (char name 1) #\x))
+                   (let ((code (parse-integer name :start 2 :radix 16
+                                              :junk-allowed t)))
+                     (and code (code-char code))))
+                  ((and (> (length name) 1) (char= (char name 0) #\#))
+                   (let ((code (parse-integer name :start 1 :junk-allowed t)))
+                     (and code (code-char code)))))))
+    (cond (c
+           (wxxml-compact-char c out)
+           (1+ end))
+          (t
+           (wxxml-compact-char #\& out)
+           (1+ pos)))))
+
+(defun wxxml-compact-text (s start end out)
+  (let ((pos start))
+    (loop while (< pos end) do
+      (if (char= (char s pos) #\&)
+          (setq pos (wxxml-compact-entity s pos out))
+          (progn
+            (wxxml-compact-char (char s pos) out)
+            (incf pos))))))
+
+(defun wxxml-compact-space-p (c)
+  (member c '(#\Space #\Tab #\Newline #\Return)))
+
+(defun wxxml-compact-attributes (s pos end out)
+  (loop
+    (setq pos (position-if-not #'wxxml-compact-space-p s :start pos :end end))
+    (unless pos (return))
+    (let* ((eq-pos (position #\= s :start pos :end end))
+           (quote-start (and eq-pos
+                             (position-if #'(lambda (c) (member c '(#\" #\')))
+                                          s :start eq-pos :end end)))
+           (quote-end (and quote-start
+                           (position (char s quote-start) s
+                                     :start (1+ quote-start) :end end))))
+      (unless quote-end (return))
+      (write-char (code-char 17) out)
+      (write-string (string-trim '(#\Space #\Tab #\Newline #\Return)
+                                 (subseq s pos eq-pos))
+                    out)
+      (write-char (code-char 31) out)
+      (wxxml-compact-text s (1+ quote-start) quote-end out)
+      (write-char (code-char 31) out)
+      (setq pos (1+ quote-end)))))
+
+(defun wxxml-compact-tag (s pos out)
+  "Converts the tag that starts at pos. Returns the position after the tag."
+  (let ((end (position #\> s :start pos)))
+    (cond
+      ((char= (char s (1+ pos)) #\/)
+       (write-char (code-char 15) out))
+      (t
+       (let* ((empty (char= (char s (1- end)) #\/))
+              (contents-end (if empty (1- end) end))
+              (name-end (or (position-if #'wxxml-compact-space-p s
+                                         :start (1+ pos) :end contents-end)
+                            contents-end)))
+         (wxxml-compact-open (subseq s (1+ pos) name-end) out)
+         (wxxml-compact-attributes s name-end contents-end out)
+         (when empty
+           (write-char (code-char 15) out)))))
+    (1+ end)))
+
+(defun wxxml-compact (s)
+  "Converts the xml string s to compact tokens."
+  (with-output-to-string (out)
+    (let ((pos 0)
+          (len (length s)))
+      (loop while (< pos len) do
+        (let ((tag-start (or (position #\< s :start pos) len)))
+          (wxxml-compact-text s pos tag-start out)
+          (setq pos (if (< tag-start len)
+                        (wxxml-compact-tag s tag-start out)
+                        len)))))))
+
+(defun wxxml-compact-fragment (x)
+  "Returns the fragment x of the output of wxxml as compact tokens."
+  (cond ((not (stringp x))
+         (wxxml-compact (princ-to-string x)))
+        ;; Tags that already have been emitted as compact tokens always
+        ;; contain a control character. Their codes might be a < or a &.
+        ((find-if #'(lambda (c) (char< c #\Space)) x)
+         x)
+        ;; Text without markup or entities
+        ((not (find-if #'(lambda (c) (or (char= c #\<) (char= c #\&))) x))
+         x)
+        (t
+         (or (gethash x *wxxml-compact-markup*)
+             (setf (gethash x *wxxml-compact-markup*) (wxxml-compact x))))))
+
+(defvar *var-tag* "v")
 
 (defun wxxml-get (x p)
   (if (symbolp x) (get x p)))
@@ -132,12 +367,15 @@
 				      (subseq x (1+ matchpos))))))
 
 (defun wxxml-fix-string (x)
-  (if (stringp x)
-      (let* ((tmp-x (string-substitute "&amp;" #\& x))
-	     (tmp-x (string-substitute "&lt;" #\< tmp-x))
-	     (tmp-x (string-substitute "&gt;" #\> tmp-x)))
-	tmp-x)
-      x))
+  (cond ((not (stringp x)) x)
+	(*wxxml-compact-framing*
+	 (with-output-to-string (out)
+	   (loop for c across x do (wxxml-compact-char c out))))
+	(t
+	 (let* ((tmp-x (string-substitute "&amp;" #\& x))
+		(tmp-x (string-substitute "&lt;" #\< tmp-x))
+		(tmp-x (string-substitute "&gt;" #\> tmp-x)))
+	   tmp-x))))
 
 ;;; First we have the functions which are called directly by wxxml and its
 ;;; descendants
@@ -152,31 +390,33 @@
 		       (setq tmp-x (wxxml-fix-string x))
 		       (if (and (boundp '$stringdisp) $stringdisp)
 			   (setq tmp-x (format nil "\"~a\"" tmp-x)))
-		       (concatenate 'string "<st>" tmp-x "</st>"))
+		       (wxxml-element "st" tmp-x))
 		      ((arrayp x)
-		       (format nil "<v>Lisp array [~{~a~^,~}]</v>"
-			       (array-dimensions x)))
+		       (wxxml-element "v" (format nil "Lisp array [~{~a~^,~}]"
+						  (array-dimensions x))))
 		      ((streamp x)
-		       (format nil "<v>Stream [~A]</v>"
-			       (stream-element-type x)))
+		       (wxxml-element "v" (wxxml-fix-string
+					   (format nil "Stream [~A]"
+						   (stream-element-type x)))))
 		      ((member (type-of x) '(GRAPH DIGRAPH))
-		       (format nil "<v>~a</v>" x))
+		       (wxxml-element "v" (wxxml-fix-string (format nil "~a" x))))
                       ((typep x 'structure-object)
-		       (format nil "<v>Structure [~A]</v>" (type-of x)))
+		       (wxxml-element "v" (wxxml-fix-string
+					   (format nil "Structure [~A]" (type-of x)))))
 		      ((hash-table-p x)
-		       (format nil "<v>HashTable</v>"))
+		       (wxxml-element "v" "HashTable"))
                       (t (wxxml-stripdollar x))))
 	  r))
 
 (defun wxxmlnumformat (atom)
   (let (r firstpart exponent)
     (cond ((integerp atom)
-           (format nil "<n>~{~c~}</n>" (exploden atom)))
+           (wxxml-element "n" (format nil "~{~c~}" (exploden atom))))
 	  (t
 	   (setq r (exploden atom))
 	   (setq exponent (member 'e r :test #'string-equal))
 	   (cond ((null exponent)
-		  (format nil "<n>~{~c~}</n>" r))
+		  (wxxml-element "n" (format nil "~{~c~}" r)))
 		 (t
 		  (setq firstpart
 			(nreverse (cdr (member 'e (reverse r)
@@ -184,9 +424,15 @@
 		  (if (char= (cadr exponent) #\+)
 		      (setq exponent (cddr exponent))
 		      (setq exponent (cdr exponent)))
-		  (format nil
-			  "<r><n>~{~c~}</n><h>*</h><e><n>10</n><n>~{~c~}</n></e></r>"
-			  firstpart exponent)))))))
+		  (concatenate 'string
+			       (wxxml-start-tag "r")
+			       (wxxml-element "n" (format nil "~{~c~}" firstpart))
+			       (wxxml-element "h" "*")
+			       (wxxml-start-tag "e")
+			       (wxxml-element "n" "10")
+			       (wxxml-element "n" (format nil "~{~c~}" exponent))
+			       (wxxml-end-tag "e")
+			       (wxxml-end-tag "r"))))))))
 
 (defun wxxml-stripdollar (sym &aux pname)
   (or (symbolp sym)
@@ -206,7 +452,7 @@
 		     (concatenate 'string "?" pname))
 		    (t pname)))
   (setq pname (wxxml-fix-string pname))
-  (concatenate 'string (car *var-tag*) pname (cadr *var-tag*)))
+  (wxxml-element *var-tag* pname))
 
 (defun wxxml-paren (x l r)
   (wxxml x (append l '("<p>")) (cons "</p>" r) 'mparen 'mparen))
@@ -248,7 +494,7 @@
 ;; sin a prefix operator
 (defun wxxml-function (x l r)
   (setq l
-	(let ((*var-tag* '("<fnm>" "</fnm>")))
+	(let ((*var-tag* "fnm"))
 	  (wxxml (caar x) (append l '("<fn>"))
 		 nil 'mparen 'mparen))
 	r (wxxml (cons '(mprogn) (cdr x)) nil (append '("</fn>") r)
@@ -314,7 +560,7 @@
 (defun wxxml-dissym-to-string (lst &aux pname)
   (setq pname
 	(wxxml-fix-string (format nil "~{~a~}" lst)))
-  (concatenate 'string "<v>" pname "</v>"))
+  (wxxml-element "v" pname))
 
 (defun wxxmlsym (x)
   (or (get x 'wxxmlsym)
@@ -643,9 +889,13 @@
 		     ((find 'inference (car x))
 		      (list "<tb inference=\"true\">"))
 		     ((find 'special (car x))
-		      (list (format nil "<tb special=\"true\" rownames=~s colnames=~s>"
-				    (if (find 'rownames (car x)) "true" "false")
-				    (if (find 'colnames (car x)) "true" "false"))))
+		      (list (wxxml-start-tag
+			     "tb"
+			     (list (list "special" "true")
+				   (list "rownames"
+					 (if (find 'rownames (car x)) "true" "false"))
+				   (list "colnames"
+					 (if (find 'colnames (car x)) "true" "false"))))))
 		     (t
 		       (list "<tb>")))
                  (mapcan #'(lambda (y)
@@ -1037,9 +1287,12 @@
          (append l
                  (if (cadr x)
                      (list
-		      (format nil "<lbl>(~A)~A </lbl>"
-			      (stripdollar (maybe-invert-string-case (symbol-name (cadr x))))
-                              *wxxml-mratp*))
+		      (wxxml-element
+		       "lbl"
+		       (wxxml-fix-string
+			(format nil "(~A)~A "
+				(stripdollar (maybe-invert-string-case (symbol-name (cadr x))))
+				*wxxml-mratp*))))
 		     nil))
          r 'mparen 'mparen))
 
@@ -1054,8 +1307,14 @@
 (defun mydispla (x)
   (let ((*print-circle* nil)
         (*wxxml-mratp* (format nil "~{~a~}" (cdr (checkrat x)))))
-    (mapc #'princ
-          (wxxml x '("<mth>") '("</mth>") 'mparen 'mparen))))
+    (if *wxxml-compact-framing*
+        (let ((payload (mapcar #'wxxml-compact-fragment
+                               (wxxml x '("<mth>") '("</mth>") 'mparen 'mparen))))
+          (format t "~c~d:" (code-char 2) (reduce #'+ payload :key #'length))
+          (mapc #'write-string payload)
+          (write-char (code-char 3)))
+        (mapc #'princ
+              (wxxml x '("<mth>") '("</mth>") 'mparen 'mparen)))))
 
 (setf *alt-display2d* 'mydispla)
 
@@ -1113,7 +1372,9 @@
   (let ((n (cadr x))
 	(k (caddr x)))
     (append l
-	    (list (format nil "<i altCopy=\"~{~a~}\"><p>" (mstring x)))
+	    (list (wxxml-start-tag "i" (list (list "altCopy"
+						    (format nil "~{~a~}" (mstring x)))))
+		  (wxxml-start-tag "p"))
 	    (wxxml n nil nil 'mparen 'mparen)
 	    (list "</p><r>")
 	    (wxxml k nil nil 'mparen 'mparen)
@@ -1127,10 +1388,11 @@
 	 (disp-name (get fun-name 'wxxml-orthopoly-disp))
 	 (args (cdr x)))
     (append l
-	    (list (format nil "<fn altCopy=\"~{~a~}\">" (mstring x)))
-	    (if (nth 2 disp-name)
-		(list (format nil "<ie><fnm>~a</fnm><r>" (car disp-name)))
-		(list (format nil "<i><fnm>~a</fnm><r>" (car disp-name))))
+	    (list (wxxml-start-tag "fn" (list (list "altCopy"
+						     (format nil "~{~a~}" (mstring x))))))
+	    (list (wxxml-start-tag (if (nth 2 disp-name) "ie" "i"))
+		  (wxxml-element "fnm" (wxxml-fix-string (car disp-name)))
+		  (wxxml-start-tag "r"))
 	    (wxxml (nth (nth 1 disp-name) args) nil nil 'mparen 'mparen)
 	    (when (nth 2 disp-name)
 	      (append (list "</r><r>")
@@ -1206,7 +1468,7 @@
 		 (t
 		  (setq p (list "(" n ")"))))
 	   (append (append l '("<r>"))
-		   (let ((*var-tag* (list "<fnm>" "</fnm>"))) (wxxml (cadr x) nil nil lop rop))
+		   (let ((*var-tag* "fnm")) (wxxml (cadr x) nil nil lop rop))
 		   p
 		   (list "</r>")  r)))
 
@@ -1240,9 +1502,13 @@
   (let ((name (cadr x))
 	(tag (caddr x))
 	(prop (cadddr x)))
-    (if prop
-	(append l (list (format nil "<~a ~a>~a</~a>" tag prop name tag)) r)
-	(append l (list (format nil "<~a>~a</~a>" tag name tag)) r))))
+    ;; name and prop are markup the user has written in xml.
+    (append l
+	    (list (let ((xml (if prop
+				 (format nil "<~a ~a>~a</~a>" tag prop name tag)
+				 (format nil "<~a>~a</~a>" tag name tag))))
+		    (if *wxxml-compact-framing* (wxxml-compact xml) xml)))
+	    r)))
 
 
 (defmvar $wxplot_old_gnuplot nil)
@@ -0,0 +1,163 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "BackgroundParser.h"
+#include "IOStatistics.h"
+
+ParserJob::ParserJob(wxString xml, int type, bool newLine, bool bigSkip,
+                     CellArena *arena)
+{
+  // wxString isn't thread-safe => make sure we don't share the data with
+  // a string that is still in use by the main thread.
+  m_xml = wxString(xml.wc_str());
+  m_type = type;
+  m_newLine = newLine;
+  m_bigSkip = bigSkip;
+  m_arena = arena;
+  if (XmlPullParser::IsCompactFrame(xml))
+    m_parseInBackground =
+      (xml.Find(XmlPullParser::CompactStartTag(wxT("img"))) == wxNOT_FOUND) &&
+      (xml.Find(XmlPullParser::CompactStartTag(wxT("slide"))) == wxNOT_FOUND);
+  else
+    m_parseInBackground = (xml.Find(wxT("<img")) == wxNOT_FOUND) &&
+      (xml.Find(wxT("<slide")) == wxNOT_FOUND);
+  m_maxLength = 0;
+  m_parseTime = 0;
+  m_displayedDigits = 100;
+  m_cell = NULL;
+}
+
+ParserJob::~ParserJob()
+{
+  if (m_cell != NULL)
+    delete m_cell;
+}
+
+BackgroundParser *BackgroundParser::s_instance = NULL;
+
+BackgroundParser::BackgroundParser(wxEvtHandler *handler, int id) :
+  wxThread(wxTHREAD_JOINABLE),
+  m_parsedCondition(m_parsedLock)
+{
+  m_handler = handler;
+  m_id = id;
+  m_pending = 0;
+  m_posted = 0;
+  m_parsed = 0;
+  m_maxLength = m_parser.GetMaxLength();
+  m_displayedDigits = m_parser.GetDisplayedDigits();
+  s_instance = this;
+}
+
+BackgroundParser::~BackgroundParser()
+{
+  if (s_instance == this)
+    s_instance = NULL;
+
+  ParserJob *job;
+  while (m_results.ReceiveTimeout(0, job) == wxMSGQUEUE_NO_ERROR)
+    delete job;
+  while (m_jobs.ReceiveTimeout(0, job) == wxMSGQUEUE_NO_ERROR)
+    delete job;
+}
+
+void BackgroundParser::CopySettings(MathParser &parser)
+{
+  m_maxLength = parser.GetMaxLength();
+  m_displayedDigits = parser.GetDisplayedDigits();
+}
+
+void BackgroundParser::Parse(wxString xml, int type, bool newLine, bool bigSkip,
+                             CellArena *arena)
+{
+  ParserJob *job = new ParserJob(xml, type, newLine, bigSkip, arena);
+  job->m_maxLength = m_maxLength;
+  job->m_displayedDigits = m_displayedDigits;
+  m_pending++;
+  m_posted++;
+  m_jobs.Post(job);
+}
+
+ParserJob *BackgroundParser::GetResult()
+{
+  ParserJob *job;
+  if (m_results.ReceiveTimeout(0, job) != wxMSGQUEUE_NO_ERROR)
+    return NULL;
+  m_pending--;
+  return job;
+}
+
+ParserJob *BackgroundParser::WaitForResult()
+{
+  if (m_pending <= 0)
+    return NULL;
+
+  ParserJob *job;
+  if (m_results.Receive(job) != wxMSGQUEUE_NO_ERROR)
+    return NULL;
+  m_pending--;
+  return job;
+}
+
+void BackgroundParser::WaitUntilIdle()
+{
+  wxMutexLocker lock(m_parsedLock);
+  while (m_parsed < m_posted)
+    m_parsedCondition.Wait();
+}
+
+void BackgroundParser::ReleaseArenas()
+{
+  if ((s_instance != NULL) && wxThread::IsMain())
+    s_instance->WaitUntilIdle();
+}
+
+void BackgroundParser::Stop()
+{
+  if (!IsRunning())
+    return;
+  m_jobs.Post(NULL);
+  Wait();
+}
+
+wxThread::ExitCode BackgroundParser::Entry()
+{
+  ParserJob *job;
+  while ((m_jobs.Receive(job) == wxMSGQUEUE_NO_ERROR) && (job != NULL))
+  {
+    if (job->m_parseInBackground)
+    {
+      m_parser.SetMaxLength(job->m_maxLength);
+      m_parser.SetDisplayedDigits(job->m_displayedDigits);
+      wxLongLong start = IOStatistics::Now();
+      CellArena::Scope arena(job->m_arena);
+      job->m_cell = m_parser.ParseLine(job->m_xml, job->m_type);
+      job->m_parseTime = IOStatistics::Now() - start;
+    }
+    {
+      wxMutexLocker lock(m_parsedLock);
+      m_parsed++;
+      m_parsedCondition.Broadcast();
+    }
+    m_results.Post(job);
+    wxQueueEvent(m_handler, new wxThreadEvent(wxEVT_THREAD, m_id));
+  }
+  return 0;
+}
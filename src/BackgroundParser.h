@@ -0,0 +1,181 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+  A worker thread that converts the xml maxima sends us into cells.
+*/
+
+#ifndef BACKGROUNDPARSER_H
+#define BACKGROUNDPARSER_H
+
+#include <wx/wx.h>
+#include <wx/thread.h>
+#include <wx/msgqueue.h>
+
+#include "MathParser.h"
+
+//! A piece of maxima's output on its way from the socket to the worksheet
+class ParserJob
+{
+public:
+  ParserJob(wxString xml, int type, bool newLine, bool bigSkip,
+            CellArena *arena);
+  //! Deletes the cells if nobody has taken them over
+  ~ParserJob();
+  //! The xml we got from maxima
+  wxString m_xml;
+  //! The type of the output (MC_TYPE_DEFAULT, ...)
+  int m_type;
+  //! Does the output have to begin in a new line?
+  bool m_newLine;
+  //! Is the output to be separated from the previous line by a big skip?
+  bool m_bigSkip;
+  /*! Can this job be parsed outside the main thread?
+
+    Images have to be loaded into wxBitmaps which only the main thread may do.
+  */
+  bool m_parseInBackground;
+  //! The maximum length of output that is to be displayed, see MathParser::SetMaxLength()
+  int m_maxLength;
+  //! The maximum number of digits of a number, see MathParser::SetDisplayedDigits()
+  int m_displayedDigits;
+  /*! The arena of the GroupCell the output will be appended to
+
+    The cells are allocated from it so that they share their blocks with
+    the rest of the output of this GroupCell. NULL means: Allocate them on
+    the heap. Is used only while the job is being parsed by the worker thread:
+    The GroupCell might be gone by the time the main thread picks up the result.
+  */
+  CellArena *m_arena;
+  //! The parsed cells or NULL, if the job hasn't been parsed yet.
+  MathCell *m_cell;
+  //! How long parsing the job took [µs]
+  wxLongLong m_parseTime;
+};
+
+/*! Parses maxima's output in a separate thread
+
+  Converting maxima's xml output into a cell tree is expensive. If a long
+  loop streams thousands of results this would make the worksheet unresponsive
+  if it was done in the main thread. Instead the main thread posts the raw
+  output to this thread that converts it into detached cell lists and sends
+  them back through a second queue. Every finished job is announced by a
+  wxThreadEvent with the id given to the constructor so all the main thread
+  still has to do is to insert the cells into the worksheet.
+
+  The jobs are processed strictly in the order they were posted in.
+
+  The cells are allocated from the arena of the GroupCell they will be
+  appended to. As an arena may only be used by one thread at a time the
+  main thread has to call WaitUntilIdle() before it allocates cells from an
+  arena a job might use itself. The owner of an arena calls ReleaseArenas()
+  before it clears or deletes it.
+*/
+class BackgroundParser : public wxThread
+{
+public:
+  /*! The constructor
+
+    \param handler The event handler that is informed when parsed output is ready
+    \param id      The id of the wxThreadEvents sent to handler
+  */
+  BackgroundParser(wxEvtHandler *handler, int id);
+  //! Deletes all jobs that haven't been picked up yet
+  ~BackgroundParser();
+
+  /*! Use the settings of parser for all jobs that are posted from now on
+
+    Is called from the main thread whenever the configuration changes: The
+    worker thread mustn't access the configuration itself.
+  */
+  void CopySettings(MathParser &parser);
+
+  /*! Queues a piece of xml for being parsed
+
+    \param arena The arena the cells are to be allocated from, see
+                 ParserJob::m_arena
+  */
+  void Parse(wxString xml, int type, bool newLine, bool bigSkip,
+             CellArena *arena);
+
+  /*! Returns the next finished job without waiting.
+
+    \return The job or NULL, if there is no finished job right now. The caller
+    has to delete the job when it is no more needed.
+  */
+  ParserJob *GetResult();
+  /*! Returns the next finished job, waiting for it if necessary
+
+    \return The job or NULL, if there are no pending jobs.
+  */
+  ParserJob *WaitForResult();
+  //! The number of jobs that have been posted but not returned by GetResult() yet
+  int Pending()
+    {
+      return m_pending;
+    }
+  /*! Waits until the thread has finished parsing all jobs that have been posted
+
+    Doesn't pick up the results: They stay in the queue for GetResult() and
+    WaitForResult(). Afterwards the thread doesn't access any arena until
+    the next job is posted.
+  */
+  void WaitUntilIdle();
+  /*! Makes sure that no job uses a CellArena that is about to be cleared or deleted
+
+    Waits until the running BackgroundParser, if there is one, is idle.
+    Does nothing if it is called from another thread than the main thread
+    that posts the jobs.
+  */
+  static void ReleaseArenas();
+  //! Asks the thread to terminate and waits until it has done so
+  void Stop();
+
+protected:
+  virtual ExitCode Entry();
+
+private:
+  //! The jobs that wait for being parsed. A NULL job terminates the thread.
+  wxMessageQueue<ParserJob *> m_jobs;
+  //! The jobs that have been parsed
+  wxMessageQueue<ParserJob *> m_results;
+  //! The number of jobs that have been posted but not returned, yet.
+  int m_pending;
+  //! The number of jobs that have been posted. Is used only by the main thread.
+  long m_posted;
+  //! The number of jobs the worker thread has finished. Is guarded by m_parsedLock.
+  long m_parsed;
+  //! Guards m_parsed
+  wxMutex m_parsedLock;
+  //! Is signalled whenever the worker thread has finished a job
+  wxCondition m_parsedCondition;
+  //! The event handler that is informed about finished jobs
+  wxEvtHandler *m_handler;
+  //! The id of the events we send
+  int m_id;
+  int m_maxLength;
+  int m_displayedDigits;
+  //! The parser. Is used only by the worker thread.
+  MathParser m_parser;
+  //! The BackgroundParser that currently exists or NULL
+  static BackgroundParser *s_instance;
+};
+
+#endif // BACKGROUNDPARSER_H
@@ -0,0 +1,132 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+
+#include "CellArena.h"
+#include <wx/tls.h>
+#include <stdlib.h>
+#include <new>
+
+//! The arena each thread currently allocates cells from
+static wxTLS_TYPE(CellArena *) s_currentArena;
+
+wxAtomicInt CellArena::s_cellsOfSize[CELLARENA_MAX_CELL_SIZE / sizeof(Header) + 1];
+bool CellArena::s_countCells = false;
+
+CellArena::CellArena()
+{
+  m_chunk = NULL;
+}
+
+CellArena::~CellArena()
+{
+  Clear();
+}
+
+void CellArena::Clear()
+{
+  if (m_chunk != NULL)
+    Release(m_chunk);
+  m_chunk = NULL;
+}
+
+void *CellArena::Allocate(size_t size)
+{
+  if (s_countCells)
+    wxAtomicInc(s_cellsOfSize[SizeIndex(size)]);
+
+  CellArena *arena = wxTLS_VALUE(s_currentArena);
+  if ((arena != NULL) && (size <= CELLARENA_MAX_CELL_SIZE))
+    return arena->AllocateHere(size);
+
+  Header *header = (Header *) ::operator new(sizeof(Header) + size);
+  header->m_chunk = NULL;
+  return header + 1;
+}
+
+void *CellArena::AllocateHere(size_t size)
+{
+  size_t needed = sizeof(Header) + Align(size);
+
+  if ((m_chunk == NULL) || (m_chunk->m_used + needed > CELLARENA_CHUNK_SIZE))
+  {
+    Clear();
+    m_chunk = (Chunk *) malloc(CELLARENA_CHUNK_SIZE);
+    if (m_chunk == NULL)
+      throw std::bad_alloc();
+    m_chunk->m_used = Align(sizeof(Chunk));
+    m_chunk->m_references = 1;
+  }
+
+  Header *header = (Header *) ((char *) m_chunk + m_chunk->m_used);
+  header->m_chunk = m_chunk;
+  m_chunk->m_used += needed;
+  wxAtomicInc(m_chunk->m_references);
+  return header + 1;
+}
+
+void CellArena::Free(void *memory, size_t size)
+{
+  if (memory == NULL)
+    return;
+
+  if (s_countCells)
+    wxAtomicDec(s_cellsOfSize[SizeIndex(size)]);
+
+  Header *header = (Header *) memory - 1;
+  if (header->m_chunk == NULL)
+    ::operator delete(header);
+  else
+    Release(header->m_chunk);
+}
+
+size_t CellArena::SizeIndex(size_t size)
+{
+  size_t index = Align(size) / sizeof(Header);
+  size_t last = CELLARENA_MAX_CELL_SIZE / sizeof(Header);
+  return index < last ? index : last;
+}
+
+void CellArena::GetStatistics(long &cells, long &bytes)
+{
+  cells = bytes = 0;
+  for (size_t i = 0; i <= CELLARENA_MAX_CELL_SIZE / sizeof(Header); i++)
+  {
+    cells += s_cellsOfSize[i];
+    bytes += (long) s_cellsOfSize[i] * (long) (i * sizeof(Header));
+  }
+}
+
+void CellArena::Release(Chunk *chunk)
+{
+  if (wxAtomicDec(chunk->m_references) == 0)
+    free(chunk);
+}
+
+CellArena::Scope::Scope(CellArena *arena)
+{
+  m_previous = wxTLS_VALUE(s_currentArena);
+  wxTLS_VALUE(s_currentArena) = arena;
+}
+
+CellArena::Scope::~Scope()
+{
+  wxTLS_VALUE(s_currentArena) = m_previous;
+}
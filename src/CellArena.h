@@ -0,0 +1,154 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+
+/*! \file
+  The definition of the class CellArena that allocates the memory for cells.
+*/
+
+#ifndef CELLARENA_H
+#define CELLARENA_H
+
+#include <wx/wx.h>
+#include <wx/atomic.h>
+
+//! The size of the memory blocks a CellArena allocates cells from [bytes]
+#define CELLARENA_CHUNK_SIZE (64 * 1024)
+//! Larger cells are allocated on the heap
+#define CELLARENA_MAX_CELL_SIZE (CELLARENA_CHUNK_SIZE / 16)
+
+/*! Allocates cells from large blocks of memory
+
+  A single result of maxima might consist of 100000 cells. Allocating each of
+  them by its own with malloc and freeing them one by one again needs a
+  considerable amount of time and fragments the heap during a long session.
+
+  A CellArena instead allocates the cells one after another from blocks of
+  CELLARENA_CHUNK_SIZE bytes. Every block counts the cells that live in it
+  and is freed as soon as the last of them is deleted, so the cells of one
+  output are freed together with a few blocks. Cells that outlive the arena
+  they have been allocated from (for example because they have been moved to
+  another GroupCell) stay valid.
+
+  MathCell::operator new() allocates the cells from the arena the current
+  thread has selected using a CellArena::Scope. If no arena has been selected
+  the cell is allocated on the heap.
+
+  Every GroupCell owns an arena for its output. Cells may be deleted by
+  any thread; An arena may only be used by one thread at a time.
+*/
+class CellArena
+{
+public:
+  CellArena();
+  //! Releases the current block: It is freed when its cells are deleted.
+  ~CellArena();
+
+  /*! Starts a new block for the next cells
+
+    The cells that already have been allocated stay valid: Their blocks are
+    freed when the last of them is deleted.
+  */
+  void Clear();
+
+  //! Allocates memory from the arena the current thread has selected
+  static void *Allocate(size_t size);
+  //! Frees memory Allocate() has returned for an object of size bytes
+  static void Free(void *memory, size_t size);
+
+  /*! Starts counting the cells for GetStatistics()
+
+    Counting needs an atomic operation for every allocation => it is only
+    done for the --cellmemory command-line switch. Has to be called before
+    the cells that are to be counted are created.
+  */
+  static void EnableStatistics() { s_countCells = true; }
+
+  /*! The number of cells that exist and the memory they take
+
+    Only the cells that have been created after EnableStatistics() are
+    counted. The memory is what the cell objects themselves take. Memory the
+    cells have allocated for their contents (like the characters of their
+    strings) isn't included.
+  */
+  static void GetStatistics(long &cells, long &bytes);
+
+  /*! Selects the arena the current thread allocates cells from
+
+    The previous selection is restored when the Scope object is deleted.
+  */
+  class Scope
+  {
+  public:
+    //! Selects arena. NULL means: Allocate cells on the heap.
+    Scope(CellArena *arena);
+    ~Scope();
+  private:
+    CellArena *m_previous;
+  };
+
+private:
+  //! The header of a block of memory cells are allocated from
+  class Chunk
+  {
+  public:
+    //! The number of bytes of the block that are in use, including this header
+    size_t m_used;
+    //! The number of cells in the block + 1 if it is the current block of an arena
+    wxAtomicInt m_references;
+  };
+  //! What precedes every allocation: The block it has been allocated from or NULL
+  union Header
+  {
+    Chunk *m_chunk;
+    // Make sure that the cell that follows the header is aligned properly.
+    double m_alignDouble;
+    long m_alignLong;
+  };
+
+  //! Not implemented: An arena can't be copied.
+  CellArena(const CellArena &arena);
+  //! Not implemented: An arena can't be copied.
+  CellArena &operator=(const CellArena &arena);
+
+  //! Allocates memory from this arena
+  void *AllocateHere(size_t size);
+  //! Rounds size up to a multiple of the alignment
+  static size_t Align(size_t size) { return (size + sizeof(Header) - 1) / sizeof(Header) * sizeof(Header); }
+  //! Decrements the reference count of chunk and frees it if it isn't used any more
+  static void Release(Chunk *chunk);
+
+  //! The block new cells are allocated from or NULL
+  Chunk *m_chunk;
+
+  /*! The number of cells of each size that currently exist
+
+    Is indexed by the size in units of sizeof(Header); Larger cells are
+    counted in the last entry. Counting per size means that only atomic
+    increments are needed for keeping the statistics.
+  */
+  static wxAtomicInt s_cellsOfSize[CELLARENA_MAX_CELL_SIZE / sizeof(Header) + 1];
+  //! Are the cells counted in s_cellsOfSize?
+  static bool s_countCells;
+  //! The entry of s_cellsOfSize cells of this size are counted in
+  static size_t SizeIndex(size_t size);
+};
+
+#endif // CELLARENA_H
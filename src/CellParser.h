@@ -25,9 +25,16 @@
 #include <wx/fontenum.h>
 
 #include "TextStyle.h"
+#include "StyleSheet.h"
 
 #include "Setup.h"
 
+/*! The context cells are laid out and drawn in
+
+  Holds the device context, the zoom factor and the region that is to be
+  drawn. The fonts and colors are taken from the StyleSheet that was current
+  when the CellParser was created so creating a CellParser is cheap.
+*/
 class CellParser
 {
 public:
@@ -52,11 +59,23 @@ public:
   }
   wxString GetFontName(int type = TS_DEFAULT);
   wxString GetSymbolFontName();
+  //! Returns a font from the style sheet's font cache
+  const wxFont &GetFont(int size, wxFontStyle style, wxFontWeight weight,
+                        bool underlined, const wxString &faceName,
+                        wxFontEncoding encoding = wxFONTENCODING_DEFAULT)
+  {
+    return m_styleSheet->GetFont(size, style, weight, underlined, faceName, encoding);
+  }
+  //! Measures text in the current font of the DC using the style sheet's cache
+  void GetTextExtent(const wxString &text, wxCoord *width, wxCoord *height,
+                     wxCoord *descent = NULL)
+  {
+    m_styleSheet->GetTextExtent(m_dc, text, width, height, descent);
+  }
   wxColour GetColor(int st);
   wxFontWeight IsBold(int st);
   wxFontStyle IsItalic(int st);
   bool IsUnderlined(int st);
-  void ReadStyle();
   void SetForceUpdate(bool force)
   {
     m_forceUpdate = force;
@@ -67,7 +86,7 @@ public:
   }
   wxFontEncoding GetFontEncoding()
   {
-    return m_fontEncoding;
+    return m_styleSheet->GetFontEncoding();
   }
   bool GetChangeAsterisk()
   {
@@ -77,44 +96,52 @@ public:
   {
     m_changeAsterisk = changeAsterisk;
   }
+  /*! May images that have to be rescaled be drawn in a lower quality for now?
+
+    True only for the worksheet: The ScaledBitmapCache will repaint them once
+    their full-quality version is ready.
+  */
+  bool PreviewImages()
+  {
+    return m_previewImages;
+  }
+  void SetPreviewImages(bool preview)
+  {
+    m_previewImages = preview;
+  }
   int GetIndent() { return m_indent; }
   void SetIndent(int indent) { m_indent = indent; }
   void SetClientWidth(int width) { m_clientWidth = width; }
   int GetClientWidth() { return m_clientWidth; }
-  int GetDefaultFontSize() { return int(m_zoomFactor * double(m_defaultFontSize)); }
-  int GetMathFontSize() { return int(m_zoomFactor * double(m_mathFontSize)); }
+  int GetDefaultFontSize() { return int(m_zoomFactor * double(m_styleSheet->GetDefaultFontSize())); }
+  int GetMathFontSize() { return int(m_zoomFactor * double(m_styleSheet->GetMathFontSize())); }
   int GetFontSize(int st)
   {
     if (st == TS_TEXT || st == TS_SUBSUBSECTION || st == TS_SUBSECTION || st == TS_SECTION || st == TS_TITLE)
-      return int(m_zoomFactor * double(m_styles[st].fontSize));
+      return int(m_zoomFactor * double(m_styleSheet->GetStyle(st).fontSize));
     return 0;
   }
   void Outdated(bool outdated) { m_outdated = outdated; }
-  bool CheckTeXFonts() { return m_TeXFonts; }
-  bool CheckKeepPercent() { return m_keepPercent; }
-  wxString GetTeXCMRI() { return m_fontCMRI; }
-  wxString GetTeXCMSY() { return m_fontCMSY; }
-  wxString GetTeXCMEX() { return m_fontCMEX; }
-  wxString GetTeXCMMI() { return m_fontCMMI; }
-  wxString GetTeXCMTI() { return m_fontCMTI; }
+  bool CheckTeXFonts() { return m_styleSheet->CheckTeXFonts(); }
+  bool CheckKeepPercent() { return m_styleSheet->CheckKeepPercent(); }
+  wxString GetTeXCMRI() { return m_styleSheet->GetTeXCMRI(); }
+  wxString GetTeXCMSY() { return m_styleSheet->GetTeXCMSY(); }
+  wxString GetTeXCMEX() { return m_styleSheet->GetTeXCMEX(); }
+  wxString GetTeXCMMI() { return m_styleSheet->GetTeXCMMI(); }
+  wxString GetTeXCMTI() { return m_styleSheet->GetTeXCMTI(); }
 private:
   int m_indent;
   double m_scale;
   double m_zoomFactor;
   wxDC& m_dc;
   int m_top, m_bottom;
-  wxString m_fontName;
-  int m_defaultFontSize, m_mathFontSize;
-  wxString m_mathFontName;
   bool m_forceUpdate;
   bool m_changeAsterisk;
+  bool m_previewImages;
   bool m_outdated;
-  bool m_TeXFonts;
-  bool m_keepPercent;
-  wxString m_fontCMRI, m_fontCMSY, m_fontCMEX, m_fontCMMI, m_fontCMTI;
   int m_clientWidth;
-  wxFontEncoding m_fontEncoding;
-  style m_styles[STYLE_NUM];
+  //! The fonts and colors
+  wxObjectDataPtr<StyleSheet> m_styleSheet;
 };
 
 #endif // CELLPARSER_H
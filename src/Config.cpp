@@ -128,6 +128,7 @@ void Config::SetProperties()
   SetTitle(_("wxMaxima configuration"));
 
   m_abortOnError->SetToolTip(_("If multiple cells are evaluated in one go: Abort evaluation if wxMaxima detects that maxima has encountered any error."));
+  m_pipelineEvaluation->SetToolTip(_("Send all commands of a cell to maxima at once instead of waiting for the result of each command before sending the next one. This makes cells with many short commands evaluate much faster. If \"Abort evaluation on error\" is switched on maxima skips the commands that follow a command that has failed. If a command makes maxima ask a question maxima takes the next command as the answer."));
   m_pollStdOut->SetToolTip(_("Once the local network link between maxima and wxMaxima has been established maxima has no reason to send any messages using the system's stdout stream so all this stream transport should be a greeting message; The lisp running maxima will send eventual error messages using the system's stderr stream instead. If this box is checked we will nonetheless watch maxima's stdout stream for messages."));
   m_maximaProgram->SetToolTip(_("Enter the path to the Maxima executable."));
   m_additionalParameters->SetToolTip(_("Additional parameters for Maxima"
@@ -150,7 +151,7 @@ void Config::SetProperties()
   m_savePanes->SetToolTip(_("Save panes layout between sessions."));
   m_usepngCairo->SetToolTip(_("The pngCairo terminal offers much better graphics quality (antialiassing and additional line styles). But it will only produce plots if the gnuplot installed on the current system actually supports it."));
   m_matchParens->SetToolTip(_("Write matching parenthesis in text controls."));
-  m_showLength->SetToolTip(_("Show long expressions in wxMaxima document."));
+  m_showLength->SetToolTip(_("Show long expressions in wxMaxima document. Output that exceeds this limit is displayed as plain text."));
   m_language->SetToolTip(_("Language used for wxMaxima GUI."));
   m_documentclass->SetToolTip(_("The document class LaTeX is instructed to use for our documents."));
   m_fixedFontInTC->SetToolTip(_("Set fixed font in text controls."));
@@ -173,6 +174,7 @@ void Config::SetProperties()
   // configuration data for this item.
   bool match = true, savePanes = false, UncompressedWXMX=true;
   bool fixedFontTC = true, changeAsterisk = false, usejsmath = true, keepPercent = true, abortOnError = true, pollStdOut = false;
+  bool pipelineEvaluation = false;
   bool enterEvaluates = false, saveUntitled = true,
     openHCaret = false, AnimateLaTeX = true, TeXExponentsAfterSubscript=false,
     flowedTextRequested = true, exportInput = true, exportContainsWXMX = false,
@@ -236,6 +238,7 @@ void Config::SetProperties()
   config->Read(wxT("usejsmath"), &usejsmath);
   config->Read(wxT("keepPercent"), &keepPercent);
   config->Read(wxT("abortOnError"), &abortOnError);
+  config->Read(wxT("pipelineEvaluation"), &pipelineEvaluation);
   config->Read(wxT("pollStdOut"), &pollStdOut);
   unsigned int i = 0;
   for (i = 0; i < LANGUAGE_NUMBER; i++)
@@ -295,6 +298,7 @@ void Config::SetProperties()
   m_useJSMath->SetValue(usejsmath);
   m_keepPercentWithSpecials->SetValue(keepPercent);
   m_abortOnError->SetValue(abortOnError);
+  m_pipelineEvaluation->SetValue(pipelineEvaluation);
   m_pollStdOut->SetValue(pollStdOut);
   m_defaultFramerate->SetValue(defaultFramerate);
   m_defaultPlotWidth->SetValue(defaultPlotWidth);
@@ -548,6 +552,10 @@ wxPanel* Config::CreateMaximaPanel()
   m_abortOnError = new wxCheckBox(panel, -1, _("Abort evaluation on error"));
   sizer->Add(m_abortOnError,0,wxALL, 5);
   sizer->Add(10,10);
+
+  m_pipelineEvaluation = new wxCheckBox(panel, -1, _("Send all commands of a cell at once"));
+  sizer->Add(m_pipelineEvaluation,0,wxALL, 5);
+  sizer->Add(10,10);
   
   m_pollStdOut = new wxCheckBox(panel, -1, _("Debug: Watch maxima's stdout stream"));
   sizer->Add(m_pollStdOut,0,wxALL, 5);
@@ -683,6 +691,7 @@ void Config::WriteSettings()
   wxString maxima = m_maximaProgram->GetValue();
   wxConfig *config = (wxConfig *)wxConfig::Get();
   config->Write(wxT("abortOnError"), m_abortOnError->GetValue());
+  config->Write(wxT("pipelineEvaluation"), m_pipelineEvaluation->GetValue());
   config->Write(wxT("pollStdOut"), m_pollStdOut->GetValue());
   config->Write(wxT("maxima"), m_maximaProgram->GetValue());
   config->Write(wxT("parameters"), m_additionalParameters->GetValue());
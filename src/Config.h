@@ -168,6 +168,7 @@ protected:
   wxComboBox* m_language;
   wxCheckBox* m_saveSize;
   wxCheckBox* m_abortOnError;
+  wxCheckBox* m_pipelineEvaluation;
   wxCheckBox* m_pollStdOut;
   wxCheckBox* m_savePanes;
   wxCheckBox* m_usepngCairo;
@@ -0,0 +1,124 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "DiagnosticsPane.h"
+#include "StyleSheet.h"
+
+#include <wx/sizer.h>
+
+enum {
+  diagnostics_list_id = 1,
+  diagnostics_timer_id
+};
+
+//! The columns of the list
+enum {
+  col_command,
+  col_total,
+  col_bytes,
+  col_wakeups,
+  col_parse,
+  col_layout,
+  col_paint
+};
+
+//! Converts a time in µs to a string in ms
+static wxString Milliseconds(wxLongLong time)
+{
+  return wxString::Format(wxT("%.1f"), time.ToDouble() / 1000.0);
+}
+
+DiagnosticsPane::DiagnosticsPane(wxWindow* parent, int id, IOStatistics *statistics) : wxPanel(parent, id)
+{
+  m_statistics = statistics;
+  m_list = new wxListCtrl(this, diagnostics_list_id, wxDefaultPosition, wxDefaultSize,
+                          wxLC_REPORT | wxLC_SINGLE_SEL);
+  m_list->InsertColumn(col_command, _("Command"));
+  m_list->InsertColumn(col_total, _("Total [ms]"), wxLIST_FORMAT_RIGHT);
+  m_list->InsertColumn(col_bytes, _("Bytes"), wxLIST_FORMAT_RIGHT);
+  m_list->InsertColumn(col_wakeups, _("Wakeups"), wxLIST_FORMAT_RIGHT);
+  m_list->InsertColumn(col_parse, _("Parse [ms]"), wxLIST_FORMAT_RIGHT);
+  m_list->InsertColumn(col_layout, _("Layout [ms]"), wxLIST_FORMAT_RIGHT);
+  m_list->InsertColumn(col_paint, _("Paint [ms]"), wxLIST_FORMAT_RIGHT);
+
+  m_cacheStatistics = new wxStaticText(this, -1, wxEmptyString);
+
+  wxFlexGridSizer * box = new wxFlexGridSizer(1);
+  box->AddGrowableCol(0);
+  box->AddGrowableRow(0);
+
+  box->Add(m_list, 0, wxEXPAND | wxALL, 0);
+  box->Add(m_cacheStatistics, 0, wxEXPAND | wxALL, 2);
+
+  SetSizer(box);
+  box->Fit(this);
+  box->SetSizeHints(this);
+
+  m_timer.SetOwner(this, diagnostics_timer_id);
+  m_timer.Start(1000);
+}
+
+DiagnosticsPane::~DiagnosticsPane()
+{
+  m_timer.Stop();
+}
+
+void DiagnosticsPane::UpdateDisplay()
+{
+  m_list->Freeze();
+  m_list->DeleteAllItems();
+  for (size_t i = 0; i < m_statistics->GetCount(); i++)
+  {
+    const IOCommandStatistics &record = m_statistics->Get(i);
+    wxString command = record.m_command;
+    command.Replace(wxT("\n"), wxT(" "));
+    long item = m_list->InsertItem(i, command);
+    m_list->SetItem(item, col_total, Milliseconds(record.GetTotalTime()));
+    m_list->SetItem(item, col_bytes, wxString::Format(wxT("%lu"), record.m_bytes));
+    m_list->SetItem(item, col_wakeups, wxString::Format(wxT("%lu"), record.m_wakeups));
+    m_list->SetItem(item, col_parse, Milliseconds(record.m_parseTime));
+    m_list->SetItem(item, col_layout, Milliseconds(record.m_layoutTime));
+    m_list->SetItem(item, col_paint, Milliseconds(record.m_paintTime));
+  }
+  if (m_list->GetItemCount() > 0)
+    m_list->EnsureVisible(m_list->GetItemCount() - 1);
+  m_list->Thaw();
+}
+
+void DiagnosticsPane::OnTimer(wxTimerEvent &ev)
+{
+  // Refilling the list makes it flicker => we only do so if there is
+  // something new.
+  if (!IsShownOnScreen())
+    return;
+
+  if (m_statistics->Changed())
+    UpdateDisplay();
+
+  wxObjectDataPtr<StyleSheet> styleSheet = StyleSheet::Get();
+  const TextExtentCache &cache = styleSheet->GetTextExtentCache();
+  m_cacheStatistics->SetLabel(wxString::Format(_("Text extent cache: %lu hits, %lu misses, %lu entries"),
+                                               cache.GetHits(), cache.GetMisses(),
+                                               (unsigned long) cache.GetCount()));
+}
+
+BEGIN_EVENT_TABLE(DiagnosticsPane, wxPanel)
+  EVT_TIMER(diagnostics_timer_id, DiagnosticsPane::OnTimer)
+END_EVENT_TABLE()
@@ -0,0 +1,55 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+
+  This file contains the definition of the class DiagnosticsPane that displays
+  the IOStatistics.
+ */
+#include <wx/wx.h>
+#include <wx/listctrl.h>
+
+#include "IOStatistics.h"
+
+#ifndef DIAGNOSTICSPANE_H
+#define DIAGNOSTICSPANE_H
+
+/*! This class generates a pane that shows where the time each command took was spent
+
+  The pane polls the statistics once a second while it is visible.
+ */
+class DiagnosticsPane : public wxPanel
+{
+public:
+  DiagnosticsPane(wxWindow* parent, int id, IOStatistics *statistics);
+  ~DiagnosticsPane();
+  //! Re-reads the statistics
+  void UpdateDisplay();
+  void OnTimer(wxTimerEvent &ev);
+private:
+  wxListCtrl *m_list;
+  //! Shows how well the text extent cache works
+  wxStaticText *m_cacheStatistics;
+  IOStatistics *m_statistics;
+  wxTimer m_timer;
+  DECLARE_EVENT_TABLE()
+};
+
+#endif // DIAGNOSTICSPANE_H
@@ -193,11 +193,10 @@ void EditorCell::RecalculateWidths(CellParser& parser, int fontsize)
   if (m_height == -1 || m_width == -1 || fontsize != m_fontSize || parser.ForceUpdate())
   {
     m_fontSize = fontsize;
-    wxDC& dc = parser.GetDC();
     double scale = parser.GetScale();
     SetFont(parser, fontsize);
 
-    dc.GetTextExtent(wxT("X"), &m_charWidth, &m_charHeight);
+    parser.GetTextExtent(wxT("X"), &m_charWidth, &m_charHeight);
 
     unsigned int newLinePos = 0, prevNewLinePos = 0;
     int width = 0, width1, height1;
@@ -213,7 +212,7 @@ void EditorCell::RecalculateWidths(CellParser& parser, int fontsize)
         newLinePos++;
       }
 
-      dc.GetTextExtent(m_text.SubString(prevNewLinePos, newLinePos), &width1, &height1);
+      parser.GetTextExtent(m_text.SubString(prevNewLinePos, newLinePos), &width1, &height1);
       width = MAX(width, width1);
 
       while (newLinePos < m_text.Length() && m_text.GetChar(newLinePos) == '\n')
@@ -475,7 +474,7 @@ void EditorCell::Draw(CellParser& parser, wxPoint point1, int fontsize)
                     TextCurrentPoint.x + SCALE_PX(2, scale),
                     TextCurrentPoint.y); */
         
-        dc.GetTextExtent(TextToDraw, &width, &height);
+        parser.GetTextExtent(TextToDraw, &width, &height);
         TextCurrentPoint.x += width;
       }
     }
@@ -490,7 +489,7 @@ void EditorCell::Draw(CellParser& parser, wxPoint point1, int fontsize)
 
       PositionToXY(m_positionOfCaret, &caretInColumn, &caretInLine);
 
-      int lineWidth = GetLineWidth(dc, caretInLine, caretInColumn);
+      int lineWidth = GetLineWidth(parser, caretInLine, caretInColumn);
 
       dc.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_CURSOR), 1, wxPENSTYLE_SOLID))); //TODO is there more efficient way to do this?
 #if defined(__WXMAC__)
@@ -532,12 +531,12 @@ void EditorCell::SetFont(CellParser& parser, int fontsize)
   m_underlined = parser.IsUnderlined(m_textStyle);
   m_fontEncoding = parser.GetFontEncoding();
 
-  dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                    m_fontStyle,
-                    m_fontWeight,
-                    m_underlined,
-                    m_fontName,
-                    m_fontEncoding));
+  dc.SetFont(parser.GetFont(fontsize1,
+                            m_fontStyle,
+                            m_fontWeight,
+                            m_underlined,
+                            m_fontName,
+                            m_fontEncoding));
 }
 
 void EditorCell::SetForeground(CellParser& parser)
@@ -1828,7 +1827,7 @@ wxPoint EditorCell::PositionToPoint(CellParser& parser, int pos)
 
   PositionToXY(pos, &cX, &cY);
 
-  width = GetLineWidth(dc, cY, cX);
+  width = GetLineWidth(parser, cY, cX);
   
   x += width;
   y += m_charHeight * cY;
@@ -1841,12 +1840,13 @@ void EditorCell::SelectPointText(wxDC& dc, wxPoint& point)
   wxString s;
   int fontsize1 = m_fontSize;
 
-  dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                    m_fontStyle,
-                    m_fontWeight,
-                    m_underlined,
-                    m_fontName,
-                    m_fontEncoding));
+  wxObjectDataPtr<StyleSheet> styleSheet = StyleSheet::Get();
+  dc.SetFont(styleSheet->GetFont(fontsize1,
+                                 m_fontStyle,
+                                 m_fontWeight,
+                                 m_underlined,
+                                 m_fontName,
+                                 m_fontEncoding));
 
   ClearSelection();
   wxPoint translate(point);
@@ -1862,8 +1862,8 @@ void EditorCell::SelectPointText(wxDC& dc, wxPoint& point)
   while (m_positionOfCaret < (signed)m_text.Length() && m_text.GetChar(m_positionOfCaret) != '\n')
   {
     s = m_text.SubString(lineStart, m_positionOfCaret);
-    dc.GetTextExtent(m_text.SubString(lineStart, m_positionOfCaret),
-                                      &width, &height);
+    styleSheet->GetTextExtent(dc, m_text.SubString(lineStart, m_positionOfCaret),
+                              &width, &height);
     if (width > translate.x)
       break;
 
@@ -1907,12 +1907,13 @@ bool EditorCell::IsPointInSelection(wxDC& dc, wxPoint point)
   wxString s;
   int fontsize1 = m_fontSize;
 
-  dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                    m_fontStyle,
-                    m_fontWeight,
-                    m_underlined,
-                    m_fontName,
-                    m_fontEncoding));
+  wxObjectDataPtr<StyleSheet> styleSheet = StyleSheet::Get();
+  dc.SetFont(styleSheet->GetFont(fontsize1,
+                                 m_fontStyle,
+                                 m_fontWeight,
+                                 m_underlined,
+                                 m_fontName,
+                                 m_fontEncoding));
   wxPoint translate(point);
   translate.x -= m_currentPoint.x - 2;
   translate.y -= m_currentPoint.y - 2 - m_center;
@@ -1923,8 +1924,8 @@ bool EditorCell::IsPointInSelection(wxDC& dc, wxPoint point)
   while (m_text.GetChar(positionOfCaret) != '\n' && positionOfCaret < (signed)m_text.Length())
   {
     s = m_text.SubString(lineStart, positionOfCaret);
-    dc.GetTextExtent(m_text.SubString(lineStart, positionOfCaret),
-                                      &width, &height);
+    styleSheet->GetTextExtent(dc, m_text.SubString(lineStart, positionOfCaret),
+                              &width, &height);
     if (width > translate.x)
       break;
     positionOfCaret++;
@@ -2111,7 +2112,7 @@ void EditorCell::PasteFromClipboard(bool primary)
     wxTheClipboard->UsePrimarySelection(false);
 }
 
-int EditorCell::GetLineWidth(wxDC& dc, int line, int pos)
+int EditorCell::GetLineWidth(CellParser& parser, int line, int pos)
 {
   if (pos == 0)
     return 0;
@@ -2142,14 +2143,14 @@ int EditorCell::GetLineWidth(wxDC& dc, int line, int pos)
     StyledText textSnippet = styledText.front();
     styledText.pop_front();
     text = textSnippet.GetText();
-    dc.GetTextExtent(text, &textWidth, &textHeight);
+    parser.GetTextExtent(text, &textWidth, &textHeight);
     width += textWidth;
     pos -= text.Length();
   }
 
   if (pos<0) {
     width -= textWidth;
-    dc.GetTextExtent(text.SubString(0, text.Length() + pos), &textWidth, &textHeight);
+    parser.GetTextExtent(text.SubString(0, text.Length() + pos), &textWidth, &textHeight);
     width += textWidth;
   }
 
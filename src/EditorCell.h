@@ -165,7 +165,7 @@ public:
   }
   bool FindMatchingQuotes();
   void FindMatchingParens();
-  int GetLineWidth(wxDC& dc, int line, int end);
+  int GetLineWidth(CellParser& parser, int line, int end);
   //! true, if this cell's width has to be recalculated.
   bool IsDirty()
   {
@@ -38,6 +38,7 @@ EvaluationQueue::EvaluationQueue()
   m_size = 0;
   m_queue = NULL;
   m_last = NULL;
+  m_commandsSent = 0;
   m_workingGroupChanged = false;
 }
 
@@ -46,18 +47,15 @@ void EvaluationQueue::Clear()
   while(!Empty())
     RemoveFirst();
   m_size = 0;
+  m_commandsSent = 0;
   m_workingGroupChanged = false;
 }
 
 bool EvaluationQueue::IsInQueue(GroupCell* gr)
 {
-  EvaluationQueueElement* tmp = m_queue;
-  while (tmp != NULL) {
-    if (tmp->group == gr)
-      return true;
-    tmp = tmp->next;
-  }
-  return false;
+  // The cells count how often they are queued => we don't need to scan
+  // the queue.
+  return (gr != NULL) && gr->IsInEvaluationQueue();
 }
 
 void EvaluationQueue::AddToQueue(GroupCell* gr)
@@ -67,6 +65,7 @@ void EvaluationQueue::AddToQueue(GroupCell* gr)
       || gr->GetEditable() == NULL) // dont add cells which can't be evaluated
     return;
   EvaluationQueueElement* newelement = new EvaluationQueueElement(gr);
+  gr->InEvaluationQueue(true);
   if (m_last == NULL)
     m_queue = m_last = newelement;
   else {
@@ -104,6 +103,8 @@ void EvaluationQueue::RemoveFirst()
   {
     m_workingGroupChanged = false;
     m_tokens.RemoveAt(0);
+    if(m_commandsSent > 0)
+      m_commandsSent--;
   }
   else
   {
@@ -116,6 +117,7 @@ void EvaluationQueue::RemoveFirst()
     else
       m_queue = m_queue->next;
     
+    tmp->group->InEvaluationQueue(false);
     delete tmp;
     m_size--;
     if(!Empty())
@@ -212,6 +214,14 @@ void EvaluationQueue::AddTokens(wxString commandString)
     m_tokens.Add(token);
 }
 
+void EvaluationQueue::RemoveSentCommand(size_t index)
+{
+  if(index >= m_commandsSent)
+    return;
+  m_tokens.RemoveAt(index);
+  m_commandsSent--;
+}
+
 GroupCell* EvaluationQueue::GetCell()
 {
   if(!m_tokens.IsEmpty())
@@ -231,10 +241,10 @@ GroupCell* EvaluationQueue::GetCell()
   }
 }
 
-wxString EvaluationQueue::GetCommand()
+wxString EvaluationQueue::GetCommand(size_t index)
 {
   wxString retval;
-  if(!m_tokens.IsEmpty())
-    retval = m_tokens[0];
+  if(index < m_tokens.GetCount())
+    retval = m_tokens[index];
   return retval;
 }
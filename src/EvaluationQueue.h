@@ -49,6 +49,8 @@ class EvaluationQueue
 {
 private:
   wxArrayString m_tokens;
+  //! The number of commands at the start of m_tokens that already have been sent to maxima
+  size_t m_commandsSent;
   int m_size;
   EvaluationQueueElement* m_queue;
   EvaluationQueueElement* m_last;
@@ -67,6 +69,12 @@ public:
   void AddHiddenTreeToQueue(GroupCell* gr);
   //! Removes the first cell in the queue
   void RemoveFirst();
+  /*! Removes a command that has been sent to maxima but won't be evaluated
+
+    \param index 0 = the first command that has been sent and so on. Commands
+    that haven't been sent aren't removed.
+  */
+  void RemoveSentCommand(size_t index);
   /*! Gets the cell the next command in the queue belongs to
 
     The command itself can be read out by issuing GetCommand();
@@ -76,8 +84,30 @@ public:
   bool Empty();
   //! Clear the queue
   void Clear();
-  //! Return the next command that needs to be evaluated.
-  wxString GetCommand();
+  /*! Return the next command that needs to be evaluated.
+
+    \param index 0 = the next command, 1 = the one after it and so on. Only
+    commands that belong to the same cell can be accessed this way.
+  */
+  wxString GetCommand(size_t index = 0);
+  //! The number of commands from the current cell that still wait for being evaluated
+  size_t CommandsLeftInCell()
+    {
+      return m_tokens.GetCount();
+    }
+  /*! Remember that the first count commands have already been sent to maxima
+
+    RemoveFirst() decrements this number again and Clear() resets it to 0.
+   */
+  void SetCommandsSent(size_t count)
+    {
+      m_commandsSent = count;
+    }
+  //! The number of commands from the queue maxima hasn't sent back a prompt for yet.
+  size_t CommandsSent()
+    {
+      return m_commandsSent;
+    }
   
   //! Get the size of the queue
   int Size()
@@ -135,7 +135,7 @@ void FracCell::RecalculateWidths(CellParser& parser, int fontsize)
 
     int height;
     int fontsize1 = (int) ((double)(fontsize) * scale + 0.5);
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
+    dc.SetFont(parser.GetFont(fontsize1,
     		wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
     		parser.GetFontName(TS_VARIABLE)));
     dc.GetTextExtent(wxT("/"), &m_expDivideWidth, &height);
@@ -149,9 +149,9 @@ void FracCell::RecalculateWidths(CellParser& parser, int fontsize)
     // next minus.
     int dummy = 0;
     int fontsize1 = (int) ((double)(fontsize) * scale + 0.5);
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
-                      parser.GetFontName(TS_VARIABLE)));
+    dc.SetFont(parser.GetFont(fontsize1,
+                              wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
+                              parser.GetFontName(TS_VARIABLE)));
     dc.GetTextExtent(wxT("X"), &m_horizontalGap, &dummy);
     m_horizontalGap /= 2;
 
@@ -220,7 +220,7 @@ void FracCell::Draw(CellParser& parser, wxPoint point, int fontsize)
       m_denom->DrawList(parser, denom, fontsize);
 
       int fontsize1 = (int) ((double)(fontsize) * scale + 0.5);
-      dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
+      dc.SetFont(parser.GetFont(fontsize1,
     		  wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
     		  parser.GetFontName(TS_VARIABLE)));
       dc.DrawText(wxT("/"),
@@ -123,8 +123,8 @@ wxString FunCell::ToString()
 {
   if (m_isBroken)
     return wxEmptyString;
-  if (m_altCopyText != wxEmptyString)
-    return m_altCopyText + MathCell::ListToString();
+  if (m_altCopyText != NULL)
+    return *m_altCopyText + MathCell::ListToString();
   wxString s = m_nameCell->ListToString() + m_argCell->ListToString();
   return s;
 }
@@ -25,11 +25,13 @@
 #include <wx/clipbrd.h>
 #include "MarkDown.h"
 #include "GroupCell.h"
+#include "GroupLayout.h"
 #include "SlideShowCell.h"
 #include "TextCell.h"
 #include "EditorCell.h"
 #include "ImgCell.h"
 #include "Bitmap.h"
+#include "BackgroundParser.h"
 #include "list"
 
 GroupCell::GroupCell(int groupType, wxString initString) : MathCell()
@@ -52,6 +54,10 @@ GroupCell::GroupCell(int groupType, wxString initString) : MathCell()
   m_groupType = groupType;
   m_lastInOutput = NULL;
   m_appendedCells = NULL;
+  m_layout = NULL;
+  m_layoutIndex = 0;
+  m_layoutVersion = 0;
+  m_inEvaluationQueue = 0;
 
   // set up cell depending on groupType, so we have a working cell
   if (groupType != GC_TYPE_PAGEBREAK) {
@@ -128,6 +134,8 @@ GroupCell::GroupCell(int groupType, wxString initString) : MathCell()
 
 GroupCell::~GroupCell()
 {
+  // The background parser might still allocate cells from m_outputArena.
+  BackgroundParser::ReleaseArenas();
   if (m_input != NULL)
     delete m_input;
   DestroyOutput();
@@ -192,6 +200,13 @@ void GroupCell::DestroyOutput(bool destroyFirst)
     m_lastInOutput = NULL;
     m_appendedCells = NULL;
   }
+
+  m_lines.clear();
+
+  // The blocks the deleted cells were allocated from are freed now => the
+  // next output starts a new one.
+  BackgroundParser::ReleaseArenas();
+  m_outputArena.Clear();
 }
 
 void GroupCell::ResetInputLabel()
@@ -225,7 +240,10 @@ MathCell* GroupCell::Copy()
   if (m_input)
     tmp->SetInput(m_input->CopyList());
   if (m_output != NULL)
+  {
+    CellArena::Scope arena(tmp->GetOutputArena());
     tmp->SetOutput(m_output->CopyList());
+  }
 
   return tmp;
 }
@@ -288,6 +306,7 @@ void GroupCell::SetOutput(MathCell *output)
 
   m_output = output;
   m_output->SetParent(this);
+  m_lines.clear();
 
   m_lastInOutput = m_output;
 
@@ -364,6 +383,7 @@ void GroupCell::RecalculateWidths(CellParser& parser, int fontsize)
     }
 
     UnBreakUpCells();
+    m_lines.clear();
 
     double scale = parser.GetScale();
     m_input->RecalculateWidthsList(parser, fontsize);
@@ -422,30 +442,18 @@ void GroupCell::RecalculateSize(CellParser& parser, int fontsize)
 
       m_outputRect.x = m_currentPoint.x;
       m_outputRect.y = m_currentPoint.y - m_output->GetMaxCenter();
-      m_outputRect.width = 0;
-      m_outputRect.height = 0;
-      m_height = m_input->GetMaxHeight();
-      m_width = m_input->GetFullWidth(scale);
-
-      tmp = m_output;
-      while (tmp != NULL) {
-        if (tmp->BreakLineHere() || tmp == m_output) {
-          m_width = MAX(m_width, tmp->GetLineWidth(scale));
-          m_outputRect.width = MAX(m_outputRect.width, tmp->GetLineWidth(scale));
-          m_height += tmp->GetMaxHeight();
-          if (tmp->m_bigSkip)
-            m_height += MC_LINE_SKIP;
-          m_outputRect.height += tmp->GetMaxHeight() + MC_LINE_SKIP;
-        }
-        tmp = tmp->m_nextToDraw;
-      }
+      m_lines.clear();
+      UpdateOutputLines(m_output, scale);
     }
+    else
+      m_lines.clear();
+    RecalculateOutputSize(scale);
   }
 
   m_appendedCells = NULL;
 }
 
-// We assume that appended cells will be in a new line!
+// Only lays out the cells that have been appended and the line they belong to.
 void GroupCell::RecalculateAppended(CellParser& parser)
 {
   if (m_appendedCells == NULL)
@@ -472,19 +480,11 @@ void GroupCell::RecalculateAppended(CellParser& parser)
     tmp = tmp->m_next;
   }
 
-  // Update widths
-  tmp = m_appendedCells;
-  while (tmp != NULL) {
-    if (tmp->BreakLineHere() || tmp == m_appendedCells) {
-      m_width = MAX(m_width, tmp->GetLineWidth(scale));
-      m_outputRect.width = MAX(m_outputRect.width, tmp->GetLineWidth(scale));
-      m_height += tmp->GetMaxHeight();
-      if (tmp->m_bigSkip)
-        m_height += MC_LINE_SKIP;
-      m_outputRect.height += tmp->GetMaxHeight() + MC_LINE_SKIP;
-    }
-    tmp = tmp->m_nextToDraw;
-  }
+  // Only the new lines and the line the cells might have been appended to
+  // have to be measured.
+  if (!m_hide)
+    UpdateOutputLines(m_appendedCells, scale);
+  RecalculateOutputSize(scale);
 
   m_appendedCells = NULL;
 }
@@ -537,41 +537,32 @@ void GroupCell::Draw(CellParser& parser, wxPoint point, int fontsize)
       parser.Outdated(((EditorCell *)(m_input->m_next))->ContainsChanges());
 
     if (m_output != NULL && !m_hide) {
-      MathCell *tmp = m_output;
-      int drop = tmp->GetMaxDrop();
       in.y += m_input->GetMaxDrop() + m_output->GetMaxCenter();
       m_outputRect.y = in.y - m_output->GetMaxCenter();
       m_outputRect.x = in.x;
 
-      while (tmp != NULL) {
+      if (m_lines.empty())
+        UpdateOutputLines(m_output, scale);
 
-        if (!tmp->m_isBroken) {
-          tmp->m_currentPoint.x = in.x;
-          tmp->m_currentPoint.y = in.y;
-          if (tmp->DrawThisCell(parser, in))
-            tmp->Draw(parser, in, MAX(tmp->IsMath() ? m_mathFontSize : m_fontSize, MC_MIN_SIZE));
-          if (tmp->m_nextToDraw != NULL) {
-            if (tmp->m_nextToDraw->BreakLineHere()) {
-              in.x = m_indent;
-              in.y += drop + tmp->m_nextToDraw->GetMaxCenter();
-              if (tmp->m_bigSkip)
-                in.y += MC_LINE_SKIP;
-              drop = tmp->m_nextToDraw->GetMaxDrop();
-            } else
-              in.x += (tmp->GetWidth() + MC_CELL_SKIP);
-          }
-
-        } else {
-          if (tmp->m_nextToDraw != NULL && tmp->m_nextToDraw->BreakLineHere()) {
-            in.x = m_indent;
-            in.y += drop + tmp->m_nextToDraw->GetMaxCenter();
-            if (tmp->m_bigSkip)
-              in.y += MC_LINE_SKIP;
-            drop = tmp->m_nextToDraw->GetMaxDrop();
-          }
-        }
+      // Only the lines that intersect the region that is redrawn are looked at.
+      int top = parser.GetTop();
+      int bottom = parser.GetBottom();
+      bool all = (top == -1) || (bottom == -1);
+      size_t line = all ? 0 : FindOutputLine(top - m_outputRect.y);
+      for (; line < m_lines.size(); line++)
+      {
+        if (!all && (m_outputRect.y + m_lines[line].m_y - m_lines[line].m_center > bottom))
+          break;
 
-        tmp = tmp->m_nextToDraw;
+        PlaceOutputLine(line);
+        MathCell *end = OutputLineEnd(line);
+        for (MathCell *tmp = m_lines[line].m_start; (tmp != NULL) && (tmp != end);
+             tmp = tmp->m_nextToDraw)
+        {
+          if (!tmp->m_isBroken && tmp->DrawThisCell(parser, tmp->m_currentPoint))
+            tmp->Draw(parser, tmp->m_currentPoint,
+                      MAX(tmp->IsMath() ? m_mathFontSize : m_fontSize, MC_MIN_SIZE));
+        }
       }
     }
 
@@ -634,8 +625,51 @@ void GroupCell::Draw(CellParser& parser, wxPoint point, int fontsize)
   MathCell::Draw(parser, point, fontsize);
 }
 
+void GroupCell::ResetSize()
+{
+  MathCell::ResetSize();
+  if (m_layout != NULL)
+    m_layout->SetDirty(this);
+}
+
+void GroupCell::SetLayout(GroupLayout *layout, size_t index)
+{
+  m_layout = layout;
+  m_layoutIndex = index;
+  m_layoutVersion = layout->GetVersion();
+}
+
+void GroupCell::UpdateYPosition()
+{
+  if ((m_layout == NULL) || (m_layoutVersion == m_layout->GetVersion()))
+    return;
+
+  m_layoutVersion = m_layout->GetVersion();
+  // Cells that aren't part of the worksheet any more keep their position.
+  if (!m_layout->Contains(this, m_layoutIndex))
+    return;
+
+  int y = m_layout->GetY(m_layoutIndex);
+  if (m_outputRect.y != -1)
+    m_outputRect.y += y - m_currentPoint.y;
+  m_currentPoint.y = y;
+}
+
+wxRect GroupCell::GetRect(bool all)
+{
+  UpdateYPosition();
+  return MathCell::GetRect(all);
+}
+
+int GroupCell::GetCurrentY()
+{
+  UpdateYPosition();
+  return m_currentPoint.y;
+}
+
 wxRect GroupCell::HideRect()
 {
+  UpdateYPosition();
   return wxRect(m_currentPoint.x - 10, m_currentPoint.y - m_center, 10, 10);
 }
 
@@ -1060,17 +1094,26 @@ void GroupCell::SelectRectInOutput(wxRect& rect, wxPoint& one, wxPoint& two,
   }
 
   // Lets select a rectangle
-  tmp = m_output;
   *first = *last = NULL;
 
-  while (tmp != NULL && !rect.Intersects(tmp->GetRect()))
-    tmp = tmp->m_nextToDraw;
-  *first = tmp;
-  *last = tmp;
-  while (tmp != NULL) {
-    if (rect.Intersects(tmp->GetRect()))
-      *last = tmp;
-    tmp = tmp->m_nextToDraw;
+  // Only the lines the rectangle touches can contain cells that are selected.
+  UpdateYPosition();
+  for (size_t line = FindOutputLine(rect.GetTop() - m_outputRect.y);
+       (line < m_lines.size()) &&
+       (m_outputRect.y + m_lines[line].m_y - m_lines[line].m_center <= rect.GetBottom());
+       line++)
+  {
+    PlaceOutputLine(line);
+    MathCell *end = OutputLineEnd(line);
+    for (tmp = m_lines[line].m_start; (tmp != NULL) && (tmp != end); tmp = tmp->m_nextToDraw)
+    {
+      if (rect.Intersects(tmp->GetRect()))
+      {
+        if (*first == NULL)
+          *first = tmp;
+        *last = tmp;
+      }
+    }
   }
 
   if (*first != NULL && *last != NULL) {
@@ -1157,6 +1200,124 @@ void GroupCell::BreakLines(MathCell *cell, int fullWidth)
   }
 }
 
+void GroupCell::UpdateOutputLines(MathCell *start, double scale)
+{
+  if (m_lines.empty())
+    start = m_output;
+  else if (!start->BreakLineHere())
+  {
+    // The cells have been appended to the last line => it has to be measured again.
+    start = m_lines.back().m_start;
+    m_lines.pop_back();
+    start->CalculateLineMetrics(scale, true);
+  }
+
+  for (MathCell *tmp = start; tmp != NULL; tmp = tmp->m_nextToDraw)
+  {
+    if ((tmp == start) || tmp->BreakLineHere())
+    {
+      OutputLine line;
+      line.m_start = tmp;
+      line.m_width = tmp->GetLineWidth(scale);
+      line.m_center = tmp->GetMaxCenter();
+      line.m_drop = tmp->GetMaxDrop();
+      line.m_bigSkip = false;
+      if (m_lines.empty())
+        line.m_y = line.m_center;
+      else
+      {
+        OutputLine &previous = m_lines.back();
+        line.m_y = previous.m_y + previous.m_drop + line.m_center;
+        if (previous.m_bigSkip)
+          line.m_y += MC_LINE_SKIP;
+      }
+      m_lines.push_back(line);
+    }
+    // The gap after a line depends on its last cell.
+    m_lines.back().m_bigSkip = tmp->m_bigSkip;
+  }
+}
+
+void GroupCell::RecalculateOutputSize(double scale)
+{
+  m_width = m_input->GetFullWidth(scale);
+  m_height = m_input->GetMaxHeight();
+  m_outputRect.width = 0;
+  m_outputRect.height = 0;
+
+  for (size_t i = 0; i < m_lines.size(); i++)
+  {
+    OutputLine &line = m_lines[i];
+    m_width = MAX(m_width, line.m_width);
+    m_outputRect.width = MAX(m_outputRect.width, line.m_width);
+    m_height += line.m_center + line.m_drop;
+    if (line.m_start->m_bigSkip)
+      m_height += MC_LINE_SKIP;
+    m_outputRect.height += line.m_center + line.m_drop + MC_LINE_SKIP;
+  }
+}
+
+size_t GroupCell::FindOutputLine(int y)
+{
+  size_t low = 0, high = m_lines.size();
+  while (low < high)
+  {
+    size_t middle = (low + high) / 2;
+    if (m_lines[middle].m_y + m_lines[middle].m_drop < y)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+void GroupCell::PlaceOutputLine(size_t index)
+{
+  wxPoint point(index == 0 ? m_outputRect.x : m_indent,
+                m_outputRect.y + m_lines[index].m_y);
+  MathCell *end = OutputLineEnd(index);
+  for (MathCell *tmp = m_lines[index].m_start; (tmp != NULL) && (tmp != end);
+       tmp = tmp->m_nextToDraw)
+  {
+    if (tmp->m_isBroken)
+      continue;
+    tmp->m_currentPoint = point;
+    point.x += tmp->GetWidth() + MC_CELL_SKIP;
+  }
+}
+
+void GroupCell::PlaceOutputCells(MathCell *start, MathCell *end)
+{
+  if ((m_output == NULL) || m_hide || m_lines.empty() || (start == NULL))
+    return;
+
+  // The output starts where Draw() places it.
+  m_outputRect.y = GetCurrentY() + m_input->GetMaxDrop();
+  m_outputRect.x = m_currentPoint.x;
+
+  // The line start belongs to begins with the last line break in front of it.
+  MathCell *lineStart = start;
+  while ((lineStart != m_output) && !lineStart->BreakLineHere() &&
+         (lineStart->m_previousToDraw != NULL))
+    lineStart = lineStart->m_previousToDraw;
+
+  size_t line = 0;
+  while ((line < m_lines.size()) && (m_lines[line].m_start != lineStart))
+    line++;
+
+  for (; line < m_lines.size(); line++)
+  {
+    PlaceOutputLine(line);
+    MathCell *lineEnd = OutputLineEnd(line);
+    for (MathCell *tmp = m_lines[line].m_start; (tmp != NULL) && (tmp != lineEnd);
+         tmp = tmp->m_nextToDraw)
+    {
+      if (tmp == end)
+        return;
+    }
+  }
+}
+
 void GroupCell::SelectOutput(MathCell **start, MathCell **end)
 {
   if (m_hide)
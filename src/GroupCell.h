@@ -30,9 +30,12 @@
 
 #include "MathCell.h"
 #include "EditorCell.h"
+#include <vector>
 
 #define EMPTY_INPUT_LABEL wxT("-->  ")
 
+class GroupLayout;
+
 enum
 {
   GC_TYPE_CODE,
@@ -72,6 +75,13 @@ public:
   // selection methods
   void SelectInner(wxRect& rect, MathCell** first, MathCell** last);
   void SelectPoint(wxPoint& rect, MathCell** first, MathCell** last);
+  /*! Sets the positions of the output cells from start to end
+
+    Draw() only places the lines of output it draws => the cells of other
+    lines might still be at an outdated position or have none, yet. This
+    places all lines the cells from start to end are part of.
+  */
+  void PlaceOutputCells(MathCell *start, MathCell *end);
   void SelectOutput(MathCell **start, MathCell **end);
   void SelectRectInOutput(wxRect& rect, wxPoint& one, wxPoint& two, MathCell **first, MathCell **last);
   void SelectRectGroup(wxRect& rect, wxPoint& one, wxPoint& two, MathCell **first, MathCell **last);
@@ -86,6 +96,13 @@ public:
     but it will remove eventual error messages attached to the image.
   */
   void RemoveOutput();
+  /*! The arena the output of this cell is to be allocated from
+
+    Is selected using a CellArena::Scope while maxima's output for this cell
+    is converted to cells so that the cells of one output lie next to each
+    other and are freed in a few large blocks.
+  */
+  CellArena *GetOutputArena() { return &m_outputArena; }
   // exporting
   wxString ToTeX(wxString imgDir, wxString filename, int *imgCounter);
   wxString ToTeX();
@@ -98,6 +115,31 @@ public:
   void Hide(bool hide);
   void SwitchHide();
   wxRect HideRect();
+  //! Also tells the GroupLayout that this cell has to be laid out again
+  void ResetSize();
+  wxRect GetRect(bool all = false);
+  int GetCurrentY();
+  /*! Tells the cell which GroupLayout knows its position
+
+    Is called by GroupLayout::Rebuild().
+   */
+  void SetLayout(GroupLayout *layout, size_t index);
+  //! The index of this cell in its GroupLayout
+  size_t GetLayoutIndex() { return m_layoutIndex; }
+  //! Is this cell waiting for being evaluated?
+  bool IsInEvaluationQueue() { return m_inEvaluationQueue > 0; }
+  /*! Tells the cell that it has been added to or removed from the evaluation queue
+
+    Is called by EvaluationQueue only. As a cell can be queued more than once
+    the calls are counted.
+   */
+  void InEvaluationQueue(bool inQueue)
+  {
+    if (inQueue)
+      m_inEvaluationQueue++;
+    else if (m_inEvaluationQueue > 0)
+      m_inEvaluationQueue--;
+  }
   // raw manipulation of GC (should be protected)
   void SetInput(MathCell *input);
   void SetOutput(MathCell *output);
@@ -108,7 +150,11 @@ public:
   MathCell* GetLabel() { return m_output; }
   MathCell* GetOutput() { if (m_output == NULL) return NULL; else return m_output->m_next; }
   //
-  wxRect GetOutputRect() { return m_outputRect; }
+  wxRect GetOutputRect()
+  {
+    UpdateYPosition();
+    return m_outputRect;
+  }
   void RecalculateSize(CellParser& parser, int fontsize);
   void RecalculateWidths(CellParser& parser, int fontsize);
   void Recalculate(CellParser& parser, int d_fontsize, int m_fontsize);
@@ -190,7 +236,8 @@ public:
   void Number(int &section, int &subsection, int &subsubsection, int &image);
   /*! Recalculate the cell dimensions after appending new lines.
 
-    Won't work if text has been added to the end of the line instead.
+    Only the new cells and the last line of the old output are measured
+    again. The new cells are wrapped as if they began a new line.
    */
   void RecalculateAppended(CellParser& parser);
   void Draw(CellParser& parser, wxPoint point, int fontsize);
@@ -225,7 +272,59 @@ protected:
   int m_mathFontSize;
   MathCell *m_lastInOutput;
   MathCell *m_appendedCells;
+  //! The memory the output cells are allocated from
+  CellArena m_outputArena;
   wxRect m_outputRect;
+  //! A line of the output
+  class OutputLine
+  {
+  public:
+    //! The first cell of the line
+    MathCell *m_start;
+    //! The distance between the top of the output and the center of this line
+    int m_y;
+    int m_width;
+    int m_center;
+    int m_drop;
+    //! Is the line followed by a bigger gap?
+    bool m_bigSkip;
+  };
+  /*! The lines of the output, top to bottom
+
+    Drawing and selecting only look at the lines that are visible or touched.
+    Is empty if the output hasn't been laid out yet.
+  */
+  std::vector<OutputLine> m_lines;
+  /*! Adds the lines of output that begin with start to m_lines
+
+    If start continues the last line this line is measured again.
+  */
+  void UpdateOutputLines(MathCell *start, double scale);
+  //! Calculates the size of this cell from the size of its input and m_lines
+  void RecalculateOutputSize(double scale);
+  /*! The index of the first line of output whose bottom is at or below y
+
+    y is relative to the top of the output. Returns m_lines.size() if there
+    is no such line. O(log n).
+  */
+  size_t FindOutputLine(int y);
+  //! Sets the positions of the cells of a line of output
+  void PlaceOutputLine(size_t index);
+  //! The first cell after a line of output or NULL
+  MathCell *OutputLineEnd(size_t index)
+  {
+    return (index + 1 < m_lines.size()) ? m_lines[index + 1].m_start : NULL;
+  }
+  //! Moves this cell to the position m_layout has calculated for it
+  void UpdateYPosition();
+  //! The GroupLayout that knows our position or NULL
+  GroupLayout *m_layout;
+  //! Our index in m_layout
+  size_t m_layoutIndex;
+  //! The GroupLayout::GetVersion() our position was updated at
+  unsigned long m_layoutVersion;
+  //! How often this cell is contained in the evaluation queue
+  int m_inEvaluationQueue;
 };
 
 #endif /* GROUPCELL_H */
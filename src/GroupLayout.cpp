@@ -0,0 +1,195 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "GroupLayout.h"
+#include "GroupCell.h"
+
+GroupLayout::GroupLayout()
+{
+  m_valid = false;
+  m_version = 0;
+}
+
+void GroupLayout::Invalidate()
+{
+  m_valid = false;
+  m_version++;
+  m_groups.clear();
+  m_fenwick.clear();
+  m_heights.clear();
+  m_centers.clear();
+  m_widths.clear();
+  m_sortedWidths.clear();
+  m_dirty.clear();
+  m_isDirty.clear();
+}
+
+bool GroupLayout::IsValid(GroupCell *tree, GroupCell *last)
+{
+  if (!m_valid)
+    return false;
+  if (m_groups.empty())
+    return tree == NULL;
+  return (m_groups.front() == tree) && (m_groups.back() == last);
+}
+
+void GroupLayout::Rebuild(GroupCell *tree)
+{
+  Invalidate();
+
+  for (GroupCell *tmp = tree; tmp != NULL; tmp = dynamic_cast<GroupCell *>(tmp->m_next))
+  {
+    tmp->SetLayout(this, m_groups.size());
+    m_groups.push_back(tmp);
+    m_centers.push_back(tmp->GetMaxCenter());
+    m_heights.push_back(tmp->GetMaxHeight() + MC_GROUP_SKIP);
+    m_widths.push_back(tmp->GetWidth());
+    m_sortedWidths.insert(tmp->GetWidth());
+  }
+  m_isDirty.resize(m_groups.size(), false);
+
+  // Builds the Fenwick tree in O(n): every node passes its sum on to its parent.
+  m_fenwick.assign(m_groups.size() + 1, 0);
+  for (size_t i = 1; i <= m_groups.size(); i++)
+  {
+    m_fenwick[i] += m_heights[i - 1];
+    size_t parent = i + (i & (~i + 1));
+    if (parent <= m_groups.size())
+      m_fenwick[parent] += m_fenwick[i];
+  }
+
+  m_valid = true;
+}
+
+void GroupLayout::SetDirty(GroupCell *group)
+{
+  if (!m_valid)
+    return;
+
+  size_t index = group->GetLayoutIndex();
+  if (!Contains(group, index))
+  {
+    // The list of groups has changed without us being told so.
+    Invalidate();
+    return;
+  }
+
+  if (!m_isDirty[index])
+  {
+    m_isDirty[index] = true;
+    m_dirty.push_back(group);
+  }
+}
+
+std::vector<GroupCell *> GroupLayout::TakeDirty()
+{
+  std::vector<GroupCell *> dirty;
+  dirty.swap(m_dirty);
+  for (size_t i = 0; i < dirty.size(); i++)
+    m_isDirty[dirty[i]->GetLayoutIndex()] = false;
+  return dirty;
+}
+
+bool GroupLayout::Update(GroupCell *group)
+{
+  size_t index = group->GetLayoutIndex();
+  if (!m_valid || !Contains(group, index))
+    return false;
+
+  bool moved = false;
+  int height = group->GetMaxHeight() + MC_GROUP_SKIP;
+  int center = group->GetMaxCenter();
+  if ((height != m_heights[index]) || (center != m_centers[index]))
+  {
+    Add(index, height - m_heights[index]);
+    m_heights[index] = height;
+    m_centers[index] = center;
+    m_version++;
+    moved = true;
+  }
+
+  if (group->GetWidth() != m_widths[index])
+  {
+    m_sortedWidths.erase(m_sortedWidths.find(m_widths[index]));
+    m_widths[index] = group->GetWidth();
+    m_sortedWidths.insert(m_widths[index]);
+  }
+  return moved;
+}
+
+void GroupLayout::Add(size_t index, int delta)
+{
+  for (size_t i = index + 1; i < m_fenwick.size(); i += i & (~i + 1))
+    m_fenwick[i] += delta;
+}
+
+int GroupLayout::Sum(size_t count)
+{
+  int sum = 0;
+  for (size_t i = count; i > 0; i -= i & (~i + 1))
+    sum += m_fenwick[i];
+  return sum;
+}
+
+int GroupLayout::GetY(size_t index)
+{
+  return GetTop(index) + m_centers[index];
+}
+
+int GroupLayout::GetTop(size_t index)
+{
+  return MC_BASE_INDENT + Sum(index);
+}
+
+size_t GroupLayout::FindIndex(int y)
+{
+  int target = y - MC_BASE_INDENT;
+  if (target < 0)
+    return 0;
+
+  // Descends the Fenwick tree to the last group whose top is above y.
+  size_t step = 1;
+  while (step * 2 <= m_groups.size())
+    step *= 2;
+
+  size_t index = 0;
+  int sum = 0;
+  for (; step > 0; step /= 2)
+  {
+    if ((index + step <= m_groups.size()) && (sum + m_fenwick[index + step] <= target))
+    {
+      index += step;
+      sum += m_fenwick[index];
+    }
+  }
+  return index;
+}
+
+int GroupLayout::GetHeight()
+{
+  return Sum(m_groups.size());
+}
+
+int GroupLayout::GetWidth()
+{
+  if (m_sortedWidths.empty())
+    return 0;
+  return *m_sortedWidths.rbegin();
+}
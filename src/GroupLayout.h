@@ -0,0 +1,140 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+  The definition of the class GroupLayout that knows where the GroupCells of
+  the worksheet are placed.
+*/
+
+#ifndef GROUPLAYOUT_H
+#define GROUPLAYOUT_H
+
+#include <vector>
+#include <set>
+
+class GroupCell;
+
+/*! The vertical positions of all GroupCells of the worksheet
+
+  The y position of a GroupCell is the sum of the heights of all groups
+  above it. These heights are stored in a Fenwick tree so if one group
+  changes its size the positions of all groups below it change with
+  O(log n) operations instead of O(n).
+
+  GroupCells whose size has been reset tell their GroupLayout that they are
+  dirty. MathCtrl::Recalculate() then only has to lay out these groups. Every
+  change of the list of groups itself (inserting, deleting, folding) has to
+  be followed by a call to Invalidate() which makes the next
+  MathCtrl::Recalculate() lay out the whole worksheet and call Rebuild().
+
+  GroupCells don't store their position any more but ask their GroupLayout
+  for it if it has changed since they have last asked.
+*/
+class GroupLayout
+{
+public:
+  GroupLayout();
+
+  //! Forgets all groups: The list of groups has changed.
+  void Invalidate();
+  /*! Is the index still describing the worksheet that starts with tree and ends with last?
+
+    Only checks the ends of the list: All functions that change the list of
+    groups call Invalidate().
+   */
+  bool IsValid(GroupCell *tree, GroupCell *last);
+  /*! Reads the size of all groups in the list that starts with tree
+
+    The groups have to be laid out already.
+   */
+  void Rebuild(GroupCell *tree);
+
+  //! Marks a group whose size has changed
+  void SetDirty(GroupCell *group);
+  //! Are there groups that have to be laid out again?
+  bool HasDirty() { return !m_dirty.empty(); }
+  //! Returns the groups that have been marked dirty and forgets about them
+  std::vector<GroupCell *> TakeDirty();
+  /*! Re-reads the size of a group that has been laid out again
+
+    \return true, if the groups below it have been moved.
+   */
+  bool Update(GroupCell *group);
+
+  //! The number of groups
+  size_t GetCount() { return m_groups.size(); }
+  GroupCell *GetGroup(size_t index) { return m_groups[index]; }
+  //! Is group the group with this index?
+  bool Contains(GroupCell *group, size_t index)
+  {
+    return (index < m_groups.size()) && (m_groups[index] == group);
+  }
+  //! The y position of the center of the first line of a group
+  int GetY(size_t index);
+  //! The y position of the top of a group
+  int GetTop(size_t index);
+  //! The space a group takes including the space to the next group
+  int GetSpace(size_t index) { return m_heights[index]; }
+  //! The width of a group when it has been laid out for the last time
+  int GetGroupWidth(size_t index) { return m_widths[index]; }
+  /*! The index of the group the y coordinate y belongs to
+
+    Every group owns the space from its top to the top of the next group.
+    Returns GetCount() if y is below the last group. O(log n).
+   */
+  size_t FindIndex(int y);
+  //! The height of all groups including the space between them
+  int GetHeight();
+  //! The width of the widest group
+  int GetWidth();
+  /*! Is incremented every time the position of any group changes
+
+    Tells GroupCells if they have to ask for their position again.
+  */
+  unsigned long GetVersion() { return m_version; }
+
+private:
+  //! Changes the space the group with the given index takes by delta
+  void Add(size_t index, int delta);
+  //! The sum of the space the first count groups take
+  int Sum(size_t count);
+
+  //! Has Rebuild() been called since the last Invalidate()?
+  bool m_valid;
+  unsigned long m_version;
+  //! The groups, top to bottom
+  std::vector<GroupCell *> m_groups;
+  //! The Fenwick tree of the space each group takes including MC_GROUP_SKIP
+  std::vector<int> m_fenwick;
+  //! The space each group takes
+  std::vector<int> m_heights;
+  //! The distance between the top of each group and its y position
+  std::vector<int> m_centers;
+  //! The width of each group
+  std::vector<int> m_widths;
+  //! All widths, sorted
+  std::multiset<int> m_sortedWidths;
+  //! Groups whose size has changed
+  std::vector<GroupCell *> m_dirty;
+  //! Is the group with this index in m_dirty?
+  std::vector<bool> m_isDirty;
+};
+
+#endif // GROUPLAYOUT_H
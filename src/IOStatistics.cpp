@@ -0,0 +1,219 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "IOStatistics.h"
+
+#include <wx/file.h>
+#include <wx/stopwatch.h>
+#include <time.h>
+
+//! The number of finished commands we keep the statistics of
+#define IOSTATISTICS_MAX_RECORDS 1000
+
+IOCommandStatistics::IOCommandStatistics(wxString command)
+{
+  m_command = command;
+  m_sent = IOStatistics::Now();
+  m_finished = 0;
+  m_bytes = 0;
+  m_wakeups = 0;
+  m_parseTime = 0;
+  m_layoutTime = 0;
+  m_paintTime = 0;
+}
+
+wxLongLong IOCommandStatistics::GetTotalTime() const
+{
+  if (m_finished == 0)
+    return IOStatistics::Now() - m_sent;
+  else
+    return m_finished - m_sent;
+}
+
+wxString IOCommandStatistics::ToJSON() const
+{
+  wxString command;
+  for (wxString::const_iterator it = m_command.begin(); it != m_command.end(); ++it)
+  {
+    wxChar ch = *it;
+    if (ch == wxT('"'))
+      command += wxT("\\\"");
+    else if (ch == wxT('\\'))
+      command += wxT("\\\\");
+    else if (ch == wxT('\n'))
+      command += wxT("\\n");
+    else if (ch < 0x20)
+      command += wxString::Format(wxT("\\u%04x"), (int) ch);
+    else
+      command += ch;
+  }
+
+  return wxString::Format(wxT("{\"command\": \"%s\", \"running\": %s, "
+                              "\"total_us\": %s, \"bytes\": %lu, \"wakeups\": %lu, "
+                              "\"parse_us\": %s, \"layout_us\": %s, \"paint_us\": %s}"),
+                          command,
+                          (m_finished == 0) ? wxT("true") : wxT("false"),
+                          GetTotalTime().ToString(),
+                          m_bytes, m_wakeups,
+                          m_parseTime.ToString(),
+                          m_layoutTime.ToString(),
+                          m_paintTime.ToString());
+}
+
+IOStatistics::IOStatistics()
+{
+  m_changed = false;
+}
+
+wxLongLong IOStatistics::Now()
+{
+#if defined CLOCK_MONOTONIC
+  struct timespec now;
+  if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+    return wxLongLong(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+#endif
+  // wxStopWatch uses the performance counter on MSW which is monotonic, too.
+  static wxStopWatch clock;
+  return clock.TimeInMicro();
+}
+
+void IOStatistics::CommandSent(wxString command)
+{
+  m_running.push_back(IOCommandStatistics(command));
+  m_changed = true;
+}
+
+void IOStatistics::PromptReceived(size_t index)
+{
+  if (index >= m_running.size())
+    return;
+
+  m_running[index].m_finished = Now();
+  m_finished.push_back(m_running[index]);
+  m_running.erase(m_running.begin() + index);
+  while (m_finished.size() > IOSTATISTICS_MAX_RECORDS)
+    m_finished.pop_front();
+  m_changed = true;
+}
+
+void IOStatistics::CommandsAborted()
+{
+  while (!m_running.empty())
+    PromptReceived();
+}
+
+IOCommandStatistics *IOStatistics::Current()
+{
+  if (m_running.empty())
+    return NULL;
+  return &m_running.front();
+}
+
+void IOStatistics::AddBytes(unsigned long bytes)
+{
+  IOCommandStatistics *current = Current();
+  if (current == NULL)
+    return;
+  current->m_bytes += bytes;
+}
+
+void IOStatistics::AddWakeup()
+{
+  IOCommandStatistics *current = Current();
+  if (current == NULL)
+    return;
+  current->m_wakeups++;
+}
+
+void IOStatistics::AddTime(Counter counter, wxLongLong time)
+{
+  IOCommandStatistics *current = Current();
+  if (current == NULL)
+    return;
+
+  switch (counter)
+  {
+  case parse:
+    current->m_parseTime += time;
+    break;
+  case layout:
+    current->m_layoutTime += time;
+    break;
+  case paint:
+    current->m_paintTime += time;
+    break;
+  }
+}
+
+bool IOStatistics::Changed()
+{
+  bool changed = m_changed;
+  m_changed = false;
+  return changed;
+}
+
+const IOCommandStatistics &IOStatistics::Get(size_t index) const
+{
+  if (index < m_finished.size())
+    return m_finished[index];
+  else
+    return m_running[index - m_finished.size()];
+}
+
+wxString IOStatistics::ToJSON() const
+{
+  wxLongLong totalTime = 0, parseTime = 0, layoutTime = 0, paintTime = 0;
+  unsigned long bytes = 0, wakeups = 0;
+
+  wxString commands;
+  for (size_t i = 0; i < GetCount(); i++)
+  {
+    const IOCommandStatistics &record = Get(i);
+    totalTime += record.GetTotalTime();
+    parseTime += record.m_parseTime;
+    layoutTime += record.m_layoutTime;
+    paintTime += record.m_paintTime;
+    bytes += record.m_bytes;
+    wakeups += record.m_wakeups;
+
+    if (i > 0)
+      commands += wxT(",\n");
+    commands += wxT("    ") + record.ToJSON();
+  }
+
+  return wxString::Format(wxT("{\n  \"commands\": [\n%s\n  ],\n"
+                              "  \"totals\": {\"total_us\": %s, \"bytes\": %lu, \"wakeups\": %lu, "
+                              "\"parse_us\": %s, \"layout_us\": %s, \"paint_us\": %s}\n}\n"),
+                          commands,
+                          totalTime.ToString(), bytes, wakeups,
+                          parseTime.ToString(),
+                          layoutTime.ToString(),
+                          paintTime.ToString());
+}
+
+bool IOStatistics::WriteJSON(wxString file) const
+{
+  wxFile output;
+  if (!output.Create(file, true))
+    return false;
+  bool success = output.Write(ToJSON(), wxConvUTF8);
+  output.Close();
+  return success;
+}
@@ -0,0 +1,154 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+  Counters that tell where the time between sending a command to maxima and
+  receiving the next prompt is spent.
+*/
+
+#ifndef IOSTATISTICS_H
+#define IOSTATISTICS_H
+
+#include <wx/wx.h>
+#include <wx/longlong.h>
+#include <deque>
+
+//! The counters for one command that was sent to maxima
+class IOCommandStatistics
+{
+public:
+  IOCommandStatistics(wxString command = wxEmptyString);
+  //! The command that was sent
+  wxString m_command;
+  //! When the command was sent [µs, see IOStatistics::Now()]
+  wxLongLong m_sent;
+  //! When the prompt that follows the command arrived. 0 = still running.
+  wxLongLong m_finished;
+  //! The number of bytes maxima has sent in response
+  unsigned long m_bytes;
+  //! How often we were woken up by the socket
+  unsigned long m_wakeups;
+  //! The time spent converting xml to cells [µs]
+  wxLongLong m_parseTime;
+  //! The time spent laying out the worksheet [µs]
+  wxLongLong m_layoutTime;
+  //! The time spent drawing the worksheet [µs]
+  wxLongLong m_paintTime;
+  //! The time between sending the command and receiving the prompt [µs]
+  wxLongLong GetTotalTime() const;
+  //! The counters as a JSON object
+  wxString ToJSON() const;
+};
+
+/*! Collects per-command statistics about the communication with maxima
+
+  Every command that is sent opens a record that is closed by the prompt
+  that follows it. Bytes, wakeups and the time spent in wxMaxima are added to
+  the oldest command that hasn't received its prompt yet. Work that is done
+  while no command is running isn't attributed to any command.
+*/
+class IOStatistics
+{
+public:
+  //! The things we measure the time of
+  enum Counter
+  {
+    parse,
+    layout,
+    paint
+  };
+
+  IOStatistics();
+
+  //! A monotonic clock with a resolution of a microsecond
+  static wxLongLong Now();
+
+  //! Opens a new record for a command that is sent to maxima
+  void CommandSent(wxString command);
+  /*! Closes the record of a running command
+
+    \param index 0 = the oldest running command, 1 = the one sent after it and
+    so on.
+  */
+  void PromptReceived(size_t index = 0);
+  //! Closes all records of commands that will never receive a prompt
+  void CommandsAborted();
+  //! Maxima has sent bytes bytes
+  void AddBytes(unsigned long bytes);
+  //! The socket has woken us up
+  void AddWakeup();
+  //! Adds time [µs] to counter
+  void AddTime(Counter counter, wxLongLong time);
+
+  /*! Has a command been sent or finished since the last call to Changed()?
+
+    The counters of a running command change all the time and therefore
+    aren't taken into account.
+  */
+  bool Changed();
+  //! The number of records
+  size_t GetCount() const
+    {
+      return m_finished.size() + m_running.size();
+    }
+  //! Returns a record. The oldest one has the index 0.
+  const IOCommandStatistics &Get(size_t index) const;
+  //! All records as a JSON document
+  wxString ToJSON() const;
+  //! Writes ToJSON() to a file
+  bool WriteJSON(wxString file) const;
+
+private:
+  //! The record that is to be updated right now or NULL if there is none.
+  IOCommandStatistics *Current();
+  //! The commands that have received their prompt, the oldest first
+  std::deque<IOCommandStatistics> m_finished;
+  //! The commands that are waiting for their prompt, the oldest first
+  std::deque<IOCommandStatistics> m_running;
+  //! Has a command been sent or finished since the last call to Changed()?
+  bool m_changed;
+};
+
+/*! Measures the time until it is destroyed and adds it to a counter
+
+  Is meant to be created on the stack at the beginning of the function that
+  is to be measured.
+*/
+class IOTimer
+{
+public:
+  IOTimer(IOStatistics *statistics, IOStatistics::Counter counter)
+    {
+      m_statistics = statistics;
+      m_counter = counter;
+      m_start = IOStatistics::Now();
+    }
+  ~IOTimer()
+    {
+      if (m_statistics != NULL)
+        m_statistics->AddTime(m_counter, IOStatistics::Now() - m_start);
+    }
+private:
+  IOStatistics *m_statistics;
+  IOStatistics::Counter m_counter;
+  wxLongLong m_start;
+};
+
+#endif // IOSTATISTICS_H
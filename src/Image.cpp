@@ -0,0 +1,217 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+
+#include "Image.h"
+#include "ScaledBitmapCache.h"
+
+#include <wx/mstream.h>
+#include <wx/wfstream.h>
+#include <string.h>
+
+std::list<Image *> Image::s_decoded;
+size_t Image::s_memoryUsage = 0;
+size_t Image::s_budget = IMAGE_DEFAULT_MEMORY_BUDGET;
+
+Image::Image(wxInputStream &stream)
+{
+  m_isDecoded = false;
+  Read(stream);
+}
+
+Image::Image(wxString file)
+{
+  m_isDecoded = false;
+  wxFileInputStream stream(file);
+  if (stream.IsOk())
+    Read(stream);
+  else
+    m_isOk = false;
+}
+
+Image::Image(const wxBitmap &bitmap)
+{
+  m_isDecoded = false;
+  m_bitmap = bitmap;
+  m_size = bitmap.GetSize();
+  m_isOk = bitmap.IsOk();
+}
+
+Image::Image(const Image &image)
+{
+  m_isDecoded = false;
+  m_compressedData = image.m_compressedData;
+  m_size = image.m_size;
+  m_isOk = image.m_isOk;
+  // An image without PNG data can only be copied as a bitmap.
+  if (!HasCompressedData())
+    m_bitmap = image.m_bitmap;
+}
+
+Image::~Image()
+{
+  ClearBitmap();
+  ScaledBitmapCache::Get()->Forget(this);
+}
+
+void Image::Read(wxInputStream &stream)
+{
+  char buffer[16384];
+  do
+  {
+    stream.Read(buffer, sizeof(buffer));
+    m_compressedData.AppendData(buffer, stream.LastRead());
+  }
+  while (stream.LastRead() > 0);
+
+  Check();
+}
+
+void Image::Check()
+{
+  static const unsigned char pngSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  const unsigned char *data = (const unsigned char *) m_compressedData.GetData();
+
+  // A PNG file starts with its signature followed by the IHDR chunk that
+  // contains width and height as big-endian 32-bit numbers.
+  if ((m_compressedData.GetDataLen() >= 24) &&
+      (memcmp(data, pngSignature, sizeof(pngSignature)) == 0) &&
+      (memcmp(data + 12, "IHDR", 4) == 0))
+  {
+    m_size.x = (data[16] << 24) | (data[17] << 16) | (data[18] << 8) | data[19];
+    m_size.y = (data[20] << 24) | (data[21] << 16) | (data[22] << 8) | data[23];
+    m_isOk = (m_size.x > 0) && (m_size.y > 0);
+    return;
+  }
+
+  // Not a PNG => the image has to be decoded once to learn its size and is
+  // kept as PNG so it can be saved to a .wxmx file as it is.
+  wxImage image = ToImage();
+  m_isOk = image.IsOk();
+  if (!m_isOk)
+    return;
+
+  m_size = image.GetSize();
+  wxMemoryBuffer png;
+  if (ToPNG(image, png))
+    m_compressedData = png;
+  else
+  {
+    m_compressedData = wxMemoryBuffer();
+    m_bitmap = wxBitmap(image);
+  }
+}
+
+bool Image::ToPNG(const wxImage &image, wxMemoryBuffer &png)
+{
+  wxMemoryOutputStream stream;
+  if (!image.SaveFile(stream, wxBITMAP_TYPE_PNG))
+    return false;
+
+  size_t length = stream.GetLength();
+  stream.CopyTo(png.GetWriteBuf(length), length);
+  png.UngetWriteBuf(length);
+  return true;
+}
+
+const wxMemoryBuffer &Image::GetCompressedData()
+{
+  if (!HasCompressedData() && m_bitmap.IsOk())
+  {
+    wxMemoryBuffer png;
+    if (ToPNG(m_bitmap.ConvertToImage(), png))
+    {
+      m_compressedData = png;
+      // The bitmap can now be decoded again => it may be dropped if memory is short.
+      AddToDecoded();
+    }
+  }
+  return m_compressedData;
+}
+
+wxBitmap Image::GetBitmap()
+{
+  if (m_isDecoded)
+  {
+    s_decoded.splice(s_decoded.begin(), s_decoded, m_lastUse);
+    return m_bitmap;
+  }
+
+  if (!HasCompressedData())
+    return m_bitmap;
+
+  wxImage image = ToImage();
+  if (image.IsOk())
+    m_bitmap = wxBitmap(image);
+  else
+  {
+    // The header was fine, but the data is broken.
+    m_bitmap.Create(m_size.x, m_size.y);
+    wxMemoryDC dc(m_bitmap);
+    dc.SetBackground(*wxWHITE_BRUSH);
+    dc.Clear();
+  }
+
+  AddToDecoded();
+  return m_bitmap;
+}
+
+void Image::AddToDecoded()
+{
+  s_decoded.push_front(this);
+  m_lastUse = s_decoded.begin();
+  m_isDecoded = true;
+  s_memoryUsage += MemoryUsage();
+  KeepBudget();
+}
+
+wxImage Image::ToImage() const
+{
+  if (m_bitmap.IsOk())
+    return m_bitmap.ConvertToImage();
+
+  wxMemoryInputStream stream(m_compressedData.GetData(), m_compressedData.GetDataLen());
+  return wxImage(stream, wxBITMAP_TYPE_ANY);
+}
+
+void Image::ClearBitmap()
+{
+  if (!m_isDecoded)
+    return;
+
+  s_decoded.erase(m_lastUse);
+  s_memoryUsage -= MemoryUsage();
+  m_isDecoded = false;
+  m_bitmap = wxNullBitmap;
+}
+
+void Image::SetMemoryBudget(size_t budget)
+{
+  s_budget = budget;
+  KeepBudget();
+}
+
+void Image::KeepBudget()
+{
+  // The bitmap that has been used last is kept even if it alone is over
+  // budget: It is about to be drawn.
+  while ((s_memoryUsage > s_budget) && (s_decoded.size() > 1))
+    s_decoded.back()->ClearBitmap();
+}
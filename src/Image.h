@@ -0,0 +1,135 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+
+/*! \file
+  The definition of the class Image that stores the images of the worksheet
+  in compressed form.
+*/
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <wx/wx.h>
+#include <wx/image.h>
+#include <wx/stream.h>
+#include <list>
+
+//! The amount of memory all decoded images may take together by default [bytes]
+#define IMAGE_DEFAULT_MEMORY_BUDGET (256 * 1024 * 1024)
+
+/*! An image of an ImgCell or a frame of a SlideShow
+
+  A worksheet might contain hundreds of plots. Decoding all of them to bitmaps
+  when the file is opened would need much time and gigabytes of memory. This
+  class therefore keeps the compressed PNG data and only decodes it when the
+  image is drawn. The size of the image is read from the PNG header so
+  calculating the layout doesn't need to decode anything.
+
+  The decoded bitmaps of all images together may only take a certain amount
+  of memory. If more is needed the bitmaps that haven't been used for the
+  longest time are dropped: They can be decoded again from the PNG data.
+
+  Images that have been created from a bitmap (for example pasted from the
+  clipboard) don't have PNG data and keep their bitmap until they are encoded
+  for saving them for the first time.
+
+  Saving writes the PNG data unchanged which makes saving a worksheet with
+  many plots much faster than encoding them again.
+
+  All functions have to be called from the main thread.
+*/
+class Image
+{
+public:
+  //! Reads the image data from a stream
+  Image(wxInputStream &stream);
+  //! Reads the image data from a file
+  Image(wxString file);
+  //! An image that only consists of a bitmap
+  Image(const wxBitmap &bitmap);
+  //! A copy of image. Shares the PNG data with it.
+  Image(const Image &image);
+  ~Image();
+
+  //! Could the data be read and does it contain an image?
+  bool IsOk() { return m_isOk; }
+  //! The size of the image in pixels. Doesn't decode the image.
+  wxSize GetSize() const { return m_size; }
+  int GetWidth() const { return m_size.x; }
+  int GetHeight() const { return m_size.y; }
+  //! Returns the image as a bitmap, decoding it if necessary.
+  wxBitmap GetBitmap();
+  /*! Returns the image as a wxImage
+
+    Doesn't keep a decoded bitmap and therefore doesn't count towards the
+    memory budget.
+   */
+  wxImage ToImage() const;
+  //! Does the image still know its PNG data?
+  bool HasCompressedData() const { return m_compressedData.GetDataLen() > 0; }
+  /*! The PNG data of the image
+
+    An image that has been created from a bitmap is encoded on the first call;
+    Later calls return the same data.
+   */
+  const wxMemoryBuffer &GetCompressedData();
+
+  //! Sets the amount of memory all decoded images may take together [bytes]
+  static void SetMemoryBudget(size_t budget);
+  //! The amount of memory all decoded images take [bytes]
+  static size_t GetMemoryUsage() { return s_memoryUsage; }
+
+private:
+  //! Not implemented: Images are shared by pointer.
+  Image &operator=(const Image &image);
+  //! Reads the compressed data from a stream and checks it
+  void Read(wxInputStream &stream);
+  //! Reads the size from the PNG header; Converts other image formats to PNG.
+  void Check();
+  //! Encodes image as PNG
+  static bool ToPNG(const wxImage &image, wxMemoryBuffer &png);
+  //! Enters the bitmap in the list of decoded bitmaps that are dropped if memory is short
+  void AddToDecoded();
+  //! Drops the decoded bitmap if the image can be decoded again
+  void ClearBitmap();
+  //! The memory the bitmap of this image takes when decoded [bytes]
+  size_t MemoryUsage() const { return (size_t) m_size.x * m_size.y * 4; }
+  //! Drops the bitmaps that haven't been used for the longest time until the budget is kept
+  static void KeepBudget();
+
+  //! The PNG data. Is reference-counted and shared between copies.
+  wxMemoryBuffer m_compressedData;
+  //! The decoded image. Is invalid if the image hasn't been decoded.
+  wxBitmap m_bitmap;
+  wxSize m_size;
+  bool m_isOk;
+  //! Is this image in s_decoded?
+  bool m_isDecoded;
+  //! Our position in s_decoded
+  std::list<Image *>::iterator m_lastUse;
+
+  //! The images that have a decoded bitmap; The one used last comes first.
+  static std::list<Image *> s_decoded;
+  static size_t s_memoryUsage;
+  static size_t s_budget;
+};
+
+#endif // IMAGE_H
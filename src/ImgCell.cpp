@@ -20,16 +20,16 @@
 //
 
 #include "ImgCell.h"
+#include "ScaledBitmapCache.h"
 
 #include <wx/file.h>
 #include <wx/filename.h>
 #include <wx/filesys.h>
-#include <wx/fs_mem.h>
 #include <wx/clipbrd.h>
 
 ImgCell::ImgCell() : MathCell()
 {
-  m_bitmap = NULL;
+  m_image = NULL;
   m_type = MC_TYPE_IMAGE;
   m_fileSystem = NULL;
   m_drawRectangle = true;
@@ -37,11 +37,12 @@ ImgCell::ImgCell() : MathCell()
 }
 
 int ImgCell::s_counter = 0;
+std::vector<wxMemoryBuffer> ImgCell::s_wxmxImages;
 
 // constructor which load image
 ImgCell::ImgCell(wxString image, bool remove, wxFileSystem *filesystem) : MathCell()
 {
-  m_bitmap = NULL;
+  m_image = NULL;
   m_type = MC_TYPE_IMAGE;
   m_fileSystem = filesystem; // != NULL when loading from wxmx
   m_drawRectangle = true;
@@ -51,30 +52,24 @@ ImgCell::ImgCell(wxString image, bool remove, wxFileSystem *filesystem) : MathCe
 
 ImgCell::~ImgCell()
 {
-  if (m_bitmap != NULL)
-    delete m_bitmap;
+  if (m_image != NULL)
+    delete m_image;
   if (m_next != NULL)
     delete m_next;
 }
 
 void ImgCell::LoadImage(wxString image, bool remove)
 {
-  if (m_bitmap != NULL)
-    delete m_bitmap;
-
-  bool loadedImage = false;
+  if (m_image != NULL)
+    delete m_image;
+  m_image = NULL;
 
+  // Only the compressed data is read here: Images are decoded when they are
+  // drawn for the first time.
   if (m_fileSystem) {
     wxFSFile *fsfile = m_fileSystem->OpenFile(image);
     if (fsfile) { // open successful
-
-      wxInputStream *istream = fsfile->GetStream();
-      wxImage pngImage(*istream, wxBITMAP_TYPE_PNG);
-      if (pngImage.Ok())
-      {
-        loadedImage = true;
-        m_bitmap = new wxBitmap(pngImage);
-      }
+      m_image = new Image(*fsfile->GetStream());
       delete fsfile;
     }
     m_fileSystem = NULL;
@@ -82,29 +77,25 @@ void ImgCell::LoadImage(wxString image, bool remove)
   else {
     if (wxFileExists(image))
     {
-      wxImage pngImage(image);
-
-      if (pngImage.Ok())
-      {
-        loadedImage = true;
-        m_bitmap = new wxBitmap(pngImage);
-      }
+      m_image = new Image(image);
 
       if (remove)
         wxRemoveFile(image);
     }
   }
 
-  if (!loadedImage)
+  if ((m_image == NULL) || !m_image->IsOk())
   {
-    m_bitmap = new wxBitmap;
+    if (m_image != NULL)
+      delete m_image;
 
-    m_bitmap->Create(400, 250);
+    wxBitmap bitmap;
+    bitmap.Create(400, 250);
 
     wxString error(_("Error"));
 
     wxMemoryDC dc;
-    dc.SelectObject(*m_bitmap);
+    dc.SelectObject(bitmap);
 
     int width = 0, height = 0;
     dc.GetTextExtent(error, &width, &height);
@@ -117,16 +108,18 @@ void ImgCell::LoadImage(wxString image, bool remove)
     dc.GetTextExtent(image, &width, &height);
     dc.DrawText(image, 200 - width/2, 150 - height/2);
 
+    dc.SelectObject(wxNullBitmap);
+    m_image = new Image(bitmap);
   }
 }
 
 void ImgCell::SetBitmap(wxBitmap bitmap)
 {
-  if (m_bitmap != NULL)
-    delete m_bitmap;
+  if (m_image != NULL)
+    delete m_image;
 
   m_width = m_height = -1;
-  m_bitmap = new wxBitmap(bitmap);
+  m_image = new Image(bitmap);
 }
 
 MathCell* ImgCell::Copy()
@@ -135,26 +128,27 @@ MathCell* ImgCell::Copy()
   CopyData(this, tmp);
   tmp->m_drawRectangle = m_drawRectangle;
 
-  tmp->m_bitmap = new wxBitmap(*m_bitmap);
+  if (m_image != NULL)
+    tmp->m_image = new Image(*m_image);
 
   return tmp;
 }
 
 void ImgCell::Destroy()
 {
-  if (m_bitmap != NULL)
-    delete m_bitmap;
-  m_bitmap = NULL;
+  if (m_image != NULL)
+    delete m_image;
+  m_image = NULL;
   m_next = NULL;
 }
 
 void ImgCell::RecalculateWidths(CellParser& parser, int fontsize)
 {
   int height;
-  if (m_bitmap != NULL)
+  if (m_image != NULL)
   {
-    height = m_bitmap->GetHeight();
-    m_width  = m_bitmap->GetWidth();
+    height = m_image->GetHeight();
+    m_width  = m_image->GetWidth();
   }
   else
   {
@@ -178,10 +172,10 @@ void ImgCell::RecalculateWidths(CellParser& parser, int fontsize)
 void ImgCell::RecalculateSize(CellParser& parser, int fontsize)
 {
   int width;
-  if (m_bitmap != NULL)
+  if (m_image != NULL)
   {
-    m_height = m_bitmap->GetHeight();
-    width  = m_bitmap->GetWidth();
+    m_height = m_image->GetHeight();
+    width  = m_image->GetWidth();
   }
   else
   {
@@ -207,34 +201,30 @@ void ImgCell::Draw(CellParser& parser, wxPoint point, int fontsize)
 {
   wxDC& dc = parser.GetDC();
 
-  if (DrawThisCell(parser, point) && m_bitmap != NULL)
+  if (DrawThisCell(parser, point) && m_image != NULL)
   {
     wxMemoryDC bitmapDC;
-    double scale = parser.GetScale();
 
     SetPen(parser);
     if (m_drawRectangle)
       
       dc.DrawRectangle(wxRect(point.x, point.y - m_center, m_width, m_height));  
 
+    wxRect imageRect(point.x + m_imageBorderWidth, point.y - m_center + m_imageBorderWidth,
+                     m_width - 2 * m_imageBorderWidth, m_height - 2 * m_imageBorderWidth);
     bool rescale=false;
-    if(m_bitmap->GetHeight() + 2 * m_imageBorderWidth != m_height)
+    if(m_image->GetHeight() + 2 * m_imageBorderWidth != m_height)
       rescale=true;
     
+    // Rescaling is slow => the rescaled bitmap is kept until the size changes.
     if (rescale)
-    {
-      wxImage img = m_bitmap->ConvertToImage();
-      img.Rescale(m_width - 2 * m_imageBorderWidth, m_height - 2 * m_imageBorderWidth,wxIMAGE_QUALITY_BICUBIC);
-
-      wxBitmap bmp = img;
-      bitmapDC.SelectObject(bmp);
-    }
+      bitmapDC.SelectObjectAsSource(
+        ScaledBitmapCache::Get()->GetScaled(m_image, imageRect.GetSize(), imageRect,
+                                            parser.PreviewImages()));
     else
-    {
-      bitmapDC.SelectObject(*m_bitmap);
-    }
+      bitmapDC.SelectObjectAsSource(m_image->GetBitmap());
 
-    dc.Blit(point.x + m_imageBorderWidth, point.y - m_center + m_imageBorderWidth, m_width - 2 * m_imageBorderWidth, m_height - 2 * m_imageBorderWidth, &bitmapDC, 0, 0);
+    dc.Blit(imageRect.x, imageRect.y, imageRect.width, imageRect.height, &bitmapDC, 0, 0);
   }
 
   MathCell::Draw(parser, point, fontsize);
@@ -252,7 +242,7 @@ wxString ImgCell::ToTeX()
 
 wxSize ImgCell::ToImageFile(wxString file)
 {
-  wxImage image = m_bitmap->ConvertToImage();
+  wxImage image = m_image->ToImage();
 
   SizeInMillimeters retval;
   if(image.SaveFile(file, wxBITMAP_TYPE_PNG))
@@ -276,28 +266,33 @@ wxSize ImgCell::ToImageFile(wxString file)
 
 wxString ImgCell::ToXML()
 {
-  wxImage image = m_bitmap->ConvertToImage();
-  wxString basename = ImgCell::WXMXGetNewFileName();
-
-	// add to memory
-  wxMemoryFSHandler::AddFile(basename, image, wxBITMAP_TYPE_PNG);
+  wxString basename = ImgCell::WXMXAddImage(m_image);
 
   return (m_drawRectangle ? wxT("<img>") : wxT("<img rect=\"false\">")) +
          basename + wxT("</img>");
 }
 
-wxString ImgCell::WXMXGetNewFileName()
+wxString ImgCell::WXMXAddImage(Image *image)
+{
+  s_wxmxImages.push_back(image->GetCompressedData());
+
+  wxString file(wxT("image"));
+  file << (++s_counter) << wxT(".png");
+  return file;
+}
+
+void ImgCell::WXMXTakeImages(std::vector<wxMemoryBuffer> &images)
 {
-   wxString file(wxT("image"));
-   file << (++s_counter) << wxT(".png");
-   return file;
+  images.clear();
+  images.swap(s_wxmxImages);
+  s_counter = 0;
 }
 
 bool ImgCell::CopyToClipboard()
 {
   if (wxTheClipboard->Open())
   {
-    bool res = wxTheClipboard->SetData(new wxBitmapDataObject(*m_bitmap));
+    bool res = wxTheClipboard->SetData(new wxBitmapDataObject(m_image->GetBitmap()));
     wxTheClipboard->Close();
     return res;
   }
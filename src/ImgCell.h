@@ -23,10 +23,12 @@
 #define IMGCELL_H
 
 #include "MathCell.h"
+#include "Image.h"
 #include <wx/image.h>
 
 #include <wx/filesys.h>
 #include <wx/fs_arc.h>
+#include <vector>
 
 class ImgCell : public MathCell
 {
@@ -47,12 +49,22 @@ public:
   bool CopyToClipboard();
   // These methods should only be used for saving wxmx files
   // and are shared with SlideShowCell.
-  static void WXMXResetCounter() { s_counter = 0; }
-  static wxString WXMXGetNewFileName();
-  static int WXMXImageCount() { return s_counter; }
+  static void WXMXResetCounter() { s_counter = 0; s_wxmxImages.clear(); }
+  /*! Remembers the PNG data of an image that is to be saved in a wxmx file
+
+    The data is shared with the image, not copied.
+    \return The name the image gets inside the wxmx file
+   */
+  static wxString WXMXAddImage(Image *image);
+  /*! Hands over the PNG data of all images WXMXAddImage() was called for
+
+    The nth image is to be saved as image<n+1>.png. Resets the counter.
+   */
+  static void WXMXTakeImages(std::vector<wxMemoryBuffer> &images);
   void DrawRectangle(bool draw) { m_drawRectangle = draw; }
 protected:
-  wxBitmap *m_bitmap;
+  //! The image. Is only decoded when it is drawn.
+  Image *m_image;
   wxFileSystem *m_fileSystem;
   void RecalculateSize(CellParser& parser, int fontsize);
   void RecalculateWidths(CellParser& parser, int fontsize);
@@ -61,6 +73,8 @@ protected:
   wxString ToTeX();
   wxString ToXML();
 	static int s_counter;
+  //! The PNG data of the images that are to be saved in the wxmx file
+  static std::vector<wxMemoryBuffer> s_wxmxImages;
 	bool m_drawRectangle;
 };
 
@@ -152,9 +152,9 @@ void IntCell::RecalculateWidths(CellParser& parser, int fontsize)
   if (parser.CheckTeXFonts()) {
     wxDC& dc = parser.GetDC();
     int fontsize1 = (int) ((fontsize * scale * 1.5 + 0.5));
-    dc.SetFont( wxFont(fontsize1, wxFONTFAMILY_MODERN,
-		       wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
-		       parser.GetTeXCMEX()));
+    dc.SetFont( parser.GetFont(fontsize1,
+                               wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
+                               parser.GetTeXCMEX()));
     dc.GetTextExtent(wxT("\x5A"), &m_signWidth, &m_signSize);
 
 #if defined __WXMSW__
@@ -173,10 +173,10 @@ void IntCell::RecalculateWidths(CellParser& parser, int fontsize)
 #if defined __WXMSW__
     wxDC& dc = parser.GetDC();
     int fontsize1 = (int) ((INTEGRAL_FONT_SIZE * scale + 0.5));
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-		      wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL,
-		      false,
-                      parser.GetSymbolFontName()));
+    dc.SetFont(parser.GetFont(fontsize1,
+                              wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL,
+                              false,
+                              parser.GetSymbolFontName()));
     dc.GetTextExtent(INTEGRAL_TOP, &m_charWidth, &m_charHeight);
 
     m_width = m_signWidth +
@@ -244,9 +244,9 @@ void IntCell::Draw(CellParser& parser, wxPoint point, int fontsize)
     {
       SetForeground(parser);
       int fontsize1 = (int) ((fontsize * scale * 1.5 + 0.5));
-      dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-			wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
-                        parser.GetTeXCMEX()));
+      dc.SetFont(parser.GetFont(fontsize1,
+                                wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
+                                parser.GetTeXCMEX()));
       dc.DrawText(wxT("\x5A"),
                   sign.x,
                   sign.y - m_signTop);
@@ -258,10 +258,10 @@ void IntCell::Draw(CellParser& parser, wxPoint point, int fontsize)
       int fontsize1 = (int) ((INTEGRAL_FONT_SIZE * scale + 0.5));
       int m_signWCenter = m_signWidth / 2;
 
-      dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-			wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL,
-			false,
-                        parser.GetSymbolFontName()));
+      dc.SetFont(parser.GetFont(fontsize1,
+                                wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL,
+                                false,
+                                parser.GetSymbolFontName()));
       dc.DrawText(INTEGRAL_TOP,
                   sign.x + m_signWCenter - m_charWidth / 2,
                   sign.y - (m_signSize + 1) / 2);
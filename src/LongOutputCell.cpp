@@ -0,0 +1,344 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "LongOutputCell.h"
+#include "XmlPullParser.h"
+
+LongOutputCell::LongOutputCell(wxString text) : MathCell()
+{
+  m_longestLine = 0;
+  m_lineHeight = -1;
+  m_fontSize = -1;
+  AppendText(text);
+}
+
+LongOutputCell::~LongOutputCell()
+{
+  if (m_next != NULL)
+    delete m_next;
+}
+
+MathCell* LongOutputCell::Copy()
+{
+  LongOutputCell *retval = new LongOutputCell();
+  CopyData(this, retval);
+  retval->m_text = m_text;
+  retval->m_lineStarts = m_lineStarts;
+  retval->m_longestLine = m_longestLine;
+  retval->m_forceBreakLine = m_forceBreakLine;
+  retval->m_bigSkip = m_bigSkip;
+  retval->m_textStyle = m_textStyle;
+  retval->m_highlight = m_highlight;
+
+  return retval;
+}
+
+void LongOutputCell::Destroy()
+{
+  m_next = NULL;
+}
+
+void LongOutputCell::SetValue(wxString text)
+{
+  m_text = wxEmptyString;
+  m_lineStarts.clear();
+  m_longestLine = 0;
+  AppendText(text);
+}
+
+void LongOutputCell::AppendText(const wxString &text)
+{
+  if (text.IsEmpty())
+    return;
+
+  wxString newText(text);
+  newText.Replace(wxT("\r"), wxEmptyString);
+  size_t pos = m_text.Length();
+  m_text += newText;
+
+  if (m_lineStarts.empty())
+    m_lineStarts.push_back(0);
+  else
+    // The first new characters might continue the last line.
+    pos = m_lineStarts.back();
+
+  wxString::const_iterator it = m_text.begin() + pos;
+  for (; it != m_text.end(); ++it, ++pos)
+  {
+    if (*it == wxT('\n'))
+    {
+      size_t start = m_lineStarts.back();
+      size_t longest = m_lineStarts[m_longestLine];
+      size_t longestEnd = (m_longestLine + 1 < m_lineStarts.size()) ?
+        m_lineStarts[m_longestLine + 1] - 1 : pos;
+      if (pos - start > longestEnd - longest)
+        m_longestLine = m_lineStarts.size() - 1;
+      m_lineStarts.push_back(pos + 1);
+    }
+  }
+
+  // The last line has no '\n' that would have triggered the check above.
+  size_t start = m_lineStarts.back();
+  size_t longest = m_lineStarts[m_longestLine];
+  size_t longestEnd = (m_longestLine + 1 < m_lineStarts.size()) ?
+    m_lineStarts[m_longestLine + 1] - 1 : m_text.Length();
+  if (m_text.Length() - start > longestEnd - longest)
+    m_longestLine = m_lineStarts.size() - 1;
+
+  ResetSize();
+}
+
+wxString LongOutputCell::GetLine(size_t line)
+{
+  if (line >= m_lineStarts.size())
+    return wxEmptyString;
+
+  size_t start = m_lineStarts[line];
+  size_t end = (line + 1 < m_lineStarts.size()) ?
+    m_lineStarts[line + 1] - 1 : m_text.Length();
+  return m_text.Mid(start, end - start);
+}
+
+void LongOutputCell::SetFont(CellParser& parser, int fontsize)
+{
+  wxDC& dc = parser.GetDC();
+  double scale = parser.GetScale();
+
+  int fontsize1 = (int) (((double)fontsize) * scale + 0.5);
+  fontsize1 = MAX(fontsize1, 1);
+
+  // The style sheet creates its fonts in the family wxFONTFAMILY_MODERN =>
+  // without a face name we get a fixed-width font in which the line with
+  // the most characters is the widest one.
+  dc.SetFont(parser.GetFont(fontsize1,
+                            parser.IsItalic(m_textStyle),
+                            parser.IsBold(m_textStyle),
+                            parser.IsUnderlined(m_textStyle),
+                            wxEmptyString,
+                            parser.GetFontEncoding()));
+}
+
+void LongOutputCell::RecalculateWidths(CellParser& parser, int fontsize)
+{
+  if (m_height == -1 || m_width == -1 || fontsize != m_fontSize || parser.ForceUpdate())
+  {
+    m_fontSize = fontsize;
+
+    wxDC& dc = parser.GetDC();
+    double scale = parser.GetScale();
+    SetFont(parser, fontsize);
+
+    // Measuring every line would take as long as creating a TextCell for
+    // each of them. In our fixed-width font the line with the most
+    // characters is the widest one.
+    int width, height;
+    dc.GetTextExtent(wxT("X"), &width, &m_lineHeight);
+    dc.GetTextExtent(GetLine(m_longestLine), &width, &height);
+    m_lineHeight += 2 * SCALE_PX(MC_TEXT_PADDING, scale);
+
+    m_width = width + 2 * SCALE_PX(MC_TEXT_PADDING, scale);
+    m_height = MAX((int) m_lineStarts.size(), 1) * m_lineHeight;
+    // The output label is aligned to the first line.
+    m_center = m_lineHeight / 2;
+  }
+  ResetData();
+}
+
+void LongOutputCell::Draw(CellParser& parser, wxPoint point, int fontsize)
+{
+  double scale = parser.GetScale();
+  wxDC& dc = parser.GetDC();
+
+  if (m_width == -1 || m_height == -1)
+    RecalculateWidths(parser, fontsize);
+
+  if (DrawThisCell(parser, point) && (m_lineHeight > 0))
+  {
+    SetFont(parser, fontsize);
+    SetForeground(parser);
+
+    int top = point.y - m_center;
+
+    // Only the lines that are inside the region we redraw are drawn.
+    size_t first = 0;
+    size_t last = m_lineStarts.size();
+    if ((parser.GetTop() != -1) && (parser.GetBottom() != -1))
+    {
+      if (parser.GetTop() > top)
+        first = (parser.GetTop() - top) / m_lineHeight;
+      if (parser.GetBottom() >= top)
+        last = MIN(last, (size_t) ((parser.GetBottom() - top) / m_lineHeight + 1));
+    }
+
+    for (size_t line = first; line < last; line++)
+      dc.DrawText(GetLine(line),
+                  point.x + SCALE_PX(MC_TEXT_PADDING, scale),
+                  top + (int) line * m_lineHeight + SCALE_PX(MC_TEXT_PADDING, scale));
+  }
+  MathCell::Draw(parser, point, fontsize);
+}
+
+wxString LongOutputCell::ToString()
+{
+  return m_text;
+}
+
+wxString LongOutputCell::ToTeX()
+{
+  // A verbatim environment or \verb would end at the first occurrence of
+  // their end marker in the text and GroupCell::ToTeX() escapes every # even
+  // there. Therefore every character TeX treats specially is escaped instead.
+  wxString retval = wxT("\n\\begin{flushleft}\\ttfamily\n");
+  for (size_t line = 0; line < m_lineStarts.size(); line++)
+  {
+    wxString text = GetLine(line);
+    if (text.IsEmpty())
+      retval += wxT("\\mbox{}");
+    for (wxString::const_iterator it = text.begin(); it != text.end(); ++it)
+    {
+      switch ((*it).GetValue())
+      {
+      case wxT(' '):
+        retval += wxT("~");
+        break;
+      case wxT('$'):
+      case wxT('%'):
+      case wxT('&'):
+      case wxT('_'):
+        retval += wxT("\\");
+        retval += *it;
+        break;
+      case wxT('#'):
+      case wxT('\\'):
+      case wxT('{'):
+      case wxT('}'):
+      case wxT('~'):
+      case wxT('^'):
+        retval += wxString::Format(wxT("\\char%i{}"), (int) (*it).GetValue());
+        break;
+      default:
+        retval += *it;
+      }
+    }
+    if (line + 1 < m_lineStarts.size())
+      retval += wxT("\\\\");
+    retval += wxT("\n");
+  }
+  retval += wxT("\\end{flushleft}\n");
+  return retval;
+}
+
+wxString LongOutputCell::ToXML()
+{
+  wxString xmlstring = m_text;
+  // convert it, so that the XML parser doesn't fail
+  xmlstring.Replace(wxT("&"),  wxT("&amp;"));
+  xmlstring.Replace(wxT("<"),  wxT("&lt;"));
+  xmlstring.Replace(wxT(">"),  wxT("&gt;"));
+  xmlstring.Replace(wxT("'"),  wxT("&apos;"));
+  xmlstring.Replace(wxT("\""), wxT("&quot;"));
+
+  return wxT("<longoutput>") + xmlstring + wxT("</longoutput>");
+}
+
+wxString LongOutputCell::XmlToText(const wxString &xml)
+{
+  wxString text;
+  XmlPullParser parser(xml);
+
+  // For every open element: its name and the number of children seen so far
+  wxArrayString names;
+  wxArrayInt children;
+
+  XmlPullParser::Token token;
+  while (((token = parser.Next()) != XmlPullParser::EndOfDocument) &&
+         (token != XmlPullParser::Error))
+  {
+    if (token == XmlPullParser::Text)
+    {
+      text += parser.GetText();
+      continue;
+    }
+
+    wxString name = parser.GetName();
+    wxString parent;
+    if (!names.IsEmpty())
+      parent = names.Last();
+
+    if (token == XmlPullParser::StartTag)
+    {
+      if (!parent.IsEmpty() && (children.Last()++ > 0))
+      {
+        if (parent == wxT("f"))
+          text += wxT("/");
+        else if ((parent == wxT("e")) || (parent == wxT("ie")))
+          text += wxT("^");
+        else if (parent == wxT("i"))
+          text += wxT("_");
+        else if ((parent == wxT("tb")) || (parent == wxT("mtr")))
+          text += wxT(", ");
+      }
+
+      if (parent == wxT("f"))
+        text += wxT("(");
+
+      if ((name == wxT("mth")) || (name == wxT("line")))
+      {
+        if (!text.IsEmpty() && !text.EndsWith(wxT("\n")))
+          text += wxT("\n");
+      }
+      else if (name == wxT("p"))
+        text += wxT("(");
+      else if (name == wxT("q"))
+        text += wxT("sqrt(");
+      else if (name == wxT("a"))
+        text += wxT("abs(");
+      else if (name == wxT("tb"))
+        text += wxT("matrix(");
+      else if (name == wxT("mtr"))
+        text += wxT("[");
+
+      names.Add(name);
+      children.Add(0);
+    }
+    else if (token == XmlPullParser::EndTag)
+    {
+      if (names.IsEmpty())
+        continue;
+      names.RemoveAt(names.GetCount() - 1);
+      children.RemoveAt(children.GetCount() - 1);
+      parent = wxEmptyString;
+      if (!names.IsEmpty())
+        parent = names.Last();
+
+      if ((name == wxT("p")) || (name == wxT("q")) || (name == wxT("a")) ||
+          (name == wxT("tb")))
+        text += wxT(")");
+      else if (name == wxT("mtr"))
+        text += wxT("]");
+      else if ((name == wxT("lbl")) && !text.EndsWith(wxT(" ")))
+        text += wxT(" ");
+
+      if (parent == wxT("f"))
+        text += wxT(")");
+    }
+  }
+  return text;
+}
@@ -0,0 +1,82 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+  The definition of the cell that displays output that is too long for
+  being converted to individual cells.
+*/
+
+#ifndef LONGOUTPUTCELL_H
+#define LONGOUTPUTCELL_H
+
+#include "MathCell.h"
+#include <vector>
+
+/*! A cell that displays many lines of plain text
+
+  Output that exceeds the length configured in the "show long expressions"
+  setting used to be replaced by a short notice. Instead it is now kept as
+  plain text in a single string that is stored in this cell. The text is
+  drawn in a fixed-width font so only the longest line has to be measured,
+  and only the lines that intersect the region that is to be redrawn are
+  drawn so the cost of displaying this cell doesn't depend on the length of
+  the output.
+*/
+class LongOutputCell : public MathCell
+{
+public:
+  LongOutputCell(wxString text = wxEmptyString);
+  ~LongOutputCell();
+  MathCell* Copy();
+  void Destroy();
+  //! Appends text to this cell. Lines are separated by '\\n'.
+  void AppendText(const wxString &text);
+  //! The number of lines this cell contains
+  size_t GetLineCount() { return m_lineStarts.size(); }
+  //! Returns line number line
+  wxString GetLine(size_t line);
+  void RecalculateWidths(CellParser& parser, int fontsize);
+  void Draw(CellParser& parser, wxPoint point, int fontsize);
+  wxString ToString();
+  wxString ToTeX();
+  wxString ToXML();
+  wxString GetValue() { return m_text; }
+  void SetValue(wxString text);
+  /*! Converts xml maxima has sent to plain text
+
+    Accepts everything MathParser::ParseLine() accepts, including compact
+    frames. The result is only an approximation of the 2D display: Fractions,
+    exponents and roots are written in maxima's linear notation.
+  */
+  static wxString XmlToText(const wxString &xml);
+protected:
+  void SetFont(CellParser& parser, int fontsize);
+  //! All lines, separated by '\\n'.
+  wxString m_text;
+  //! The index in m_text every line starts at
+  std::vector<size_t> m_lineStarts;
+  //! The number of the line with the most characters
+  size_t m_longestLine;
+  //! The height of a single line
+  int m_lineHeight;
+  int m_fontSize;
+};
+
+#endif // LONGOUTPUTCELL_H
@@ -20,6 +20,7 @@
 //
 
 #include "MathCell.h"
+#include <vector>
 
 MathCell::MathCell()
 {
@@ -46,13 +47,26 @@ MathCell::MathCell()
   m_textStyle = TS_VARIABLE;
   m_SuppressMultiplicationDot = false;
   m_imageBorderWidth = 0;
+  m_altCopyText = NULL;
 }
 
 /***
  * Derived classes must test if m_next equals NULL if it doesn't delete it!!!
  */
 MathCell::~MathCell()
-{}
+{
+  if (m_altCopyText != NULL)
+    delete m_altCopyText;
+}
+
+void MathCell::SetAltCopyText(wxString text)
+{
+  if (m_altCopyText != NULL)
+    delete m_altCopyText;
+  m_altCopyText = NULL;
+  if (text != wxEmptyString)
+    m_altCopyText = new wxString(text);
+}
 
 void MathCell::SetType(int type)
 {
@@ -170,42 +184,17 @@ MathCell* MathCell::GetParent()
 int MathCell::GetMaxCenter()
 {
   if (m_maxCenter < 0)
-  {
-    MathCell *tmp = this;
-    while(tmp != NULL)
-    {
-      m_maxCenter = MAX(m_maxCenter, tmp->m_center);
-      if(tmp->m_nextToDraw == NULL)
-        break;
-      if(tmp->m_nextToDraw->m_breakLine)
-        break;
-      tmp = tmp-> m_nextToDraw;
-    }
-  }
+    CalculateLineMetrics(1.0, false);
   return m_maxCenter;
 }
 
 /***
  * Get the maximum drop of cell.
-
-\todo Convert this function to not using recursive function calls any more.
  */
 int MathCell::GetMaxDrop()
 {
-
   if (m_maxDrop < 0)
-  {
-    MathCell *tmp = this;
-    while(tmp != NULL)
-    {
-      m_maxDrop = MAX(m_maxDrop, tmp->m_isBroken ? 0 : (tmp->m_height - tmp->m_center));
-      if(tmp->m_nextToDraw == NULL)
-        break;
-      if(tmp->m_nextToDraw->m_breakLine && !tmp->m_nextToDraw->m_isBroken)
-        break;
-      tmp = tmp-> m_nextToDraw;
-    }
-  }
+    CalculateLineMetrics(1.0, false);
   return m_maxDrop;
 }
 
@@ -239,23 +228,55 @@ int MathCell::GetFullWidth(double scale)
   return m_fullWidth;
 }
 
-/*! Get the width of this line.
-
-\todo Convert this function to not using recursive function calls any more.
- */
+//! Get the width of this line.
 int MathCell::GetLineWidth(double scale)
 {
-  int width = m_isBroken ? 0 : m_width;
   if (m_lineWidth == -1)
+    CalculateLineMetrics(scale, true);
+  return m_lineWidth;
+}
+
+void MathCell::CalculateLineMetrics(double scale, bool widths)
+{
+  // Collect the rest of the line. It ends before the next cell that starts a
+  // line and hasn't been broken up.
+  std::vector<MathCell *> line;
+  MathCell *tmp = this;
+  do
   {
-    if (m_nextToDraw == NULL || m_nextToDraw->m_breakLine ||
-        m_nextToDraw->m_type == MC_TYPE_MAIN_PROMPT)
-      m_lineWidth = width;
+    line.push_back(tmp);
+    tmp = tmp->m_nextToDraw;
+  }
+  while ((tmp != NULL) && !(tmp->m_breakLine && !tmp->m_isBroken));
+
+  // Every cell gets the metrics of the part of the line that starts with it
+  // => walk it backwards. Widths and centers end at every line break, drops
+  // only at those of cells that aren't broken up.
+  int width = 0, center = -1, drop = -1;
+  for (size_t i = line.size(); i > 0; i--)
+  {
+    tmp = line[i - 1];
+    MathCell *next = tmp->m_nextToDraw;
+    int cellWidth = tmp->m_isBroken ? 0 : tmp->m_width;
+
+    if ((next == NULL) || next->m_breakLine || (next->m_type == MC_TYPE_MAIN_PROMPT))
+      width = cellWidth;
     else
-      m_lineWidth = width + m_nextToDraw->GetLineWidth(scale) +
-                    SCALE_PX(MC_CELL_SKIP, scale);
+      width += cellWidth + SCALE_PX(MC_CELL_SKIP, scale);
+
+    if ((next == NULL) || next->m_breakLine)
+      center = -1;
+    if (i == line.size())
+      drop = -1;
+
+    center = MAX(center, tmp->m_center);
+    drop = MAX(drop, tmp->m_isBroken ? 0 : (tmp->m_height - tmp->m_center));
+
+    tmp->m_maxCenter = center;
+    tmp->m_maxDrop = drop;
+    if (widths)
+      tmp->m_lineWidth = width;
   }
-  return m_lineWidth;
 }
 
 /*! Draw this cell to dc
@@ -642,7 +663,8 @@ void MathCell::UnsetPen(CellParser& parser)
  */
 void MathCell::CopyData(MathCell* s, MathCell* t)
 {
-  t->m_altCopyText = s->m_altCopyText;
+  if (s->m_altCopyText != NULL)
+    t->SetAltCopyText(*s->m_altCopyText);
   t->m_forceBreakLine = s->m_forceBreakLine;
   t->m_type = s->m_type;
   t->m_textStyle = s->m_textStyle;
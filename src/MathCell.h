@@ -53,6 +53,7 @@
 #include <wx/wx.h>
 #include "CellParser.h"
 #include "TextStyle.h"
+#include "CellArena.h"
 
 /*! The supported types of math cells
  */
@@ -102,6 +103,9 @@ class MathCell
 public:
   MathCell();
   virtual ~MathCell();  
+  //! Cells are allocated from the CellArena the current thread has selected.
+  static void *operator new(size_t size) { return CellArena::Allocate(size); }
+  static void operator delete(void *memory, size_t size) { CellArena::Free(memory, size); }
   /*! Free all memory directly referenced by the contents of this cell
 
     This command (and the celltype-specific versions of the derived
@@ -238,10 +242,21 @@ public:
     See GetFullWidth().
    */
   int GetLineWidth(double scale);
+  /*! Calculates GetLineWidth(), GetMaxCenter() and GetMaxDrop() for the rest of this line
+
+    Fills in the caches of all cells up to the end of the line in a single
+    pass: Recursing from cell to cell overflows the stack on lines that
+    consist of hundreds of thousands of cells. Has to be called again if
+    cells have been appended to the line.
+
+    \param scale  The scale the line widths are calculated for
+    \param widths Calculate the line widths, too? Only GetLineWidth() knows the scale.
+   */
+  void CalculateLineMetrics(double scale, bool widths);
   //! Get the x position of the top left of this cell
   int GetCurrentX() { return m_currentPoint.x; }
   //! Get the y position of the top left of this cell
-  int GetCurrentY() { return m_currentPoint.y; }
+  virtual int GetCurrentY() { return m_currentPoint.y; }
   /*! Get the smallest rectangle this cell fits in
 
     \param all
@@ -264,7 +279,7 @@ public:
   //! Mark all cached size information as "to be calculated".
   void ResetData();
   //! Mark the cached height informations as "to be calculated".
-  void ResetSize() { m_width = m_height = -1; }
+  virtual void ResetSize() { m_width = m_height = -1; }
 
   void SetSkip(bool skip) { m_bigSkip = skip; }
   //! Sets the text style according to the type
@@ -377,14 +392,6 @@ public:
        between nummerator and denominator.
   */
   wxPoint m_currentPoint;  
-  bool m_bigSkip;
-  //! true means: Add a linebreak to the end of this cell.
-  bool m_isBroken;
-  /*! True means: This cell is a multiplication sign that isn't drawn.
-
-    Currently only the centered dots for multiplications fall in this category.
-   */
-  bool m_isHidden;
   /*! Determine if this cell contains text that won't be passed to maxima
 
     \return true, if this is a text cell, a title cell, a section, a subsection or a subsubsection cell.
@@ -432,7 +439,7 @@ public:
   void SetParentList(MathCell *parent);
   void SetStyle(int style) { m_textStyle = style; }
   bool IsMath();
-  void SetAltCopyText(wxString text) { m_altCopyText = text; }
+  void SetAltCopyText(wxString text);
   /*! Attach a copy of the list of cells that follows this one to a cell
     
     Used by MathCell::Copy() when the parameter <code>all</code> is true.
@@ -454,13 +461,31 @@ public:
     many => we need parenthesis cells to set this flag for the first cell in 
     their "inner cell" list.
    */
-  bool m_SuppressMultiplicationDot;
+  bool m_SuppressMultiplicationDot : 1;
+  /* The flags of a cell are stored as bit fields that are kept together with
+     the ones in the protected section: A worksheet can consist of millions of
+     cells. */
+  bool m_bigSkip : 1;
+  //! true means: Add a linebreak to the end of this cell.
+  bool m_isBroken : 1;
+  /*! True means: This cell is a multiplication sign that isn't drawn.
+
+    Currently only the centered dots for multiplications fall in this category.
+   */
+  bool m_isHidden : 1;
 
   /*! Set the size of the canvas our cells have to be drawn on
 
    */
   void SetCanvasSize(wxSize size) { m_canvasSize = size; }
 protected:
+  //! Does this cell begin with a forced page break?
+  bool m_breakPage : 1;
+  //! Are we allowed to add a linee break before this cell?
+  bool m_breakLine : 1;
+  //! true means we forcce this cell to begin with a line break.  
+  bool m_forceBreakLine : 1;
+  bool m_highlight : 1;
   /*! The GroupCell this list of cells belongs to.
     
     Reads NULL, if no parent cell has been set - which is treated as an Error by GetParent():
@@ -489,15 +514,12 @@ protected:
   int m_maxDrop;
   int m_type;
   int m_textStyle;
+  /*! The text that is to be copied to the clipboard instead of the cell's contents
 
-  //! Does this cell begin with a forced page break?
-  bool m_breakPage;
-  //! Are we allowed to add a linee break before this cell?
-  bool m_breakLine;
-  //! true means we forcce this cell to begin with a line break.  
-  bool m_forceBreakLine;
-  bool m_highlight;
-  wxString m_altCopyText; // m_altCopyText is not check in all cells!
+    Is NULL for nearly all cells and therefore only allocated if needed.
+    Is not checked by all cells.
+   */
+  wxString *m_altCopyText;
 };
 
 #endif // MATHCELL_H
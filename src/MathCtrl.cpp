@@ -31,6 +31,7 @@
 #include "GroupCell.h"
 #include "SlideShowCell.h"
 #include "ImgCell.h"
+#include "ScaledBitmapCache.h"
 #include "MarkDown.h"
 #include "ContentAssistantPopup.h"
 
@@ -45,6 +46,7 @@
 #include <wx/txtstrm.h>
 #include <wx/filesys.h>
 #include <wx/fs_mem.h>
+#include <limits.h>
 
 #define SCROLL_UNIT 10
 #define CARET_TIMER_TIMEOUT 500
@@ -72,7 +74,6 @@ wxScrolledCanvas(
   m_keyboardInactive = true;
   m_tree = NULL;
   m_mainToolBar = NULL;
-  m_memory = NULL;
   m_selectionStart = NULL;
   m_selectionEnd = NULL;
   m_clickType = CLICK_TYPE_NONE;
@@ -90,10 +91,15 @@ wxScrolledCanvas(
   m_timer.SetOwner(this, TIMER_ID);
   m_caretTimer.SetOwner(this, CARET_TIMER_ID);
   m_animationTimer.SetOwner(this, ANIMATION_TIMER_ID);
+  m_outputTimer.SetOwner(this, OUTPUT_TIMER_ID);
+  m_outputGroup = NULL;
+  m_unlayoutedOutputGroup = NULL;
   AnimationRunning(false);
   m_saved = false;
   m_zoomFactor = 1.0; // set zoom to 100%
   m_evaluationQueue = new EvaluationQueue();
+  m_ioStatistics = new IOStatistics();
+  ScaledBitmapCache::Get()->SetHandler(this, SCALED_BITMAP_ID);
   AdjustSize();
   m_autocompleteTemplates = false;
 
@@ -106,18 +112,20 @@ wxScrolledCanvas(
 MathCtrl::~MathCtrl() {
   if (m_tree != NULL)
     DestroyTree();
-  if (m_memory != NULL)
-    delete m_memory;
+  ScaledBitmapCache::Get()->SetHandler(NULL, SCALED_BITMAP_ID);
 
   delete m_evaluationQueue;
+  delete m_ioStatistics;
 }
 
 /***
  * Redraw the control
  */
 void MathCtrl::OnPaint(wxPaintEvent& event) {
+  // Layouting here would schedule a second repaint from within this one =>
+  // pending layout work is done by the output timer and by OnIdle().
+  IOTimer timer(m_ioStatistics, IOStatistics::paint);
   wxPaintDC dc(this);
-  wxMemoryDC dcm;
 
   // Get the font size
   wxConfig *config = (wxConfig *)wxConfig::Get();
@@ -125,32 +133,265 @@ void MathCtrl::OnPaint(wxPaintEvent& event) {
   // Prepare data
   wxRect rect = GetUpdateRegion().GetBox();
   // printf("Updating rect [%d, %d] -> [%d, %d]\n", rect.x, rect.y, rect.width, rect.height);
-  wxSize sz = GetSize();
-  int tmp, top, bottom, drop;
-  CalcUnscrolledPosition(0, rect.GetTop(), &tmp, &top);
-  CalcUnscrolledPosition(0, rect.GetBottom(), &tmp, &bottom);
+  wxRect region(rect);
+  CalcUnscrolledPosition(rect.x, rect.y, &region.x, &region.y);
 
-  // Thest if m_memory is NULL (resize event)
-  if (m_memory == NULL) {
-    m_memory = new wxBitmap();
-    m_memory->CreateScaled (sz.x, sz.y, -1, dc.GetContentScaleFactor ());
-  }
-  // Prepare memory DC
   wxString bgColStr= wxT("white");
   config->Read(wxT("Style/Background/color"), &bgColStr);
   SetBackgroundColour(wxColour(bgColStr));
 
-  dcm.SelectObject(*m_memory);
-  dcm.SetBackground(*(wxTheBrushList->FindOrCreateBrush(GetBackgroundColour(), wxBRUSHSTYLE_SOLID)));
-  dcm.Clear();
-  PrepareDC(dcm);
-  dcm.SetMapMode(wxMM_TEXT);
-  dcm.SetBackgroundMode(wxTRANSPARENT);
-  dcm.SetLogicalFunction(wxCOPY);
+  m_tiles.SetScaleFactor(dc.GetContentScaleFactor());
+
+  // Neither the selection nor the settings change while we paint.
+  std::vector<wxRect> selection;
+  GetSelectionRects(selection);
+  bool changeAsterisk = false;
+  config->Read(wxT("changeAsterisk"), &changeAsterisk);
+
+  // Draw the outdated parts of all tiles that intersect with the region and
+  // copy the region from the tiles to the window.
+  int firstColumn = MAX(region.GetLeft(), 0) / TILECACHE_TILE_SIZE;
+  int lastColumn = MAX(region.GetRight(), 0) / TILECACHE_TILE_SIZE;
+  int firstRow = MAX(region.GetTop(), 0) / TILECACHE_TILE_SIZE;
+  int lastRow = MAX(region.GetBottom(), 0) / TILECACHE_TILE_SIZE;
+  std::vector<TileCache::Tile *> tiles;
+  for (int row = firstRow; row <= lastRow; row++)
+  {
+    // Walking through the cells costs as much as drawing them => the
+    // outdated parts of all tiles of a row are drawn in a single pass and
+    // then copied to the tiles.
+    tiles.clear();
+    wxRect dirty;
+    for (int column = firstColumn; column <= lastColumn; column++)
+    {
+      TileCache::Tile *tile = m_tiles.GetTile(column, row);
+      tiles.push_back(tile);
+      if (tile->m_dirty.IsEmpty())
+        continue;
+      if (dirty.IsEmpty())
+        dirty = tile->m_dirty.GetBox();
+      else
+        dirty.Union(tile->m_dirty.GetBox());
+    }
+
+    if (!dirty.IsEmpty())
+    {
+      wxMemoryDC dcb;
+      dcb.SelectObject(m_tiles.GetBuffer(dirty.GetSize()));
+      dcb.SetDeviceOrigin(-dirty.x, -dirty.y);
+      dcb.SetMapMode(wxMM_TEXT);
+      dcb.SetBackgroundMode(wxTRANSPARENT);
+      dcb.SetLogicalFunction(wxCOPY);
+      dcb.SetClippingRegion(dirty);
+      PaintContent(dcb, dirty, selection, changeAsterisk);
+      dcb.DestroyClippingRegion();
+
+      for (size_t i = 0; i < tiles.size(); i++)
+      {
+        TileCache::Tile *tile = tiles[i];
+        if (tile->m_dirty.IsEmpty())
+          continue;
+        wxRect box = tile->m_dirty.GetBox();
+        wxMemoryDC dcm;
+        dcm.SelectObject(tile->m_bitmap);
+        dcm.Blit(box.x - tile->m_rect.x, box.y - tile->m_rect.y,
+                 box.width, box.height, &dcb, box.x, box.y);
+        tile->m_dirty.Clear();
+      }
+    }
+
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+      TileCache::Tile *tile = tiles[i];
+      wxRect part = tile->m_rect.Intersect(region);
+      if (part.IsEmpty())
+        continue;
+      wxMemoryDC dcm;
+      dcm.SelectObject(tile->m_bitmap);
+      int x, y;
+      CalcScrolledPosition(part.x, part.y, &x, &y);
+      dc.Blit(x, y, part.width, part.height, &dcm,
+              part.x - tile->m_rect.x, part.y - tile->m_rect.y);
+    }
+  }
+}
+
+void MathCtrl::GetSelectionRects(std::vector<wxRect> &rects) {
+  if (m_selectionStart == NULL)
+    return;
+
+  MathCell* tmp = m_selectionStart;
+  if (m_selectionStart->GetType() == MC_TYPE_GROUP) // selection of groups
+  {
+    while (tmp != NULL)
+    {
+      wxRect rect = tmp->GetRect();
+      // TODO globally define x coordinates of the left GC brackets
+      rects.push_back(wxRect(3, rect.GetTop() - 2, MC_GROUP_LEFT_INDENT, rect.GetHeight() + 5));
+
+      if (tmp == m_selectionEnd)
+        break;
+      tmp = tmp->m_next;
+    }
+  }
+  else {  // We have a selection of output
+    // Only the lines that have been drawn know their position.
+    GroupCell *group = dynamic_cast<GroupCell *>(m_selectionStart->GetParent());
+    if (group != NULL)
+      group->PlaceOutputCells(m_selectionStart, m_selectionEnd);
+
+    while (tmp != NULL) {
+      if (!tmp->m_isBroken && !tmp->m_isHidden && m_activeCell != tmp) {
+        wxRect rect = tmp->GetRect();
+        if ((tmp->GetType() == MC_TYPE_IMAGE) || (tmp->GetType() == MC_TYPE_SLIDE))
+          rect.Inflate(5); // draw 5 pixels of border for img/slide cells
+        rects.push_back(rect);
+      }
+      if (tmp == m_selectionEnd)
+        break;
+      tmp = tmp->m_nextToDraw;
+    }
+  }
+}
+
+void MathCtrl::Refresh(bool eraseBackground, const wxRect *rect) {
+  if (rect == NULL)
+    m_tiles.InvalidateAll();
+  else
+  {
+    wxRect region(*rect);
+    CalcUnscrolledPosition(rect->x, rect->y, &region.x, &region.y);
+    m_tiles.Invalidate(region);
+  }
+  wxScrolledCanvas::Refresh(eraseBackground, rect);
+}
+
+void MathCtrl::RefreshBand(int top, int bottom, int right) {
+  // A band that reaches down to INT_MAX can't be expressed as a wxRect.
+  bool fullWidth = (right < 0) || (bottom == INT_MAX);
+  if (fullWidth)
+    m_tiles.InvalidateBand(top, bottom);
+  else
+    m_tiles.Invalidate(wxRect(0, top, right + 1, bottom - top + 1));
+
+  wxSize size = GetClientSize();
+  int left, tmp;
+  CalcScrolledPosition(0, top, &left, &top);
+  CalcScrolledPosition(0, bottom, &tmp, &bottom);
+  if (fullWidth)
+    right = size.x - 1;
+  else
+  {
+    CalcScrolledPosition(right, 0, &right, &tmp);
+    right = MIN(right, size.x - 1);
+  }
+  left = MAX(left, 0);
+  top = MAX(top, 0);
+  bottom = MIN(bottom, size.y - 1);
+  if ((bottom < top) || (right < left))
+    return;
+
+  wxRect rect(left, top, right - left + 1, bottom - top + 1);
+  wxScrolledCanvas::Refresh(true, &rect);
+}
+
+int MathCtrl::GetGroupRight(size_t index) {
+  // Selections of output cells reach a few pixels into the space right of
+  // the group.
+  return MC_GROUP_LEFT_INDENT + m_groupLayout.GetGroupWidth(index) + MC_BASE_INDENT;
+}
+
+void MathCtrl::RefreshCell(MathCell *cell) {
+  if (cell == NULL)
+    return;
+
+  // If the list of groups has changed the cell might have been moved.
+  if (!m_groupLayout.IsValid(m_tree, m_last))
+  {
+    Refresh();
+    return;
+  }
+
+  if (cell->GetType() == MC_TYPE_GROUP)
+  {
+    RefreshGroup(dynamic_cast<GroupCell *>(cell));
+    return;
+  }
 
-  CellParser parser(dcm);
+  wxRect rect = cell->GetRect();
+  // Broken cells don't know their rectangle.
+  if (rect.IsEmpty())
+  {
+    RefreshGroup(dynamic_cast<GroupCell *>(cell->GetParent()));
+    return;
+  }
+
+  // Everything right of the cell up to the end of its group
+  GroupCell *group = dynamic_cast<GroupCell *>(cell->GetParent());
+  int right = -1;
+  if (group != NULL)
+  {
+    size_t index = group->GetLayoutIndex();
+    if (m_groupLayout.Contains(group, index))
+      right = GetGroupRight(index);
+  }
+  if (right < rect.GetRight())
+    right = GetVirtualSize().x;
+  RefreshBand(rect.GetTop(), rect.GetBottom(), right);
+}
+
+void MathCtrl::RefreshGroup(GroupCell *group) {
+  if (group == NULL)
+    return;
+
+  size_t index = group->GetLayoutIndex();
+  if (!m_groupLayout.IsValid(m_tree, m_last) || !m_groupLayout.Contains(group, index))
+  {
+    // We don't know for sure where the group is.
+    Refresh();
+    return;
+  }
+
+  // The selection and queue markers reach a few pixels into the space above
+  // the group and the horizontal cursor is drawn into the space below it.
+  int top = m_groupLayout.GetTop(index);
+  RefreshBand(top - MC_GROUP_SKIP, top + m_groupLayout.GetSpace(index),
+              GetGroupRight(index));
+}
+
+void MathCtrl::RefreshHCaret(GroupCell *group) {
+  if (!m_groupLayout.IsValid(m_tree, m_last))
+  {
+    Refresh();
+    return;
+  }
+
+  int y = 5;
+  if (group != NULL)
+  {
+    // The group might have been deleted since the cursor was placed below it.
+    if ((m_tree == NULL) || !m_tree->Contains(group))
+      return;
+    y = ((int) MC_GROUP_SKIP) / 2 + group->GetRect().GetBottom() + 1;
+  }
+  RefreshBand(y - 1, y + 1);
+}
+
+void MathCtrl::PaintContent(wxDC &dc, const wxRect &rect,
+                            const std::vector<wxRect> &selection,
+                            bool changeAsterisk) {
+  int top = rect.GetTop();
+  int bottom = rect.GetBottom();
+  int drop;
+
+  dc.SetPen(*wxTRANSPARENT_PEN);
+  dc.SetBrush(*(wxTheBrushList->FindOrCreateBrush(GetBackgroundColour(), wxBRUSHSTYLE_SOLID)));
+  dc.DrawRectangle(rect);
+
+  CellParser parser(dc);
   parser.SetBounds(top, bottom);
   parser.SetZoomFactor(m_zoomFactor);
+  parser.SetPreviewImages(true);
   int fontsize = parser.GetDefaultFontSize(); // apply zoomfactor to defaultfontsize
 
   // Draw content
@@ -159,66 +400,61 @@ void MathCtrl::OnPaint(wxPaintEvent& event) {
     //
     // First draw selection under content with wxCOPY and selection brush/color
     //
-    if (m_selectionStart != NULL)
+    if (!selection.empty())
     {
-      MathCell* tmp = m_selectionStart;
-
 #if defined(__WXMAC__)
-      dcm.SetPen(wxNullPen); // wxmac doesn't like a border with wxXOR
+      dc.SetPen(wxNullPen); // wxmac doesn't like a border with wxXOR
 #else
-      dcm.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_SELECTION), 1, wxPENSTYLE_SOLID)));
+      dc.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_SELECTION), 1, wxPENSTYLE_SOLID)));
 // window linux, set a pen
 #endif
-      dcm.SetBrush( *(wxTheBrushList->FindOrCreateBrush(parser.GetColor(TS_SELECTION)))); //highlight c.
+      dc.SetBrush( *(wxTheBrushList->FindOrCreateBrush(parser.GetColor(TS_SELECTION)))); //highlight c.
 
-      if (m_selectionStart->GetType() == MC_TYPE_GROUP) // selection of groups
-      {
-        while (tmp != NULL)
-        {
-          wxRect rect = tmp->GetRect();
-          // TODO globally define x coordinates of the left GC brackets
-          dcm.DrawRectangle( 3, rect.GetTop() - 2, MC_GROUP_LEFT_INDENT, rect.GetHeight() + 5);
-
-          if (tmp == m_selectionEnd)
-	    break;
-          tmp = tmp->m_next;
-        }
-
-      }
-      else {  // We have a selection of output
-        while (tmp != NULL) {
-          if (!tmp->m_isBroken && !tmp->m_isHidden && m_activeCell != tmp) {
-            if ((tmp->GetType() == MC_TYPE_IMAGE) || (tmp->GetType() == MC_TYPE_SLIDE))
-              tmp->DrawBoundingBox(dcm, false, 5); // draw 5 pixels of border for img/slide cells
-            else
-              tmp->DrawBoundingBox(dcm, false);
-          }
-          if (tmp == m_selectionEnd)
-            break;
-          tmp = tmp->m_nextToDraw;
-        } // end while (1)
-      }
+      for (size_t i = 0; i < selection.size(); i++)
+        if (selection[i].Intersects(rect))
+          dc.DrawRectangle(selection[i]);
     }
+    //
+    // Find the first group cell that is visible. If the index of the group
+    // positions is up to date we don't need to walk through all the cells
+    // above it.
+    //
+    GroupCell *first = m_tree;
+    wxPoint point;
+    point.x = MC_GROUP_LEFT_INDENT;
+    point.y = MC_BASE_INDENT + m_tree->GetMaxCenter();
+    if (m_groupLayout.IsValid(m_tree, m_last) && (m_groupLayout.GetCount() > 0))
+    {
+      size_t index = m_groupLayout.FindIndex(top);
+      // The brackets of the group above might reach into the region, too.
+      if (index > 0)
+        index--;
+      first = m_groupLayout.GetGroup(index);
+      point.y = m_groupLayout.GetY(index);
+    }
+
     //
     // Mark groupcells currently in queue. TODO better in gc::draw?
     //
     if (m_evaluationQueue->GetCell() != NULL) {
-      MathCell* tmp = m_tree;
-      dcm.SetBrush(*wxTRANSPARENT_BRUSH);
+      MathCell* tmp = first;
+      dc.SetBrush(*wxTRANSPARENT_BRUSH);
       while (tmp != NULL)
       {
+        if (tmp->GetRect().GetTop() - 2 > bottom)
+          break;
         if (m_evaluationQueue->IsInQueue(dynamic_cast<GroupCell*>(tmp))) {
           if (m_evaluationQueue->GetCell() == tmp)
           {
             wxRect rect = tmp->GetRect();
-            dcm.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_CELL_BRACKET), 2, wxPENSTYLE_SOLID)));
-            dcm.DrawRectangle( 3, rect.GetTop() - 2, MC_GROUP_LEFT_INDENT, rect.GetHeight() + 5);
+            dc.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_CELL_BRACKET), 2, wxPENSTYLE_SOLID)));
+            dc.DrawRectangle( 3, rect.GetTop() - 2, MC_GROUP_LEFT_INDENT, rect.GetHeight() + 5);
           }
           else
           {
             wxRect rect = tmp->GetRect();
-            dcm.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_CELL_BRACKET), 1, wxPENSTYLE_SOLID)));
-            dcm.DrawRectangle( 3, rect.GetTop() - 2, MC_GROUP_LEFT_INDENT, rect.GetHeight() + 5);
+            dc.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_CELL_BRACKET), 1, wxPENSTYLE_SOLID)));
+            dc.DrawRectangle( 3, rect.GetTop() - 2, MC_GROUP_LEFT_INDENT, rect.GetHeight() + 5);
           }
         }
         tmp = tmp->m_next;
@@ -227,22 +463,19 @@ void MathCtrl::OnPaint(wxPaintEvent& event) {
     //
     // Draw content over
     //
-    wxPoint point;
-    point.x = MC_GROUP_LEFT_INDENT;
-    point.y = MC_BASE_INDENT + m_tree->GetMaxCenter();
-    // Draw tree
-    MathCell* tmp = m_tree;
+    MathCell* tmp = first;
     drop = tmp->GetMaxDrop();
 
-    dcm.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_DEFAULT), 1, wxPENSTYLE_SOLID)));
-    dcm.SetBrush(*(wxTheBrushList->FindOrCreateBrush(parser.GetColor(TS_DEFAULT))));
+    dc.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_DEFAULT), 1, wxPENSTYLE_SOLID)));
+    dc.SetBrush(*(wxTheBrushList->FindOrCreateBrush(parser.GetColor(TS_DEFAULT))));
 
-    bool changeAsterisk = false;
-    config->Read(wxT("changeAsterisk"), &changeAsterisk);
     parser.SetChangeAsterisk(changeAsterisk);
 
     while (tmp != NULL)
     {
+      // The cells below the region we redraw don't need to be looked at.
+      if (point.y - tmp->GetMaxCenter() > bottom)
+        break;
       tmp->m_currentPoint.x = point.x;
       tmp->m_currentPoint.y = point.y;
       if (tmp->DrawThisCell(parser, point))
@@ -262,21 +495,17 @@ void MathCtrl::OnPaint(wxPaintEvent& event) {
   //
   if (m_hCaretActive && m_hCaretPositionStart == NULL)
   {
-    dcm.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_CURSOR), 1, wxPENSTYLE_SOLID))); // TODO is there more efficient way to do this?
+    dc.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_CURSOR), 1, wxPENSTYLE_SOLID))); // TODO is there more efficient way to do this?
 
     if (m_hCaretPosition == NULL)
-      dcm.DrawLine( 0, 5, 3000, 5);
+      dc.DrawLine( 0, 5, 3000, 5);
     else {
       wxRect currentGCRect = m_hCaretPosition->GetRect();
       int caretY = ((int) MC_GROUP_SKIP) / 2 + currentGCRect.GetBottom() + 1;
-      dcm.DrawLine( 0, caretY, 3000,  caretY);
+      dc.DrawLine( 0, caretY, 3000,  caretY);
     }
     
   }
-  // Blit the memory image to the window
-  dcm.SetDeviceOrigin(0, 0);
-  dc.Blit(0, rect.GetTop(), sz.x, rect.GetBottom() - rect.GetTop() + 1, &dcm,
-          0, rect.GetTop());
 }
 
 GroupCell *MathCtrl::InsertGroupCells(GroupCell* cells,GroupCell* where)
@@ -334,6 +563,7 @@ GroupCell *MathCtrl::InsertGroupCells(
     m_last = lastOfCellsToInsert;
   
   m_tree->SetCanvasSize(GetClientSize());
+  m_groupLayout.Invalidate();
   if (renumbersections)
     NumberSections();
   Recalculate();
@@ -362,10 +592,8 @@ GroupCell *MathCtrl::UpdateMLast()
   return m_last;
 }
 
-void MathCtrl::InsertLine(MathCell *newCell, bool forceNewLine)
+GroupCell *MathCtrl::GetInsertGroup()
 {
-  m_saved = false;
-
   GroupCell *tmp = m_workingGroup;
 
   // If there is no working group we take the last cell maxima evaluated
@@ -390,45 +618,102 @@ void MathCtrl::InsertLine(MathCell *newCell, bool forceNewLine)
   {
     tmp = m_last;
   }
-      
-  // If we still don't have a place to put the line we give up.
+
+  return tmp;
+}
+
+CellArena *MathCtrl::GetOutputArena()
+{
+  GroupCell *group = GetInsertGroup();
+  if (group == NULL)
+    return NULL;
+  return group->GetOutputArena();
+}
+
+void MathCtrl::InsertLine(MathCell *newCell, bool forceNewLine)
+{
+  m_saved = false;
+
+  GroupCell *tmp = GetInsertGroup();
+
+  // If we don't have a place to put the line we give up.
   if (tmp == NULL)
     return;
 
-  if(m_tree->Contains(tmp))
-  {     
-    newCell->ForceBreakLine(forceNewLine);
-    newCell->SetParentList(tmp);
-    
-    tmp->AppendOutput(newCell);
+  // Output that goes to another cell than the lines that are still waiting
+  // for being displayed mustn't overtake them.
+  if((m_outputGroup != NULL) && (m_outputGroup != tmp))
+    FlushOutput();
+
+  newCell->ForceBreakLine(forceNewLine);
+  newCell->SetParentList(tmp);
     
-    wxClientDC dc(this);
-    CellParser parser(dc);
-    parser.SetZoomFactor(m_zoomFactor);
-    parser.SetClientWidth(GetClientSize().GetWidth() - MC_GROUP_LEFT_INDENT - MC_BASE_INDENT);
+  tmp->AppendOutput(newCell);
+  m_outputGroup = m_unlayoutedOutputGroup = tmp;
 
-    tmp->RecalculateAppended(parser);
-    Recalculate();
+  // Layouting and repainting is done for all lines that arrive within the
+  // next few milliseconds at once.
+  if(!m_outputTimer.IsRunning())
+    m_outputTimer.StartOnce(16);
+}
 
-    if(FollowEvaluation()) {
-      SetSelection(NULL);
-      if(GCContainsCurrentQuestion(tmp))
-      {
-        OpenQuestionCaret();
-      }
-      else
-      {
-        SetHCaret(tmp);
-        ScrollToCaret();
-      }
+void MathCtrl::LayoutAppendedOutput()
+{
+  GroupCell *group = m_unlayoutedOutputGroup;
+  m_unlayoutedOutputGroup = NULL;
+  if(group == NULL)
+    return;
+
+  wxClientDC dc(this);
+  CellParser parser(dc);
+  parser.SetZoomFactor(m_zoomFactor);
+  parser.SetClientWidth(GetClientSize().GetWidth() - MC_GROUP_LEFT_INDENT - MC_BASE_INDENT);
+
+  group->RecalculateAppended(parser);
+  m_groupLayout.SetDirty(group);
+}
+
+void MathCtrl::ForgetOutputGroup(MathCell *start, MathCell *end)
+{
+  while (start != NULL)
+  {
+    if (start == m_outputGroup)
+      m_outputGroup = NULL;
+    if (start == m_unlayoutedOutputGroup)
+      m_unlayoutedOutputGroup = NULL;
+    if (start == end)
+      break;
+    start = start->m_next;
+  }
+  if ((m_outputGroup == NULL) && (m_unlayoutedOutputGroup == NULL))
+    m_outputTimer.Stop();
+}
+
+void MathCtrl::FlushOutput()
+{
+  m_outputTimer.Stop();
+  GroupCell *tmp = m_outputGroup;
+  m_outputGroup = NULL;
+  if(tmp == NULL)
+    return;
+
+  // Also layouts the lines that have been appended to tmp.
+  Recalculate();
+
+  if(FollowEvaluation()) {
+    SetSelection(NULL);
+    if(GCContainsCurrentQuestion(tmp))
+    {
+      OpenQuestionCaret();
     }
     else
-      Refresh();
+    {
+      SetHCaret(tmp);
+      ScrollToCaret();
+    }
   }
   else
-  {
-    wxASSERT_MSG(m_tree->Contains(tmp),_("Bug: Trying to append maxima's output to a cell outside the worksheet."));
-  }
+    RefreshGroup(tmp);
 }
 
 void MathCtrl::SetZoomFactor(double newzoom, bool recalc)
@@ -467,6 +752,13 @@ void MathCtrl::SetZoomFactor(double newzoom, bool recalc)
 
 void MathCtrl::Recalculate(bool force)
 {
+  IOTimer timer(m_ioStatistics, IOStatistics::layout);
+
+  // GroupCell::Recalculate() only updates groups whose size is unknown =>
+  // output lines that have been appended recently have to be handled
+  // separately.
+  LayoutAppendedOutput();
+
   GroupCell *tmp = m_tree;
 
   if(m_tree)
@@ -480,20 +772,47 @@ void MathCtrl::Recalculate(bool force)
   int d_fontsize = parser.GetDefaultFontSize();
   int m_fontsize = parser.GetMathFontSize();
 
-  wxPoint point;
-  point.x = MC_GROUP_LEFT_INDENT;
-  point.y = MC_BASE_INDENT ;
+  if(!force && m_groupLayout.IsValid(m_tree, m_last))
+  {
+    // Only the cells whose size has changed have to be laid out again.
+    // The cells below them learn their new position from m_groupLayout
+    // when they are asked for it.
+    std::vector<GroupCell *> dirty = m_groupLayout.TakeDirty();
+    for(size_t i = 0; i < dirty.size(); i++)
+    {
+      size_t index = dirty[i]->GetLayoutIndex();
+      // The selection and queue markers reach a few pixels into the space
+      // above the group.
+      int top = m_groupLayout.GetTop(index) - MC_GROUP_SKIP;
+      int bottom = m_groupLayout.GetTop(index) + m_groupLayout.GetSpace(index);
+      int right = GetGroupRight(index);
+      dirty[i]->Recalculate(parser, d_fontsize, m_fontsize);
+      // If the group has changed its height all groups below it have moved.
+      // Else only the part of the worksheet it has drawn to before and
+      // draws to now has changed.
+      if(m_groupLayout.Update(dirty[i]))
+        RefreshBand(top, INT_MAX);
+      else
+        RefreshBand(top, bottom, MAX(right, GetGroupRight(index)));
+    }
+  }
+  else
+  {
+    wxPoint point;
+    point.x = MC_GROUP_LEFT_INDENT;
+    point.y = MC_BASE_INDENT ;
 
-  while (tmp != NULL) {
-    tmp->Recalculate(parser, d_fontsize, m_fontsize);
-//    tmp->RecalculateWidths(parser, MAX(fontsize, MC_MIN_SIZE), false);
-//    tmp->RecalculateSize(parser, MAX(fontsize, MC_MIN_SIZE), false);
-    point.y += tmp->GetMaxCenter();
-    tmp->m_currentPoint.x = point.x;
-    tmp->m_currentPoint.y = point.y;
-    point.y += tmp->GetMaxDrop();
-    tmp = dynamic_cast<GroupCell*>(tmp->m_next);
-    point.y += MC_GROUP_SKIP;
+    while (tmp != NULL) {
+      tmp->Recalculate(parser, d_fontsize, m_fontsize);
+      point.y += tmp->GetMaxCenter();
+      tmp->m_currentPoint.x = point.x;
+      tmp->m_currentPoint.y = point.y;
+      point.y += tmp->GetMaxDrop();
+      tmp = dynamic_cast<GroupCell*>(tmp->m_next);
+      point.y += MC_GROUP_SKIP;
+    }
+    m_groupLayout.Rebuild(m_tree);
+    Refresh();
   }
   
   AdjustSize();
@@ -501,11 +820,26 @@ void MathCtrl::Recalculate(bool force)
   UpdateTableOfContents();
 }
 
+void MathCtrl::OnIdle(wxIdleEvent& event)
+{
+  // Cells that have been changed since the last Recalculate() don't know
+  // their size yet. Output lines are handled by the output timer.
+  if(m_groupLayout.HasDirty())
+    Recalculate();
+  event.Skip();
+}
+
 /***
  * Resize the control
  */
 void MathCtrl::OnSize(wxSizeEvent& event) {
-  wxDELETE(m_memory);
+  // A window that isn't aligned to the tile grid touches one more row and
+  // column of tiles than fit into it.
+  wxSize size = GetClientSize();
+  m_tiles.SetVisibleTiles(
+    ((size.x + TILECACHE_TILE_SIZE - 1) / TILECACHE_TILE_SIZE + 1) *
+    ((size.y + TILECACHE_TILE_SIZE - 1) / TILECACHE_TILE_SIZE + 1));
+  m_tiles.Clear();
 
   // Determine if we have a sane thing we can scroll to.
   MathCell *CellToScrollTo = NULL;
@@ -631,6 +965,7 @@ bool MathCtrl::IsLesserGCType(int type, int comparedTo) {
 void MathCtrl::FoldOccurred() {
   SetSaved(false);
   UpdateMLast();
+  m_groupLayout.Invalidate();
 }
 
 /**
@@ -717,6 +1052,8 @@ GroupCell *MathCtrl::TearOutTree(GroupCell *start, GroupCell *end) {
   MathCell *prev = start->m_previous;
   MathCell *next = end->m_next;
 
+  ForgetOutputGroup(start, end);
+
   end->m_next = end->m_nextToDraw = NULL;
   start->m_previous = start->m_previousToDraw = NULL;
 
@@ -727,6 +1064,7 @@ GroupCell *MathCtrl::TearOutTree(GroupCell *start, GroupCell *end) {
   // fix m_last if we tore it
   if (end == m_last)
     m_last = dynamic_cast<GroupCell*>(prev);
+  m_groupLayout.Invalidate();
 
   return start;
 }
@@ -1197,9 +1535,7 @@ void MathCtrl::ClickNDrag(wxPoint down, wxPoint up)
         wxClientDC dc(this);
         m_activeCell->SelectRectText(dc, down, up);
         m_switchDisplayCaret = false;
-        wxRect rect = m_activeCell->GetRect();
-        CalcScrolledPosition(rect.x, rect.y, &rect.x, &rect.y);
-        RefreshRect(rect);
+        RefreshCell(m_activeCell);
       }
       break;
     }
@@ -1607,6 +1943,11 @@ void MathCtrl::DeleteRegion(GroupCell *start,GroupCell *end,std::list <TreeUndoA
   m_hCaretPositionStart = m_hCaretPositionEnd = NULL;
 
   m_saved = false;
+  m_groupLayout.Invalidate();
+
+  // Maxima's output mustn't be appended to cells that are now part of the
+  // undo buffer.
+  ForgetOutputGroup(start, end);
 
   SetActiveCell(NULL, false);
   m_hCaretActive = false;
@@ -2119,33 +2460,25 @@ void MathCtrl::OnCharInActive(wxKeyEvent& event) {
         (group->GetGroupType() == GC_TYPE_CODE) &&
         (m_activeCell == group->GetEditable()))
       group->ResetInputLabel();
+    // Also repaints everything that has moved.
     Recalculate();
-    Refresh();
+    RefreshGroup(group);
   }
   else
   {
+    // All occurrences of the selected text in the worksheet are highlighted.
     if(m_activeCell->m_selectionChanged)
-    {
       Refresh();
-    }
     /// Otherwise refresh only the active cell
-    else {
-      wxRect rect;
-      if (m_activeCell->CheckChanges()) {
-        GroupCell *group = dynamic_cast<GroupCell*>(m_activeCell->GetParent());
-        if ((group->GetGroupType() == GC_TYPE_CODE) &&
-            (m_activeCell == group->GetEditable()))
-          group->ResetInputLabel();
-        rect = group->GetRect();
-        rect.width = GetVirtualSize().x;
-      }
-      else {
-        rect = m_activeCell->GetRect();
-        rect.width = GetVirtualSize().x;
-      }
-      CalcScrolledPosition(rect.x, rect.y, &rect.x, &rect.y);
-      RefreshRect(rect);
+    else if (m_activeCell->CheckChanges()) {
+      GroupCell *group = dynamic_cast<GroupCell*>(m_activeCell->GetParent());
+      if ((group->GetGroupType() == GC_TYPE_CODE) &&
+          (m_activeCell == group->GetEditable()))
+        group->ResetInputLabel();
+      RefreshGroup(group);
     }
+    else
+      RefreshCell(m_activeCell);
   }
   if(GetActiveCell())
   {
@@ -2537,6 +2870,14 @@ void MathCtrl::OnChar(wxKeyEvent& event) {
  * Get maximum x and y in the tree.
  */
 void MathCtrl::GetMaxPoint(int* width, int* height) {
+  if (m_groupLayout.IsValid(m_tree, m_last)) {
+    *width = MC_BASE_INDENT;
+    if (m_groupLayout.GetCount() > 0)
+      *width = MAX(2 * MC_BASE_INDENT + m_groupLayout.GetWidth(), *width);
+    *height = MC_BASE_INDENT + m_groupLayout.GetHeight();
+    return;
+  }
+
   MathCell* tmp = m_tree;
   int currentHeight= MC_BASE_INDENT;
   int currentWidth= MC_BASE_INDENT;
@@ -2600,9 +2941,7 @@ void MathCtrl::StepAnimation(int change)
   tmp->SetDisplayedIndex(pos);
 
   // Refresh the displayed bitmap
-  wxRect rect = m_selectionStart->GetRect();
-  CalcScrolledPosition(rect.x, rect.y, &rect.x, &rect.y);
-  RefreshRect(rect);
+  RefreshCell(m_selectionStart);
 
   // Set the slider to its new value
   if(m_mainToolBar)
@@ -2614,6 +2953,16 @@ void MathCtrl::StepAnimation(int change)
     m_animationTimer.StartOnce(1000/tmp->GetFrameRate());
 }
 
+void MathCtrl::OnScaledBitmapReady(wxThreadEvent& event) {
+  std::vector<wxRect> improved = ScaledBitmapCache::Get()->TakeResults();
+  for (size_t i = 0; i < improved.size(); i++)
+  {
+    wxRect rect = improved[i];
+    CalcScrolledPosition(rect.x, rect.y, &rect.x, &rect.y);
+    RefreshRect(rect);
+  }
+}
+
 void MathCtrl::OnTimer(wxTimerEvent& event) {
   switch (event.GetId()) {
   case TIMER_ID:
@@ -2648,15 +2997,16 @@ void MathCtrl::OnTimer(wxTimerEvent& event) {
       AnimationRunning(false);
   }
   break;
+  case OUTPUT_TIMER_ID:
+    FlushOutput();
+    break;
   case CARET_TIMER_ID:
   {
     if (m_activeCell != NULL) {
       if (m_switchDisplayCaret) {
         m_activeCell->SwitchCaretDisplay();
         
-        wxRect rect = m_activeCell->GetRect();
-        CalcScrolledPosition(rect.x, rect.y, &rect.x, &rect.y);
-        RefreshRect(rect);
+        RefreshCell(m_activeCell);
       }
       m_switchDisplayCaret = true;
     }
@@ -2673,10 +3023,14 @@ void MathCtrl::DestroyTree() {
   SetHCaret(NULL);
   DestroyTree(m_tree);
   m_tree = m_last = NULL;
+  m_groupLayout.Invalidate();
   m_lastWorkingGroup = NULL;
+  m_outputGroup = m_unlayoutedOutputGroup = NULL;
+  m_outputTimer.Stop();
 }
 
 void MathCtrl::DestroyTree(MathCell* tmp) {
+  ForgetOutputGroup(tmp);
   MathCell* tmp1;
   while (tmp != NULL) {
     tmp1 = tmp;
@@ -4017,36 +4371,28 @@ bool MathCtrl::ExportToWXMX(wxString file,bool markAsSaved)
   if(!VcFriendlyWXMX)
     zip.SetLevel(9);
   
-  // save images from memory to zip file
-  wxFileSystem *fsystem = new wxFileSystem();
-  fsystem->AddHandler(new wxMemoryFSHandler);
-  fsystem->ChangePathTo(wxT("memory:"), true);
+  // Save the images to the zip file. Their PNG data is written as it is: Encoding
+  // all plots again would take seconds. PNG data is compressed already =>
+  // deflating it again would only cost time.
+  std::vector<wxMemoryBuffer> images;
+  ImgCell::WXMXTakeImages(images);
 
-  for (int i = 1; i<=ImgCell::WXMXImageCount(); i++)
+  for (size_t i = 0; i < images.size(); i++)
   {
     wxString name = wxT("image");
-    name << i << wxT(".png");
+    name << i + 1 << wxT(".png");
 
-    wxFSFile *fsfile = fsystem->OpenFile(name);
+    wxZipEntry *entry = new wxZipEntry(name);
+    entry->SetMethod(wxZIP_METHOD_STORE);
+    zip.PutNextEntry(entry);
+    zip.Write(images[i].GetData(), images[i].GetDataLen());
 
-    if (fsfile) {
-      zip.PutNextEntry(name);
-      wxInputStream *imagefile = fsfile->GetStream();
-      
-      while (!(imagefile->Eof()))
-        imagefile->Read(zip);
-
-      delete imagefile;
-      wxMemoryFSHandler::RemoveFile(name);
-    }
-    // Saving an image needs loads of time and we don't want the gui to
+    // Writing many images might need some time and we don't want the gui to
     // offer to help the user by killing the currently running process
     // => give wx the possibility to tell the OS that we are still running.
     wxYield();
   }
 
-  delete fsystem;
-
   if(!zip.Close())
     return false;
   if (!out.Close())
@@ -4129,10 +4475,9 @@ bool MathCtrl::ActivatePrevInput() {
 
   ScrollToCell(inpt);
 
-  SetActiveCell(inpt, false);
+  SetActiveCell(inpt);
   m_activeCell->CaretToEnd();
-
-  Refresh();
+  RefreshCell(m_activeCell);
 
   return true;
 }
@@ -4171,10 +4516,9 @@ bool MathCtrl::ActivateNextInput(bool input) {
 
   ScrollToCell(inpt);
 
-  SetActiveCell(inpt, false);
+  SetActiveCell(inpt);
   m_activeCell->CaretToStart();
-
-  Refresh();
+  RefreshCell(m_activeCell);
 
   return true;
 }
@@ -4190,6 +4534,8 @@ void MathCtrl::AddDocumentToEvaluationQueue()
     m_evaluationQueue->AddToQueue(tmp);
     tmp = dynamic_cast<GroupCell*>(tmp->m_next);
   }
+  // The queue markers of all cells have to be drawn.
+  Refresh();
   SetHCaret(m_last);
 }
 
@@ -4205,6 +4551,8 @@ void MathCtrl::AddEntireDocumentToEvaluationQueue()
     m_evaluationQueue->AddHiddenTreeToQueue(tmp);
     tmp = dynamic_cast<GroupCell*>(tmp->m_next);
   }
+  // The queue markers of all cells have to be drawn.
+  Refresh();
   SetHCaret(m_last);
 }
 
@@ -4222,6 +4570,8 @@ void MathCtrl::AddSelectionToEvaluationQueue()
       break;
     tmp = dynamic_cast<GroupCell*>(tmp->m_next);
   }
+  // The queue markers of all cells have to be drawn.
+  Refresh();
   SetHCaret(dynamic_cast<GroupCell*>(m_selectionEnd));
 }
 
@@ -4247,11 +4597,14 @@ void MathCtrl::AddDocumentTillHereToEvaluationQueue()
         break;
       tmp = dynamic_cast<GroupCell*>(tmp->m_next);
     } 
+    // The queue markers of all cells have to be drawn.
+    Refresh();
   }
 }
 void MathCtrl::AddCellToEvaluationQueue(GroupCell* gc)
 {
   m_evaluationQueue->AddToQueue((GroupCell*) gc);
+  RefreshGroup(gc);
   SetHCaret(gc);
 }
 //////// end of EvaluationQueue related stuff ////////////////
@@ -4313,7 +4666,6 @@ void MathCtrl::ScrollToCell(MathCell *cell)
   {
     Scroll(-1, MAX(cellY/SCROLL_UNIT - 2, 0));
   }
-  Refresh();
 }
 
 void MathCtrl::Undo()
@@ -4563,6 +4915,14 @@ bool MathCtrl::TreeUndo(std::list <TreeUndoAction *> *sourcelist,std::list <Tree
   
  */
 void MathCtrl::SetActiveCell(EditorCell *cell, bool callRefresh) {
+  // If nothing is selected only the old and the new cursor have to be
+  // repainted. A text selection is highlighted wherever its text occurs.
+  bool refreshAll = (m_selectionStart != NULL) ||
+    ((m_activeCell != NULL) && m_activeCell->SelectionActive());
+  EditorCell *oldActiveCell = m_activeCell;
+  GroupCell *oldHCaretPosition = m_hCaretPosition;
+  bool oldHCaretActive = m_hCaretActive;
+
   if (m_activeCell != NULL)
   {
     TreeUndo_CellLeft();
@@ -4598,7 +4958,17 @@ void MathCtrl::SetActiveCell(EditorCell *cell, bool callRefresh) {
   }
   
   if (callRefresh) // = true default
-    Refresh();
+  {
+    if (refreshAll)
+      Refresh();
+    else
+    {
+      RefreshCell(oldActiveCell);
+      RefreshCell(m_activeCell);
+      if (oldHCaretActive && !m_hCaretActive)
+        RefreshHCaret(oldHCaretPosition);
+    }
+  }
 }
 
 bool MathCtrl::PointVisibleIs(wxPoint point)
@@ -5016,7 +5386,10 @@ void MathCtrl::Animate(bool run)
 void MathCtrl::SetWorkingGroup(GroupCell *group)
  {
   if (m_workingGroup != NULL)
+  {
     m_workingGroup->SetWorking(false);
+    RefreshGroup(m_workingGroup);
+  }
   
   m_workingGroup = group;
 
@@ -5024,6 +5397,7 @@ void MathCtrl::SetWorkingGroup(GroupCell *group)
   {
     m_workingGroup->SetWorking(group);
     m_lastWorkingGroup = group;
+    RefreshGroup(m_workingGroup);
   }
 }
 
@@ -5078,6 +5452,14 @@ void MathCtrl::SetHCaret(GroupCell *where, bool callRefresh)
     wxASSERT_MSG(m_tree->Contains(where),_("Trying to set the cursor to a cell that isn't part of the worksheet"));
   else
   {
+    // If nothing is selected only the old and the new cursor have to be
+    // repainted. A text selection is highlighted wherever its text occurs.
+    bool refreshAll = (m_selectionStart != NULL) ||
+      ((m_activeCell != NULL) && m_activeCell->SelectionActive());
+    EditorCell *oldActiveCell = m_activeCell;
+    GroupCell *oldHCaretPosition = m_hCaretPosition;
+    bool oldHCaretActive = m_hCaretActive;
+
     SetSelection(NULL);
     m_hCaretPositionStart = m_hCaretPositionEnd = NULL;
     SetActiveCell(NULL, false);
@@ -5089,7 +5471,17 @@ void MathCtrl::SetHCaret(GroupCell *where, bool callRefresh)
     m_hCaretActive = true;
     
     if (callRefresh) // = true default
-      Refresh();
+    {
+      if (refreshAll)
+        Refresh();
+      else
+      {
+        RefreshCell(oldActiveCell);
+        if (oldHCaretActive)
+          RefreshHCaret(oldHCaretPosition);
+        RefreshHCaret(m_hCaretPosition);
+      }
+    }
     ScrollToCell(where);
   }
 }
@@ -5300,6 +5692,7 @@ bool MathCtrl::FindNext(wxString str, bool down, bool ignoreCase)
         editor->SetSelection(start, end);
         ScrollToCaret();
         UpdateTableOfContents();
+        // All occurrences of the found text in the worksheet are highlighted.
         Refresh();
         return true;
       }
@@ -5683,6 +6076,7 @@ BEGIN_EVENT_TABLE(MathCtrl, wxScrolledCanvas)
   EVT_MENU_RANGE(popid_complete_00, popid_complete_00 + AC_MENU_LENGTH, MathCtrl::OnComplete)
   EVT_SIZE(MathCtrl::OnSize)
   EVT_PAINT(MathCtrl::OnPaint)
+  EVT_IDLE(MathCtrl::OnIdle)
   EVT_LEFT_UP(MathCtrl::OnMouseLeftUp)
   EVT_LEFT_DOWN(MathCtrl::OnMouseLeftDown)
   EVT_RIGHT_DOWN(MathCtrl::OnMouseRightDown)
@@ -5693,6 +6087,8 @@ BEGIN_EVENT_TABLE(MathCtrl, wxScrolledCanvas)
   EVT_TIMER(TIMER_ID, MathCtrl::OnTimer)
   EVT_TIMER(CARET_TIMER_ID, MathCtrl::OnTimer)
   EVT_TIMER(ANIMATION_TIMER_ID, MathCtrl::OnTimer)
+  EVT_TIMER(OUTPUT_TIMER_ID, MathCtrl::OnTimer)
+  EVT_THREAD(SCALED_BITMAP_ID, MathCtrl::OnScaledBitmapReady)
   EVT_KEY_DOWN(MathCtrl::OnKeyDown)
   EVT_CHAR(MathCtrl::OnChar)
   EVT_ERASE_BACKGROUND(MathCtrl::OnEraseBackground)
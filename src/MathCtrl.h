@@ -27,11 +27,15 @@
 #include <wx/aui/aui.h>
 #include <wx/textfile.h>
 #include <list>
+#include <vector>
 
 #include "MathCell.h"
 #include "EditorCell.h"
 #include "GroupCell.h"
+#include "GroupLayout.h"
+#include "TileCache.h"
 #include "EvaluationQueue.h"
+#include "IOStatistics.h"
 #include "Autocomplete.h"
 #include "AutocompletePopup.h"
 #include "Structure.h"
@@ -241,12 +245,15 @@ class MathCtrl: public wxScrolledCanvas
     CLICK_TYPE_OUTPUT_SELECTION
   };
 
-  //! An enum of individual IDs for all timers this class handles
+  //! An enum of individual IDs for all timers and threads this class handles
   enum TimerIDs
   {
     TIMER_ID,
     CARET_TIMER_ID,
-    ANIMATION_TIMER_ID
+    ANIMATION_TIMER_ID,
+    OUTPUT_TIMER_ID,
+    //! The ScaledBitmapCache has rescaled an image
+    SCALED_BITMAP_ID
   };
 
   //! Add a line to a file.
@@ -268,6 +275,8 @@ class MathCtrl: public wxScrolledCanvas
   void GetMaxPoint(int* width, int* height);
   //! Is executed if a timer associated with MathCtrl has expired.
   void OnTimer(wxTimerEvent& event);
+  //! Repaints the images the ScaledBitmapCache has finished rescaling
+  void OnScaledBitmapReady(wxThreadEvent& event);
   /*! Has the autosave interval expired?
   
     True means: A save will be issued after the user stops typing.
@@ -281,6 +290,32 @@ class MathCtrl: public wxScrolledCanvas
     of this class.
    */
   void OnPaint(wxPaintEvent& event);
+  /*! Draws the part rect of the worksheet
+
+    \param dc The device context to draw to. Its origin has to be set up so
+               that worksheet coordinates can be used.
+    \param rect The part of the worksheet that has to be drawn.
+    \param selection The rectangles GetSelectionRects() has returned.
+    \param changeAsterisk The value of the changeAsterisk setting.
+   */
+  void PaintContent(wxDC &dc, const wxRect &rect,
+                    const std::vector<wxRect> &selection, bool changeAsterisk);
+  //! Appends the rectangles that mark the current selection to rects
+  void GetSelectionRects(std::vector<wxRect> &rects);
+  /*! Schedules a repaint of the worksheet between top and bottom
+
+    top and bottom are worksheet coordinates. Parts of the band that
+    currently aren't visible are only marked as outdated.
+    \param right The rightmost x coordinate that has to be repainted.
+                  -1 = the whole width of the worksheet.
+   */
+  void RefreshBand(int top, int bottom, int right = -1);
+  //! The rightmost x coordinate the group with this index of m_groupLayout draws to
+  int GetGroupRight(size_t index);
+  //! Schedules a repaint of the horizontal cursor below group (NULL = at the top of the worksheet)
+  void RefreshHCaret(GroupCell *group);
+  //! Layouts the cells that have been changed since the last Recalculate()
+  void OnIdle(wxIdleEvent& event);
   void OnSize(wxSizeEvent& event);
   void OnMouseRightDown(wxMouseEvent& event);
   void OnMouseLeftUp(wxMouseEvent& event);
@@ -405,9 +440,39 @@ class MathCtrl: public wxScrolledCanvas
    */
   bool m_editingEnabled;
   wxTimer m_timer, m_caretTimer, m_animationTimer;
+  /*! Collects the output lines that arrive in quick succession
+
+    Maxima might send thousands of lines per second. Layouting the worksheet
+    and repainting it for every single one of them would make output that
+    is longer than a few pages arrive slower and slower.
+   */
+  wxTimer m_outputTimer;
+  //! The group cell output has been appended to since the output timer was started
+  GroupCell *m_outputGroup;
+  //! The group cell whose appended output hasn't been layouted yet
+  GroupCell *m_unlayoutedOutputGroup;
+  /*! The positions of all group cells
+
+    Allows Recalculate() to lay out only the cells that have changed. Has to
+    be invalidated every time group cells are added, deleted or folded.
+   */
+  GroupLayout m_groupLayout;
+  //! Layouts the output that has been appended to m_unlayoutedOutputGroup
+  void LayoutAppendedOutput();
+  /*! Forgets that output has been appended to one of the cells from start to end
+
+    Has to be called before cells are removed from the worksheet. If end is
+    NULL all cells from start to the end of the list are checked.
+  */
+  void ForgetOutputGroup(MathCell *start, MathCell *end = NULL);
   //! True only when an animation is running
   bool m_animate;
-  wxBitmap *m_memory;
+  /*! The parts of the worksheet that have been drawn already
+
+    OnPaint() only draws the parts of these tiles that have been invalidated
+    by a call to Refresh() or by a change of the layout and copies the rest.
+   */
+  TileCache m_tiles;
   //! True if no changes have to be saved.
   bool m_saved;
   double m_zoomFactor;
@@ -528,10 +593,52 @@ public:
     the line is appended to m_last, instead.
   */
   void InsertLine(MathCell *newLine, bool forceNewLine = false);
+  //! The cell InsertLine() would add a line to
+  GroupCell *GetInsertGroup();
+  /*! The arena the cells for the next InsertLine() are to be allocated from
+
+    NULL if there is no cell InsertLine() could add a line to. All cells
+    GetInsertGroup() returns are part of the worksheet: Deleting a cell
+    resets the pointers that refer to it.
+  */
+  CellArena *GetOutputArena();
+  /*! Layouts and displays all lines InsertLine() has added
+
+    Is called by the output timer; Needs only to be called directly if the
+    output has to be visible immediately.
+   */
+  void FlushOutput();
+  /*! Lays out all group cells whose size is unknown
+
+    \param force Lay out all cells, even those that haven't changed.
+   */
   void Recalculate(bool force = false);  
   void RecalculateForce() {
     Recalculate(true);
   }
+  /*! Schedules a repaint of the worksheet
+
+    Overrides wxWindow::Refresh() in order to mark the cached rendering of
+    the region that has to be repainted as outdated.
+
+    \param eraseBackground Passed on to wxWindow::Refresh().
+    \param rect The region to repaint in window coordinates or NULL for the
+                 whole worksheet.
+   */
+  void Refresh(bool eraseBackground = true, const wxRect *rect = NULL);
+  /*! Schedules a repaint of the part of the worksheet a cell is drawn to
+
+    Repaints everything right of the cell up to the right end of its group,
+    too, since text that has been deleted from the cell might have been drawn
+    there. Changes of the width of the group are handled by Recalculate().
+   */
+  void RefreshCell(MathCell *cell);
+  /*! Schedules a repaint of a group cell
+
+    Includes the bracket and markers left of the group and the horizontal
+    cursor below it.
+   */
+  void RefreshGroup(GroupCell *group);
   /*! Empties the current document
 
     Used before opening a new file or when the "new" button is pressed.
@@ -762,6 +869,8 @@ public:
   void AddCellToEvaluationQueue(GroupCell* gc);
   //! The list of cells that have to be evaluated
   EvaluationQueue* m_evaluationQueue;
+  //! Where the time between sending a command and receiving its prompt is spent
+  IOStatistics* m_ioStatistics;
   // methods for folding
   GroupCell *UpdateMLast();
   void FoldOccurred();
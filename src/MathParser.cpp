@@ -21,9 +21,8 @@
 
 #include <wx/config.h>
 #include <wx/tokenzr.h>
-#include <wx/sstream.h>
-#include <wx/regex.h>
 #include <wx/intl.h>
+#include <wx/thread.h>
 
 #include "MathParser.h"
 
@@ -46,6 +45,7 @@
 #include "ImgCell.h"
 #include "SubSupCell.h"
 #include "SlideShowCell.h"
+#include "LongOutputCell.h"
 #include "GroupCell.h"
 
 MathParser::MathParser(wxString zipfile)
@@ -53,6 +53,7 @@ MathParser::MathParser(wxString zipfile)
   m_ParserStyle = MC_TYPE_DEFAULT;
   m_FracStyle = FracCell::FC_NORMAL;
   m_highlight = false;
+  ReadConfig();
   if (zipfile.Length() > 0) {
     m_fileSystem = new wxFileSystem();
     m_fileSystem->ChangePathTo(wxT("file:") + zipfile + wxT("#zip:/"), true);
@@ -67,60 +68,97 @@ MathParser::~MathParser()
     delete m_fileSystem;
 }
 
+void MathParser::ReadConfig()
+{
+  wxConfigBase* config = wxConfig::Get();
+
+  int showLength = 0;
+  config->Read(wxT("showLength"), &showLength);
+  switch(showLength)
+  {
+  case 0:
+    m_maxLength = 50000;
+    break;
+  case 1:
+    m_maxLength = 500000;
+    break;
+  case 2:
+    m_maxLength = 5000000;
+    break;
+  default:
+    m_maxLength = 0;
+    break;
+  }
+
+  m_displayedDigits = 100;
+  config->Read(wxT("displayedDigits"), &m_displayedDigits);
+  if (m_displayedDigits < 10)
+    m_displayedDigits = 10;
+}
+
 // ParseCellTag
 // This function is responsible for creating
 // a tree of groupcells when loading XML document.
 // Any changes in GroupCell structure or methods
 // has to be reflected here in order to ensure proper
 // loading of WXMX files.
-MathCell* MathParser::ParseCellTag(wxXmlNode* node)
+MathCell* MathParser::ParseCellTag(XmlPullParser &xml)
 {
   GroupCell *group = NULL;
 
   // read hide status
-  bool hide = (node->GetAttribute(wxT("hide"), wxT("false")) == wxT("true")) ? true : false;
+  bool hide = (xml.GetAttribute(wxT("hide"), wxT("false")) == wxT("true")) ? true : false;
   // read (group)cell type
-  wxString type = node->GetAttribute(wxT("type"), wxT("text"));
-  wxString sectioning_level = node->GetAttribute(wxT("sectioning_level"), wxT("0"));
+  wxString type = xml.GetAttribute(wxT("type"), wxT("text"));
+  wxString sectioning_level = xml.GetAttribute(wxT("sectioning_level"), wxT("0"));
 
   if (type == wxT("code")) {
     group = new GroupCell(GC_TYPE_CODE);
-    wxXmlNode *children = node->GetChildren();
-    while (children) {
-      if (children->GetName() == wxT("input")) {
-        MathCell *editor = ParseTag(children->GetChildren());
-        group->SetEditableContent(editor->GetValue());
+    xml.Next();
+    while (xml.AtNode()) {
+      if ((xml.GetToken() == XmlPullParser::StartTag) && (xml.GetName() == wxT("input"))) {
+        MathCell *editor = ParseChildren(xml);
+        if (editor != NULL)
+          group->SetEditableContent(editor->GetValue());
         delete editor;
       }
-      if (children->GetName() == wxT("output"))
+      else if ((xml.GetToken() == XmlPullParser::StartTag) && (xml.GetName() == wxT("output")))
       {
-        MathCell *tag = ParseTag(children->GetChildren());
+        MathCell *tag = ParseChildren(xml);
         if(tag != NULL)
           group->AppendOutput(tag);
       }
-      children = children->GetNext();
+      else
+        xml.SkipNode();
     }
+    xml.FinishElement();
   }  else if (type == wxT("image")) {
     group = new GroupCell(GC_TYPE_IMAGE);
-    wxXmlNode *children = node->GetChildren();
-    while (children) {
-      if (children->GetName() == wxT("editor")) {
-        MathCell *ed = ParseEditorTag(children);
+    xml.Next();
+    while (xml.AtNode()) {
+      if ((xml.GetToken() == XmlPullParser::StartTag) && (xml.GetName() == wxT("editor"))) {
+        MathCell *ed = ParseEditorTag(xml);
         group->SetEditableContent(ed->GetValue());
         delete ed;
       }
       else
-        group->AppendOutput(ParseTag(children));
-      children = children->GetNext();
+      {
+        MathCell *tag = ParseTag(xml, false);
+        if(tag != NULL)
+          group->AppendOutput(tag);
+      }
     }
+    xml.FinishElement();
   }
   else if (type == wxT("pagebreak")) {
     group = new GroupCell(GC_TYPE_PAGEBREAK);
+    xml.SkipNode();
   }
   else if (type == wxT("text")) {
     group = new GroupCell(GC_TYPE_TEXT);
-    MathCell *editor = ParseTag(node->GetChildren());
-    group->SetEditableContent(editor->GetValue());
+    MathCell *editor = ParseChildren(xml);
+    if (editor != NULL)
+      group->SetEditableContent(editor->GetValue());
     delete editor;
   }
   else {
@@ -146,36 +184,44 @@ MathCell* MathParser::ParseCellTag(wxXmlNode* node)
       group = new GroupCell(GC_TYPE_SUBSUBSECTION);
     }
     else
+    {
+      xml.SkipNode();
       return NULL;
+    }
 
-    wxXmlNode *children = node->GetChildren();
-    while (children) {
-      if (children->GetName() == wxT("editor")) {
-        MathCell *ed = ParseEditorTag(children);
+    xml.Next();
+    while (xml.AtNode()) {
+      if ((xml.GetToken() == XmlPullParser::StartTag) && (xml.GetName() == wxT("editor"))) {
+        MathCell *ed = ParseEditorTag(xml);
         group->SetEditableContent(ed->GetValue());
         delete ed;
       }
-      else if (children->GetName() == wxT("fold")) { // we have folded groupcells
-        wxXmlNode *xmlcells = children->GetChildren();
+      else if ((xml.GetToken() == XmlPullParser::StartTag) && (xml.GetName() == wxT("fold"))) {
+        // we have folded groupcells
         MathCell *tree = NULL;
         MathCell *last = NULL;
-        if (xmlcells) {
-          last = tree = ParseTag(xmlcells, false); // first cell
-          while (xmlcells->GetNext()) {
-            xmlcells = xmlcells->GetNext();
-            MathCell *cell = ParseTag(xmlcells, false);
-
+        xml.Next();
+        while (xml.AtNode()) {
+          MathCell *cell = ParseTag(xml, false);
+          if (cell == NULL)
+            continue;
+          if (tree == NULL)
+            tree = cell;
+          else
+          {
             last->m_next = last->m_nextToDraw = cell;
             last->m_next->m_previous = last->m_next->m_previousToDraw = last;
-
-            last = last->m_next;
           }
-          if (tree)
-            group->HideTree((GroupCell *)tree);
+          last = cell;
         }
+        xml.FinishElement();
+        if (tree)
+          group->HideTree((GroupCell *)tree);
       }
-      children = children->GetNext();
+      else
+        xml.SkipNode();
     }
+    xml.FinishElement();
   }
 
   group->SetParent(group);
@@ -183,10 +229,10 @@ MathCell* MathParser::ParseCellTag(wxXmlNode* node)
   return group;
 }
 
-MathCell* MathParser::ParseEditorTag(wxXmlNode* node)
+MathCell* MathParser::ParseEditorTag(XmlPullParser &xml)
 {
   EditorCell *editor = new EditorCell();
-  wxString type = node->GetAttribute(wxT("type"), wxT("input"));
+  wxString type = xml.GetAttribute(wxT("type"), wxT("input"));
   if (type == wxT("input"))
     editor->SetType(MC_TYPE_INPUT);
   else if (type == wxT("text"))
@@ -201,378 +247,509 @@ MathCell* MathParser::ParseEditorTag(wxXmlNode* node)
     editor->SetType(MC_TYPE_SUBSUBSECTION);
 
   wxString text = wxEmptyString;
-  wxXmlNode *line = node->GetChildren();
-  while (line) {
-    if (line->GetName() == wxT("line")) {
+  xml.Next();
+  while (xml.AtNode()) {
+    if ((xml.GetToken() == XmlPullParser::StartTag) && (xml.GetName() == wxT("line"))) {
       if (!text.IsEmpty())
         text += wxT("\n");
+      if (xml.Next() == XmlPullParser::Text)
+      {
 #if wxUSE_UNICODE
-      text += line->GetNodeContent();
+        text += xml.GetText();
 #else
-      wxString str = line->GetNodeContent();
-      wxString str1(str.wc_str(wxConvUTF8), *wxConvCurrent);
-      text += str1;
+        wxString str = xml.GetText();
+        wxString str1(str.wc_str(wxConvUTF8), *wxConvCurrent);
+        text += str1;
 #endif
+      }
+      xml.FinishElement();
     }
-    line = line->GetNext();
+    else
+      xml.SkipNode();
   } // end while
+  xml.FinishElement();
   editor->SetValue(text);
   return editor;
 }
 
-MathCell* MathParser::ParseFracTag(wxXmlNode* node)
+MathCell* MathParser::ParseText(wxString str, int style)
+{
+  TextCell* cell = new TextCell;
+  if (str != wxEmptyString)
+  {
+#if !wxUSE_UNICODE
+    wxString str1(str.wc_str(wxConvUTF8), *wxConvCurrent);
+    str = str1;
+#endif
+#if wxUSE_UNICODE
+    str.Replace(wxT("-"), wxT("\x2212")); // unicode minus sign
+#endif
+    if (style == TS_NUMBER)
+    {
+      if (str.Length() > m_displayedDigits)
+	{
+	  int left= m_displayedDigits/3;
+	  if (left>30) left=30;
+	  
+	  str = str.Left(left) + wxString::Format(_("[%i digits]"), (int) str.Length() - 2 * left) + str.Right(left);
+	  //	  str = str.Left(left)+wxT("...");
+	}
+    }
+    if(style != TS_ERROR)
+      cell->SetType(m_ParserStyle);
+    else
+      cell->SetType(MC_TYPE_ERROR);
+    cell->SetStyle(style);
+    cell->SetHighlight(m_highlight);
+    cell->SetValue(str);
+  }
+  return cell;
+}
+
+MathCell* MathParser::ParseCharCode(wxString str, int style)
+{
+  TextCell* cell = new TextCell;
+  if (str != wxEmptyString)
+  {
+    long code;
+    if (str.ToLong(&code))
+      str = wxString::Format(wxT("%c"), code);
+#if !wxUSE_UNICODE
+    wxString str1(str.wc_str(wxConvUTF8), *wxConvCurrent);
+    str = str1;
+#endif
+    cell->SetValue(str);
+    cell->SetType(m_ParserStyle);
+    cell->SetStyle(style);
+    cell->SetHighlight(m_highlight);
+  }
+  return cell;
+}
+
+MathParser::TagId MathParser::GetTagId(const wxString &name)
+{
+  // Most tags maxima sends are only one or two characters long: Dispatching
+  // on the length and the first character avoids nearly all string
+  // comparisons.
+  switch (name.Length())
+  {
+  case 1:
+    switch (name.GetChar(0).GetValue())
+    {
+    case wxT('v'): return TAG_V;
+    case wxT('t'): return TAG_T;
+    case wxT('n'): return TAG_N;
+    case wxT('h'): return TAG_H;
+    case wxT('p'): return TAG_P;
+    case wxT('f'): return TAG_F;
+    case wxT('e'): return TAG_E;
+    case wxT('i'): return TAG_I;
+    case wxT('g'): return TAG_G;
+    case wxT('s'): return TAG_S;
+    case wxT('q'): return TAG_Q;
+    case wxT('d'): return TAG_D;
+    case wxT('a'): return TAG_A;
+    case wxT('r'): return TAG_R;
+    }
+    break;
+  case 2:
+  {
+    wxUniChar second = name.GetChar(1);
+    switch (name.GetChar(0).GetValue())
+    {
+    case wxT('f'):
+      if (second == wxT('n')) return TAG_FN;
+      break;
+    case wxT('s'):
+      if (second == wxT('m')) return TAG_SM;
+      if (second == wxT('t')) return TAG_ST;
+      break;
+    case wxT('i'):
+      if (second == wxT('n')) return TAG_IN;
+      if (second == wxT('e')) return TAG_IE;
+      break;
+    case wxT('a'):
+      if (second == wxT('t')) return TAG_AT;
+      break;
+    case wxT('c'):
+      if (second == wxT('j')) return TAG_CJ;
+      break;
+    case wxT('l'):
+      if (second == wxT('m')) return TAG_LM;
+      break;
+    case wxT('t'):
+      if (second == wxT('b')) return TAG_TB;
+      break;
+    case wxT('h'):
+      if (second == wxT('l')) return TAG_HL;
+      break;
+    }
+    break;
+  }
+  case 3:
+    if (name == wxT("mth")) return TAG_MTH;
+    if (name == wxT("fnm")) return TAG_FNM;
+    if (name == wxT("lbl")) return TAG_LBL;
+    if (name == wxT("img")) return TAG_IMG;
+    break;
+  case 4:
+    if (name == wxT("line")) return TAG_LINE;
+    if (name == wxT("cell")) return TAG_CELL;
+    break;
+  case 5:
+    if (name == wxT("slide")) return TAG_SLIDE;
+    if (name == wxT("ascii")) return TAG_ASCII;
+    break;
+  case 6:
+    if (name == wxT("mspace")) return TAG_MSPACE;
+    if (name == wxT("editor")) return TAG_EDITOR;
+    break;
+  case 10:
+    if (name == wxT("longoutput")) return TAG_LONGOUTPUT;
+    break;
+  }
+  return TAG_UNKNOWN;
+}
+
+MathCell* MathParser::ParseChildren(XmlPullParser &xml)
+{
+  xml.Next();
+  MathCell *cell = ParseTag(xml, true);
+  xml.FinishElement();
+  return cell;
+}
+
+MathCell* MathParser::ParseText(XmlPullParser &xml, int style)
+{
+  wxString str;
+  if (xml.Next() == XmlPullParser::Text)
+    str = xml.GetText();
+  xml.FinishElement();
+  return ParseText(str, style);
+}
+
+MathCell* MathParser::ParseCharCode(XmlPullParser &xml, int style)
+{
+  wxString str;
+  if (xml.Next() == XmlPullParser::Text)
+    str = xml.GetText();
+  xml.FinishElement();
+  return ParseCharCode(str, style);
+}
+
+MathCell* MathParser::ParseLongOutputTag(XmlPullParser &xml)
+{
+  wxString str;
+  if (xml.Next() == XmlPullParser::Text)
+    str = xml.GetText();
+  xml.FinishElement();
+#if !wxUSE_UNICODE
+  wxString str1(str.wc_str(wxConvUTF8), *wxConvCurrent);
+  str = str1;
+#endif
+  LongOutputCell *cell = new LongOutputCell(str);
+  cell->SetType(m_ParserStyle);
+  cell->ForceBreakLine(true);
+  return cell;
+}
+
+MathCell* MathParser::ParseFracTag(XmlPullParser &xml)
 {
   FracCell *frac = new FracCell;
   frac->SetFracStyle(m_FracStyle);
   frac->SetHighlight(m_highlight);
-  wxXmlNode* child = node->GetChildren();
-  if (child)
+  bool choose = xml.HasAttributes();
+  xml.Next();
+  if (xml.AtNode())
   {
-    frac->SetNum(ParseTag(child, false));
-    child = child->GetNext();
-    if (child)
+    frac->SetNum(ParseTag(xml, false));
+    if (xml.AtNode())
     {
-      frac->SetDenom(ParseTag(child, false));
-      if (node->GetAttributes() != NULL)
+      frac->SetDenom(ParseTag(xml, false));
+      if (choose)
       {
         frac->SetFracStyle(FracCell::FC_CHOOSE);
       }
       frac->SetType(m_ParserStyle);
       frac->SetStyle(TS_VARIABLE);
       frac->SetupBreakUps();
+      xml.FinishElement();
       return frac;
     }
   }
+  xml.FinishElement();
   delete frac;
   return NULL;
 }
 
-MathCell* MathParser::ParseDiffTag(wxXmlNode* node)
+MathCell* MathParser::ParseDiffTag(XmlPullParser &xml)
 {
   DiffCell *diff = new DiffCell;
-  wxXmlNode* child = node->GetChildren();
-  if (child)
+  xml.Next();
+  if (xml.AtNode())
   {
     int fc = m_FracStyle;
     m_FracStyle = FracCell::FC_DIFF;
-    diff->SetDiff(ParseTag(child, false));
+    diff->SetDiff(ParseTag(xml, false));
     m_FracStyle = fc;
-    child = child->GetNext();
-    if (child)
+    if (xml.AtNode())
     {
-      diff->SetBase(ParseTag(child, true));
+      diff->SetBase(ParseTag(xml, true));
       diff->SetType(m_ParserStyle);
       diff->SetStyle(TS_VARIABLE);
+      xml.FinishElement();
       return diff;
     }
   }
+  xml.FinishElement();
   delete diff;
   return NULL;
 }
 
-MathCell* MathParser::ParseSupTag(wxXmlNode* node)
+MathCell* MathParser::ParseSupTag(XmlPullParser &xml)
 {
   ExptCell *expt = new ExptCell;
-  if (node->GetAttributes() != NULL)
+  if (xml.HasAttributes())
     expt->IsMatrix(true);
-  wxXmlNode* child = node->GetChildren();
-  if (child)
+  xml.Next();
+  if (xml.AtNode())
   {
-    expt->SetBase(ParseTag(child, false));
-    child = child->GetNext();
-    if (child)
+    expt->SetBase(ParseTag(xml, false));
+    if (xml.AtNode())
     {
-      MathCell* power = ParseTag(child, false);
+      MathCell* power = ParseTag(xml, false);
       power->SetExponentFlag();
       expt->SetPower(power);
       expt->SetType(m_ParserStyle);
       expt->SetStyle(TS_VARIABLE);
+      xml.FinishElement();
       return expt;
     }
   }
+  xml.FinishElement();
   delete expt;
   return NULL;
 }
 
-MathCell* MathParser::ParseSubSupTag(wxXmlNode* node)
+MathCell* MathParser::ParseSubSupTag(XmlPullParser &xml)
 {
   SubSupCell *subsup = new SubSupCell;
-  wxXmlNode* child = node->GetChildren();
-  if (child)
+  xml.Next();
+  if (xml.AtNode())
   {
-    subsup->SetBase(ParseTag(child, false));
-    child = child->GetNext();
-    if (child)
+    subsup->SetBase(ParseTag(xml, false));
+    if (xml.AtNode())
     {
-      MathCell* index = ParseTag(child, false);
+      MathCell* index = ParseTag(xml, false);
       index->SetExponentFlag();
       subsup->SetIndex(index);
-      child = child->GetNext();
-      if (child)
+      if (xml.AtNode())
       {
-        MathCell* power = ParseTag(child, false);
+        MathCell* power = ParseTag(xml, false);
         power->SetExponentFlag();
         subsup->SetExponent(power);
         subsup->SetType(m_ParserStyle);
         subsup->SetStyle(TS_VARIABLE);
+        xml.FinishElement();
         return subsup;
       }
     }
   }
+  xml.FinishElement();
   delete subsup;
   return NULL;
 }
 
-MathCell* MathParser::ParseSubTag(wxXmlNode* node)
+MathCell* MathParser::ParseSubTag(XmlPullParser &xml)
 {
   SubCell *sub = new SubCell;
-  wxXmlNode* child = node->GetChildren();
-  if (child)
+  xml.Next();
+  if (xml.AtNode())
   {
-    sub->SetBase(ParseTag(child, false));
-    child = child->GetNext();
-    if (child)
+    sub->SetBase(ParseTag(xml, false));
+    if (xml.AtNode())
     {
-      MathCell* index = ParseTag(child, false);
+      MathCell* index = ParseTag(xml, false);
       index->SetExponentFlag();
       sub->SetIndex(index);
       sub->SetType(m_ParserStyle);
       sub->SetStyle(TS_VARIABLE);
+      xml.FinishElement();
       return sub;
     }
   }
+  xml.FinishElement();
   delete sub;
   return NULL;
 }
 
-MathCell* MathParser::ParseAtTag(wxXmlNode* node)
+MathCell* MathParser::ParseAtTag(XmlPullParser &xml)
 {
   AtCell *at = new AtCell;
-  wxXmlNode* child = node->GetChildren();
-  if (child)
+  xml.Next();
+  if (xml.AtNode())
   {
-    at->SetBase(ParseTag(child, false));
+    at->SetBase(ParseTag(xml, false));
     at->SetHighlight(m_highlight);
-    child = child->GetNext();
-    if (child)
+    if (xml.AtNode())
     {
-      at->SetIndex(ParseTag(child, false));
+      at->SetIndex(ParseTag(xml, false));
       at->SetType(m_ParserStyle);
       at->SetStyle(TS_VARIABLE);
+      xml.FinishElement();
       return at;
     }
   }
+  xml.FinishElement();
   delete at;
   return NULL;
 }
 
-MathCell* MathParser::ParseFunTag(wxXmlNode* node)
+MathCell* MathParser::ParseFunTag(XmlPullParser &xml)
 {
   FunCell *fun = new FunCell;
-  wxXmlNode* child = node->GetChildren();
-  if (child)
+  xml.Next();
+  if (xml.AtNode())
   {
-    fun->SetName(ParseTag(child, false));
-    child = child->GetNext();
-    if (child)
+    fun->SetName(ParseTag(xml, false));
+    if (xml.AtNode())
     {
       fun->SetType(m_ParserStyle);
       fun->SetStyle(TS_VARIABLE);
-      fun->SetArg(ParseTag(child, false));
+      fun->SetArg(ParseTag(xml, false));
+      xml.FinishElement();
       return fun;
     }
   }
+  xml.FinishElement();
   delete fun;
   return NULL;
 }
 
-MathCell* MathParser::ParseText(wxXmlNode* node, int style)
-{
-  TextCell* cell = new TextCell;
-  wxString str;
-  if (node != NULL && (str = node->GetContent()) != wxEmptyString)
-  {
-#if !wxUSE_UNICODE
-    wxString str1(str.wc_str(wxConvUTF8), *wxConvCurrent);
-    str = str1;
-#endif
-#if wxUSE_UNICODE
-    str.Replace(wxT("-"), wxT("\x2212")); // unicode minus sign
-#endif
-    if (style == TS_NUMBER)
-    {
-      m_displayedDigits=100;
-      wxConfigBase *config = wxConfig::Get();      
-      config->Read(wxT("displayedDigits"),&m_displayedDigits);
-
-      if (m_displayedDigits<10)m_displayedDigits=10;
-      if (str.Length() > m_displayedDigits)
-	{
-	  int left= m_displayedDigits/3;
-	  if (left>30) left=30;
-	  
-	  str = str.Left(left) + wxString::Format(_("[%i digits]"), (int) str.Length() - 2 * left) + str.Right(left);
-	  //	  str = str.Left(left)+wxT("...");
-	}
-    }
-    if(style != TS_ERROR)
-      cell->SetType(m_ParserStyle);
-    else
-      cell->SetType(MC_TYPE_ERROR);
-    cell->SetStyle(style);
-    cell->SetHighlight(m_highlight);
-    cell->SetValue(str);
-  }
-  return cell;
-}
-
-MathCell* MathParser::ParseCharCode(wxXmlNode* node, int style)
-{
-  TextCell* cell = new TextCell;
-  wxString str;
-  if (node != NULL && (str = node->GetContent()) != wxEmptyString)
-  {
-    long code;
-    if (str.ToLong(&code))
-      str = wxString::Format(wxT("%c"), code);
-#if !wxUSE_UNICODE
-    wxString str1(str.wc_str(wxConvUTF8), *wxConvCurrent);
-    str = str1;
-#endif
-    cell->SetValue(str);
-    cell->SetType(m_ParserStyle);
-    cell->SetStyle(style);
-    cell->SetHighlight(m_highlight);
-  }
-  return cell;
-}
-
-MathCell* MathParser::ParseSqrtTag(wxXmlNode* node)
+MathCell* MathParser::ParseSqrtTag(XmlPullParser &xml)
 {
-  wxXmlNode* child = node->GetChildren();
   SqrtCell* cell = new SqrtCell;
-  cell->SetInner(ParseTag(child, true));
+  cell->SetInner(ParseChildren(xml));
   cell->SetType(m_ParserStyle);
   cell->SetStyle(TS_VARIABLE);
   cell->SetHighlight(m_highlight);
   return cell;
 }
 
-MathCell* MathParser::ParseAbsTag(wxXmlNode* node)
+MathCell* MathParser::ParseAbsTag(XmlPullParser &xml)
 {
-  wxXmlNode* child = node->GetChildren();
   AbsCell* cell = new AbsCell;
-  cell->SetInner(ParseTag(child, true));
+  cell->SetInner(ParseChildren(xml));
   cell->SetType(m_ParserStyle);
   cell->SetStyle(TS_VARIABLE);
   cell->SetHighlight(m_highlight);
   return cell;
 }
 
-MathCell* MathParser::ParseConjugateTag(wxXmlNode* node)
+MathCell* MathParser::ParseConjugateTag(XmlPullParser &xml)
 {
-  wxXmlNode* child = node->GetChildren();
   ConjugateCell* cell = new ConjugateCell;
-  cell->SetInner(ParseTag(child, true));
+  cell->SetInner(ParseChildren(xml));
   cell->SetType(m_ParserStyle);
   cell->SetStyle(TS_VARIABLE);
   cell->SetHighlight(m_highlight);
   return cell;
 }
 
-MathCell* MathParser::ParseParenTag(wxXmlNode* node)
+MathCell* MathParser::ParseParenTag(XmlPullParser &xml)
 {
-  wxXmlNode* child = node->GetChildren();
+  bool print = !xml.HasAttributes();
   ParenCell* cell = new ParenCell;
-  cell->SetInner(ParseTag(child, true), m_ParserStyle);
+  cell->SetInner(ParseChildren(xml), m_ParserStyle);
   cell->SetHighlight(m_highlight);
   cell->SetStyle(TS_VARIABLE);
-  if (node->GetAttributes() != NULL)
+  if (!print)
     cell->SetPrint(false);
   return cell;
 }
 
-MathCell* MathParser::ParseLimitTag(wxXmlNode* node)
+MathCell* MathParser::ParseLimitTag(XmlPullParser &xml)
 {
   LimitCell *limit = new LimitCell;
-  wxXmlNode* child = node->GetChildren();
-  if (child)
+  xml.Next();
+  if (xml.AtNode())
   {
-    limit->SetName(ParseTag(child, false));
-    child = child->GetNext();
-    if (child)
+    limit->SetName(ParseTag(xml, false));
+    if (xml.AtNode())
     {
-      limit->SetUnder(ParseTag(child, false));
-      child = child->GetNext();
-      if (child)
+      limit->SetUnder(ParseTag(xml, false));
+      if (xml.AtNode())
       {
-        limit->SetBase(ParseTag(child, false));
+        limit->SetBase(ParseTag(xml, false));
         limit->SetType(m_ParserStyle);
         limit->SetStyle(TS_VARIABLE);
+        xml.FinishElement();
         return limit;
       }
     }
   }
+  xml.FinishElement();
   delete limit;
   return NULL;
 }
 
-MathCell* MathParser::ParseSumTag(wxXmlNode* node)
+MathCell* MathParser::ParseSumTag(XmlPullParser &xml)
 {
   SumCell *sum = new SumCell;
-  wxXmlNode* child = node->GetChildren();
-  wxString type = node->GetAttribute(wxT("type"), wxT("sum"));
+  wxString type = xml.GetAttribute(wxT("type"), wxT("sum"));
 
   if (type == wxT("prod"))
     sum->SetSumStyle(SM_PROD);
   sum->SetHighlight(m_highlight);
-  if (child)
+  xml.Next();
+  if (xml.AtNode())
   {
-    sum->SetUnder(ParseTag(child, false));
-    child = child->GetNext();
-    if (child)
+    sum->SetUnder(ParseTag(xml, false));
+    if (xml.AtNode())
     {
       if (type != wxT("lsum"))
-        sum->SetOver(ParseTag(child, false));
-      child = child->GetNext();
-      if (child)
+        sum->SetOver(ParseTag(xml, false));
+      else
+        xml.SkipNode();
+      if (xml.AtNode())
       {
-        sum->SetBase(ParseTag(child, false));
+        sum->SetBase(ParseTag(xml, false));
         sum->SetType(m_ParserStyle);
         sum->SetStyle(TS_VARIABLE);
+        xml.FinishElement();
         return sum;
       }
     }
   }
+  xml.FinishElement();
   delete sum;
   return NULL;
 }
 
-MathCell* MathParser::ParseIntTag(wxXmlNode* node)
+MathCell* MathParser::ParseIntTag(XmlPullParser &xml)
 {
   IntCell *in = new IntCell;
-  wxXmlNode* child = node->GetChildren();
+  bool definite = !xml.HasAttributes();
   in->SetHighlight(m_highlight);
-  if (node->GetAttributes() == NULL)
+  xml.Next();
+  if (definite)
   {
     in->SetIntStyle(IntCell::INT_DEF);
-    if (child)
+    if (xml.AtNode())
     {
-      in->SetUnder(ParseTag(child, false));
-      child = child->GetNext();
-      if (child)
+      in->SetUnder(ParseTag(xml, false));
+      if (xml.AtNode())
       {
-        in->SetOver(ParseTag(child, false));
-        child = child->GetNext();
-        if (child)
+        in->SetOver(ParseTag(xml, false));
+        if (xml.AtNode())
         {
-          in->SetBase(ParseTag(child, false));
-          child = child->GetNext();
-          if (child)
+          in->SetBase(ParseTag(xml, false));
+          if (xml.AtNode())
           {
-            in->SetVar(ParseTag(child, true));
+            in->SetVar(ParseTag(xml, true));
             in->SetType(m_ParserStyle);
             in->SetStyle(TS_VARIABLE);
+            xml.FinishElement();
             return in;
           }
         }
@@ -581,383 +758,280 @@ MathCell* MathParser::ParseIntTag(wxXmlNode* node)
   }
   else
   {
-    if (child)
+    if (xml.AtNode())
     {
-      in->SetBase(ParseTag(child, false));
-      child = child->GetNext();
-      if (child)
+      in->SetBase(ParseTag(xml, false));
+      if (xml.AtNode())
       {
-        in->SetVar(ParseTag(child, true));
+        in->SetVar(ParseTag(xml, true));
         in->SetType(m_ParserStyle);
         in->SetStyle(TS_VARIABLE);
+        xml.FinishElement();
         return in;
       }
     }
   }
+  xml.FinishElement();
   delete in;
   return NULL;
 }
 
-MathCell* MathParser::ParseTableTag(wxXmlNode* node)
+MathCell* MathParser::ParseTableTag(XmlPullParser &xml)
 {
   MatrCell *matrix = new MatrCell;
   matrix->SetHighlight(m_highlight);
 
-  if (node->GetAttribute(wxT("special"), wxT("false")) == wxT("true"))
+  if (xml.GetAttribute(wxT("special"), wxT("false")) == wxT("true"))
     matrix->SetSpecialFlag(true);
-  if (node->GetAttribute(wxT("inference"), wxT("false")) == wxT("true"))
+  if (xml.GetAttribute(wxT("inference"), wxT("false")) == wxT("true"))
   {
     matrix->SetInferenceFlag(true);
     matrix->SetSpecialFlag(true);
   }
-  if (node->GetAttribute(wxT("colnames"), wxT("false")) == wxT("true"))
+  if (xml.GetAttribute(wxT("colnames"), wxT("false")) == wxT("true"))
     matrix->ColNames(true);
-  if (node->GetAttribute(wxT("rownames"), wxT("false")) == wxT("true"))
+  if (xml.GetAttribute(wxT("rownames"), wxT("false")) == wxT("true"))
     matrix->RowNames(true);
 
-  wxXmlNode* rows = node->GetChildren();
-  while (rows)
+  xml.Next();
+  while (xml.AtNode())
   {
     matrix->NewRow();
-    wxXmlNode* cells = rows->GetChildren();
-    while (cells)
+    if (xml.GetToken() == XmlPullParser::StartTag)
     {
-      matrix->NewColumn();
-      matrix->AddNewCell(ParseTag(cells, false));
-      cells = cells->GetNext();
+      xml.Next();
+      while (xml.AtNode())
+      {
+        matrix->NewColumn();
+        matrix->AddNewCell(ParseTag(xml, false));
+      }
+      xml.FinishElement();
     }
-    rows = rows->GetNext();
+    else
+      xml.Next();
   }
+  xml.FinishElement();
   matrix->SetType(m_ParserStyle);
   matrix->SetStyle(TS_VARIABLE);
   matrix->SetDimension();
   return matrix;
 }
 
-MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
+MathCell* MathParser::ParseImgTag(XmlPullParser &xml)
+{
+  bool del = (xml.GetAttribute(wxT("del"), wxT("yes")) != wxT("no"));
+  bool rect = (xml.GetAttribute(wxT("rect"), wxT("true")) != wxT("false"));
+  wxString filename;
+  if (xml.Next() == XmlPullParser::Text)
+    filename = xml.GetText();
+  xml.FinishElement();
+#if !wxUSE_UNICODE
+  wxString filename1(filename.wc_str(wxConvUTF8), *wxConvCurrent);
+  filename = filename1;
+#endif
+
+  ImgCell *img;
+
+  if (m_fileSystem) // loading from zip
+    img = new ImgCell(filename, false, m_fileSystem);
+  else if (del)
+    img = new ImgCell(filename, true, NULL);
+  else
+    img = new ImgCell(filename, false, NULL);
+
+  if (!rect)
+    img->DrawRectangle(false);
+
+  return img;
+}
+
+MathCell* MathParser::ParseSlideTag(XmlPullParser &xml)
+{
+  SlideShow *slideShow = new SlideShow(m_fileSystem);
+  wxString framerate;
+  if (xml.GetAttribute(wxT("fr"), &framerate))
+  {
+    long fr;
+    if (framerate.ToLong(&fr))
+      slideShow->SetFrameRate(fr);
+  }
+
+  wxString str;
+  if (xml.Next() == XmlPullParser::Text)
+    str = xml.GetText();
+  xml.FinishElement();
+
+  wxArrayString images;
+  wxStringTokenizer tokens(str, wxT(";"));
+  while (tokens.HasMoreTokens()) {
+    wxString token = tokens.GetNextToken();
+    if (token.Length())
+    {
+#if !wxUSE_UNICODE
+      wxString token1(token.wc_str(wxConvUTF8), *wxConvCurrent);
+      token = token1;
+#endif
+      images.Add(token);
+    }
+  }
+  slideShow->LoadImages(images);
+  return slideShow;
+}
+
+MathCell* MathParser::ParseTag(XmlPullParser &xml, bool all)
 {
-  //  wxYield();
   MathCell* tmp = NULL;
   MathCell* cell = NULL;
   bool warning = all;
   wxString altCopy;
 
-  while (node)
+  while (xml.AtNode())
   {
+    MathCell *parsed = NULL;
+    bool hasAltCopy = false;
+
     // Parse tags
-    if (node->GetType() == wxXML_ELEMENT_NODE)
+    if (xml.GetToken() == XmlPullParser::StartTag)
     {
-      wxString tagName(node->GetName());
+      hasAltCopy = xml.GetAttribute(wxT("altCopy"), &altCopy);
 
-      if (tagName == wxT("v"))
-      {               // Variables (atoms)
-        if (cell == NULL)
-          cell = ParseText(node->GetChildren(), TS_VARIABLE);
-        else
-          cell->AppendCell(ParseText(node->GetChildren(), TS_VARIABLE));
-      }
-      else if (tagName == wxT("t"))
-      {          // Other text
-        TextStyle style = TS_DEFAULT;
-        if(node->GetAttribute(wxT("type")) == wxT("error"))
-          style = TS_ERROR;
-
-        if (cell == NULL)
-          cell = ParseText(node->GetChildren(), style);
-        else
-          cell->AppendCell(ParseText(node->GetChildren(), style));
-      }
-      else if (tagName == wxT("n"))
-      {          // Numbers
-        if (cell == NULL)
-          cell = ParseText(node->GetChildren(), TS_NUMBER);
-        else
-          cell->AppendCell(ParseText(node->GetChildren(), TS_NUMBER));
-      }
-      else if (tagName == wxT("h"))
-      {          // Hidden cells (*)
-        MathCell* tmp = ParseText(node->GetChildren());
-        tmp->m_isHidden = true;
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
-      }
-      else if (tagName == wxT("p"))
-      {          // Parenthesis
-        if (cell == NULL)
-          cell = ParseParenTag(node);
-        else
-          cell->AppendCell(ParseParenTag(node));
-      }
-      else if (tagName == wxT("f"))
-      {               // Fractions
-        if (cell == NULL)
-          cell = ParseFracTag(node);
-        else
-          cell->AppendCell(ParseFracTag(node));
-      }
-      else if (tagName == wxT("e"))
-      {          // Exponentials
-        if (cell == NULL)
-          cell = ParseSupTag(node);
-        else
-          cell->AppendCell(ParseSupTag(node));
-      }
-      else if (tagName == wxT("i"))
-      {          // Subscripts
-        if (cell == NULL)
-          cell = ParseSubTag(node);
-        else
-          cell->AppendCell(ParseSubTag(node));
-      }
-      else if (tagName == wxT("fn"))
-      {         // Functions
-        if (cell == NULL)
-          cell = ParseFunTag(node);
-        else
-          cell->AppendCell(ParseFunTag(node));
-      }
-      else if (tagName == wxT("g"))
-      {          // Greek constants
-        MathCell* tmp = ParseText(node->GetChildren(), TS_GREEK_CONSTANT);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
-      }
-      else if (tagName == wxT("s"))
-      {          // Special constants %e,...
-        MathCell* tmp = ParseText(node->GetChildren(), TS_SPECIAL_CONSTANT);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
-      }
-      else if (tagName == wxT("fnm"))
-      {         // Function names
-        MathCell* tmp = ParseText(node->GetChildren(), TS_FUNCTION);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
-      }
-      else if (tagName == wxT("q"))
-      {          // Square roots
-        if (cell == NULL)
-          cell = ParseSqrtTag(node);
-        else
-          cell->AppendCell(ParseSqrtTag(node));
-      }
-      else if (tagName == wxT("d"))
-      {          // Differentials
-        if (cell == NULL)
-          cell = ParseDiffTag(node);
-        else
-          cell->AppendCell(ParseDiffTag(node));
-      }
-      else if (tagName == wxT("sm"))
-      {         // Sums
-        if (cell == NULL)
-          cell = ParseSumTag(node);
-        else
-          cell->AppendCell(ParseSumTag(node));
-      }
-      else if (tagName == wxT("in"))
-      {         // integrals
-        if (cell == NULL)
-          cell = ParseIntTag(node);
-        else
-          cell->AppendCell(ParseIntTag(node));
-      }
-      else if (tagName == wxT("mspace"))
-      {
-        if (cell == NULL)
-          cell = new TextCell(wxT(" "));
-        else
-          cell->AppendCell(new TextCell(wxT(" ")));
-      }
-      else if (tagName == wxT("at"))
-      {
-        if (cell == NULL)
-          cell = ParseAtTag(node);
-        else
-          cell->AppendCell(ParseAtTag(node));
-      }
-      else if (tagName == wxT("a"))
-      {
-        if (cell == NULL)
-          cell = ParseAbsTag(node);
-        else
-          cell->AppendCell(ParseAbsTag(node));
-      }
-      else if (tagName == wxT("cj"))
-      {
-        if (cell == NULL)
-          cell = ParseConjugateTag(node);
-        else
-          cell->AppendCell(ParseConjugateTag(node));
-      }
-      else if (tagName == wxT("ie"))
-      {
-        if (cell == NULL)
-          cell = ParseSubSupTag(node);
-        else
-          cell->AppendCell(ParseSubSupTag(node));
-      }
-      else if (tagName == wxT("lm"))
-      {
-        if (cell == NULL)
-          cell = ParseLimitTag(node);
-        else
-          cell->AppendCell(ParseLimitTag(node));
-      }
-      else if (tagName == wxT("r"))
-      {
-        if (cell == NULL)
-          cell = ParseTag(node->GetChildren());
-        else
-          cell->AppendCell(ParseTag(node->GetChildren()));
-      }
-      else if (tagName == wxT("tb"))
-      {
-        if (cell == NULL)
-          cell = ParseTableTag(node);
-        else
-          cell->AppendCell(ParseTableTag(node));
-      }
-      else if ((tagName == wxT("mth")) || (tagName == wxT("line")))
-      {
-        MathCell *tmp = ParseTag(node->GetChildren());
-        if (tmp != NULL)
-          tmp->ForceBreakLine(true);
-        else
-          tmp = new TextCell(wxT(" "));
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
-      }
-      else if (tagName == wxT("lbl"))
+      switch (GetTagId(xml.GetName()))
       {
-        MathCell* tmp = ParseText(node->GetChildren(), TS_LABEL);
-        tmp->ForceBreakLine(true);
-        if (cell == NULL)
-          cell = tmp;
+      case TAG_V:               // Variables (atoms)
+        parsed = ParseText(xml, TS_VARIABLE);
+        break;
+      case TAG_T:               // Other text
+        if (xml.GetAttribute(wxT("type"), wxEmptyString) == wxT("error"))
+          parsed = ParseText(xml, TS_ERROR);
         else
-          cell->AppendCell(tmp);
-      }
-      else if (tagName == wxT("st"))
-      {
-        MathCell* tmp = ParseText(node->GetChildren(), TS_STRING);
-        if (cell == NULL)
-          cell = tmp;
+          parsed = ParseText(xml, TS_DEFAULT);
+        break;
+      case TAG_N:               // Numbers
+        parsed = ParseText(xml, TS_NUMBER);
+        break;
+      case TAG_H:               // Hidden cells (*)
+        parsed = ParseText(xml);
+        parsed->m_isHidden = true;
+        break;
+      case TAG_P:               // Parenthesis
+        parsed = ParseParenTag(xml);
+        break;
+      case TAG_F:               // Fractions
+        parsed = ParseFracTag(xml);
+        break;
+      case TAG_E:               // Exponentials
+        parsed = ParseSupTag(xml);
+        break;
+      case TAG_I:               // Subscripts
+        parsed = ParseSubTag(xml);
+        break;
+      case TAG_FN:              // Functions
+        parsed = ParseFunTag(xml);
+        break;
+      case TAG_G:               // Greek constants
+        parsed = ParseText(xml, TS_GREEK_CONSTANT);
+        break;
+      case TAG_S:               // Special constants %e,...
+        parsed = ParseText(xml, TS_SPECIAL_CONSTANT);
+        break;
+      case TAG_FNM:             // Function names
+        parsed = ParseText(xml, TS_FUNCTION);
+        break;
+      case TAG_Q:               // Square roots
+        parsed = ParseSqrtTag(xml);
+        break;
+      case TAG_D:               // Differentials
+        parsed = ParseDiffTag(xml);
+        break;
+      case TAG_SM:              // Sums
+        parsed = ParseSumTag(xml);
+        break;
+      case TAG_IN:              // integrals
+        parsed = ParseIntTag(xml);
+        break;
+      case TAG_MSPACE:
+        parsed = new TextCell(wxT(" "));
+        xml.SkipNode();
+        break;
+      case TAG_AT:
+        parsed = ParseAtTag(xml);
+        break;
+      case TAG_A:
+        parsed = ParseAbsTag(xml);
+        break;
+      case TAG_CJ:
+        parsed = ParseConjugateTag(xml);
+        break;
+      case TAG_IE:
+        parsed = ParseSubSupTag(xml);
+        break;
+      case TAG_LM:
+        parsed = ParseLimitTag(xml);
+        break;
+      case TAG_R:
+        parsed = ParseChildren(xml);
+        break;
+      case TAG_TB:
+        parsed = ParseTableTag(xml);
+        break;
+      case TAG_MTH:
+      case TAG_LINE:
+        parsed = ParseChildren(xml);
+        if (parsed != NULL)
+          parsed->ForceBreakLine(true);
         else
-          cell->AppendCell(tmp);
-      }
-      else if (tagName == wxT("hl"))
+          parsed = new TextCell(wxT(" "));
+        break;
+      case TAG_LBL:
+        parsed = ParseText(xml, TS_LABEL);
+        parsed->ForceBreakLine(true);
+        break;
+      case TAG_ST:
+        parsed = ParseText(xml, TS_STRING);
+        break;
+      case TAG_HL:
       {
         bool highlight = m_highlight;
         m_highlight = true;
-        MathCell* tmp = ParseTag(node->GetChildren());
+        parsed = ParseChildren(xml);
         m_highlight = highlight;
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        break;
       }
-      else if (tagName == wxT("img"))
-      {
-        wxString filename(node->GetChildren()->GetContent());
-#if !wxUSE_UNICODE
-        wxString filename1(filename.wc_str(wxConvUTF8), *wxConvCurrent);
-        filename = filename1;
-#endif
-
-        ImgCell *tmp;
-
-        if (m_fileSystem) // loading from zip
-          tmp = new ImgCell(filename, false, m_fileSystem);
-        else if (node->GetAttribute(wxT("del"), wxT("yes")) != wxT("no"))
-          tmp = new ImgCell(filename, true, NULL);
-        else
-          tmp = new ImgCell(filename, false, NULL);
-
-        if (node->GetAttribute(wxT("rect"), wxT("true")) == wxT("false"))
-          tmp->DrawRectangle(false);
-
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
-      }
-      else if (tagName == wxT("slide"))
-      {
-        SlideShow *tmp = new SlideShow(m_fileSystem);
-        wxString str(node->GetChildren()->GetContent());
-        wxArrayString images;
-        wxString framerate;
-        wxStringTokenizer tokens(str, wxT(";"));
-        if (node->GetAttribute(wxT("fr"), &framerate))
-        {
-          long fr;
-          if (framerate.ToLong(&fr))
-            tmp->SetFrameRate(fr);
-        }
-        while (tokens.HasMoreTokens()) {
-          wxString token = tokens.GetNextToken();
-          if (token.Length())
-          {
-#if !wxUSE_UNICODE
-            wxString token1(token.wc_str(wxConvUTF8), *wxConvCurrent);
-            token = token1;
-#endif
-            images.Add(token);
-          }
-        }
-        tmp->LoadImages(images);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
-      }
-      else if (tagName == wxT("editor"))
-      {
-        if (cell == NULL)
-          cell = ParseEditorTag(node);
-        else
-          cell->AppendCell(ParseEditorTag(node));
-      }
-      else if (tagName == wxT("cell"))
-      {
-        if (cell == NULL)
-          cell = ParseCellTag(node);
-        else
-          cell->AppendCell(ParseCellTag(node));
-      }
-      else if (tagName == wxT("ascii"))
-      {
-        if (cell == NULL)
-          cell = ParseCharCode(node->GetChildren());
-        else
-          cell->AppendCell(ParseCharCode(node->GetChildren()));
-      }
-      else if (node->GetChildren())
-      {
-        if (cell == NULL)
-          cell = ParseTag(node->GetChildren());
-        else
-          cell->AppendCell(ParseTag(node->GetChildren()));
+      case TAG_IMG:
+        parsed = ParseImgTag(xml);
+        break;
+      case TAG_SLIDE:
+        parsed = ParseSlideTag(xml);
+        break;
+      case TAG_ASCII:
+        parsed = ParseCharCode(xml);
+        break;
+      case TAG_EDITOR:
+        parsed = ParseEditorTag(xml);
+        break;
+      case TAG_CELL:
+        parsed = ParseCellTag(xml);
+        break;
+      case TAG_LONGOUTPUT:
+        parsed = ParseLongOutputTag(xml);
+        break;
+      default:
+        parsed = ParseChildren(xml);
+        break;
       }
     }
     // Parse text
     else
     {
-      if (cell == NULL)
-        cell = ParseText(node);
-      else
-        cell->AppendCell(ParseText(node));
+      parsed = ParseText(xml.GetText());
+      xml.Next();
     }
+
+    if (cell == NULL)
+      cell = parsed;
+    else
+      cell->AppendCell(parsed);
+
     if (!all)
       break;
 
@@ -970,15 +1044,17 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
     }
     else if (warning)
     {
-      wxMessageBox(_("Parts of the document will not be loaded correctly!"), _("Warning"),
-        wxOK | wxICON_WARNING);
+      // The background parser isn't allowed to open dialogs.
+      if (wxThread::IsMain())
+        wxMessageBox(_("Parts of the document will not be loaded correctly!"), _("Warning"),
+                     wxOK | wxICON_WARNING);
+      else
+        wxLogWarning(_("Parts of the document will not be loaded correctly!"));
       warning = false;
     }
 
-    if (node->GetAttribute(wxT("altCopy"), &altCopy))
+    if (hasAltCopy && (cell != NULL))
       cell->SetAltCopyText(altCopy);
-
-    node = node->GetNext();
   }
 
   if (tmp != NULL)
@@ -986,6 +1062,32 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
   return cell;
 }
 
+void MathParser::ReplaceControlChars(wxString &s)
+{
+  // Most output doesn't contain any control characters => we only need to
+  // copy the string if we find one.
+  wxString::const_iterator ch = s.begin();
+  while ((ch != s.end()) && !IsControlChar(*ch))
+    ++ch;
+  if (ch == s.end())
+    return;
+
+  wxString result;
+  result.Alloc(s.Length());
+  for (ch = s.begin(); ch != s.end(); ++ch)
+  {
+    if (IsControlChar(*ch))
+#if wxUSE_UNICODE
+      result += wxT("\xFFFD");
+#else
+      result += wxT("?");
+#endif
+    else
+      result += *ch;
+  }
+  s = result;
+}
+
 /***
  * Parse the string s, which is (correct) xml fragment.
  * Put the result in line.
@@ -997,56 +1099,53 @@ MathCell* MathParser::ParseLine(wxString s, int style)
   m_highlight = false;
   MathCell* cell = NULL;
 
-  wxConfigBase* config = wxConfig::Get();
-  int showLength = 0;
-  config->Read(wxT("showLength"), &showLength);
-
-  switch(showLength)
+  // Expressions that are too long for being laid out in 2D are displayed
+  // as plain text.
+  if ((m_maxLength != 0) && (s.Length() >= (size_t) m_maxLength))
   {
-  case 0:
-    showLength = 50000;
-    break;
-  case 1:
-    showLength = 500000;
-    break;
-  case 2:
-    showLength = 5000000;
-    break;
-  case 3:
-    showLength = 0;
-    break;
+    cell = new LongOutputCell(LongOutputCell::XmlToText(s));
+    cell->SetType(m_ParserStyle);
+    cell->ForceBreakLine(true);
+    return cell;
   }
-  wxRegEx graph(wxT("[[:cntrl:]]"));
 
 #if wxUSE_UNICODE
-  graph.Replace(&s, wxT("\xFFFD"));
-#else
-  graph.Replace(&s, wxT("?"));
-#endif
-
-  if ((s.Length() < showLength) || (showLength=0))
+  // Compact frames are never wrapped in a <span>.
+  if (XmlPullParser::IsCompactFrame(s))
   {
-
-    wxXmlDocument xml;
-
-#if wxUSE_UNICODE
-    wxStringInputStream xmlStream(s);
-#else
-    wxString su(s.wc_str(*wxConvCurrent), wxConvUTF8);
-    wxStringInputStream xmlStream(su);
+    XmlPullParser pullParser(s);
+    pullParser.Next();
+    cell = ParseTag(pullParser, true);
+    if (pullParser.GetToken() != XmlPullParser::EndOfDocument)
+    {
+      delete cell;
+      cell = NULL;
+    }
+    return cell;
+  }
 #endif
 
-    xml.Load(xmlStream);
+  ReplaceControlChars(s);
 
-    wxXmlNode *doc = xml.GetRoot();
+#if !wxUSE_UNICODE
+  // The Parse*Tag functions expect the text they read to be UTF-8 encoded.
+  wxString su(s.wc_str(*wxConvCurrent), wxConvUTF8);
+  s = su;
+#endif
 
-    if (doc != NULL)
-      cell = ParseTag(doc->GetChildren());
-  }
-  else
+  // The cells are built directly from the xml tokens: Building a wxXmlDocument
+  // first would be much more expensive.
+  XmlPullParser pullParser(s);
+  if (pullParser.Next() == XmlPullParser::StartTag)
   {
-    cell = new TextCell(_(" << Expression too long to display! >>"));
-    cell->ForceBreakLine(true);
+    cell = ParseChildren(pullParser);
+    // Broken xml
+    if (pullParser.GetToken() != XmlPullParser::EndOfDocument)
+    {
+      delete cell;
+      cell = NULL;
+    }
   }
+
   return cell;
 }
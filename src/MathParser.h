@@ -27,18 +27,21 @@ The header file for the xml cell parser
 #ifndef MATHPARSER_H
 #define MATHPARSER_H
 
-#include <wx/xml/xml.h>
-
 #include <wx/filesys.h>
 #include <wx/fs_arc.h>
 
 #include "MathCell.h"
 #include "TextCell.h"
+#include "XmlPullParser.h"
 
 /*! This class handles parsing the xml representation of a cell tree.
 
 The xml representation of a cell tree can be found in the file contents.xml 
-inside a wxmx file
+inside a wxmx file.
+
+Both this file and the output from maxima are converted by the ParseTag()
+family of functions that create the cells directly while reading through the
+xml by the means of a XmlPullParser.
  */
 class MathParser
 {
@@ -46,7 +49,39 @@ public:
   MathParser(wxString zipfile = wxEmptyString);
   ~MathParser();
   MathCell* ParseLine(wxString s, int style = MC_TYPE_DEFAULT);
-  MathCell* ParseTag(wxXmlNode* node, bool all = true);
+  /*! Convert xml nodes into cells while reading them from a pull parser
+
+    \param xml The parser. Has to point at the first node that is to be
+                converted. On return it points at the token after the last
+                node that was converted.
+    \param all true = convert all nodes up to the end of the current element,
+                false = convert only one node.
+   */
+  MathCell* ParseTag(XmlPullParser &xml, bool all = true);
+  /*! Re-reads the settings that influence parsing from the configuration
+
+    ParseLine() doesn't access the configuration itself so it can be used
+    from a thread other than the main one.
+  */
+  void ReadConfig();
+  //! The maximum length of a line of output we display. 0 means: No limit.
+  int GetMaxLength()
+    {
+      return m_maxLength;
+    }
+  void SetMaxLength(int maxLength)
+    {
+      m_maxLength = maxLength;
+    }
+  //! The maximum number of digits of a number that is to be displayed
+  int GetDisplayedDigits()
+    {
+      return m_displayedDigits;
+    }
+  void SetDisplayedDigits(int displayedDigits)
+    {
+      m_displayedDigits = displayedDigits;
+    }
 private:
   /*! Convert XML to a group tree
 
@@ -56,30 +91,78 @@ private:
     has to be reflected here in order to ensure proper
     loading of WXMX files.
   */
-  MathCell* ParseCellTag(wxXmlNode* node);
-  MathCell* ParseEditorTag(wxXmlNode* node);
-  MathCell* ParseFracTag(wxXmlNode* node);
-  MathCell* ParseText(wxXmlNode* node, int style = TS_DEFAULT);
-  MathCell* ParseCharCode(wxXmlNode* node, int style = TS_DEFAULT);
-  MathCell* ParseSupTag(wxXmlNode* node);
-  MathCell* ParseSubTag(wxXmlNode* node);
-  MathCell* ParseAbsTag(wxXmlNode* node);
-  MathCell* ParseConjugateTag(wxXmlNode* node);
-  MathCell* ParseUnderTag(wxXmlNode* node);
-  MathCell* ParseTableTag(wxXmlNode* node);
-  MathCell* ParseAtTag(wxXmlNode* node);
-  MathCell* ParseDiffTag(wxXmlNode* node);
-  MathCell* ParseSumTag(wxXmlNode* node);
-  MathCell* ParseIntTag(wxXmlNode* node);
-  MathCell* ParseFunTag(wxXmlNode* node);
-  MathCell* ParseSqrtTag(wxXmlNode* node);
-  MathCell* ParseLimitTag(wxXmlNode* node);
-  MathCell* ParseParenTag(wxXmlNode* node);
-  MathCell* ParseSubSupTag(wxXmlNode* node);
+  MathCell* ParseCellTag(XmlPullParser &xml);
+  MathCell* ParseEditorTag(XmlPullParser &xml);
+  //! Creates a text cell from a string that was read from the xml
+  MathCell* ParseText(wxString str, int style = TS_DEFAULT);
+  //! Creates a text cell from a string containing a character code
+  MathCell* ParseCharCode(wxString str, int style = TS_DEFAULT);
+
+  //! The ids of the tags maxima's output is made of
+  enum TagId
+  {
+    TAG_UNKNOWN,
+    TAG_V, TAG_T, TAG_N, TAG_H, TAG_P, TAG_F, TAG_E, TAG_I, TAG_G, TAG_S,
+    TAG_Q, TAG_D, TAG_A, TAG_R,
+    TAG_FN, TAG_SM, TAG_ST, TAG_IN, TAG_IE, TAG_AT, TAG_CJ, TAG_LM, TAG_TB,
+    TAG_HL,
+    TAG_MTH, TAG_FNM, TAG_LBL, TAG_IMG, TAG_LINE, TAG_CELL, TAG_SLIDE,
+    TAG_ASCII, TAG_MSPACE, TAG_EDITOR, TAG_LONGOUTPUT
+  };
+  //! Determines the id of a tag without comparing its name to all known tags
+  static TagId GetTagId(const wxString &name);
+
+  /*! \name Pull parser versions of the Parse*Tag functions
+
+    Each of these functions is called with the pull parser pointing at the
+    start tag of the element it converts and returns with the parser pointing
+    at the token after the element's end tag.
+   */
+  //! \{
+  //! Converts all children of the current element
+  MathCell* ParseChildren(XmlPullParser &xml);
+  MathCell* ParseText(XmlPullParser &xml, int style = TS_DEFAULT);
+  MathCell* ParseCharCode(XmlPullParser &xml, int style = TS_DEFAULT);
+  MathCell* ParseFracTag(XmlPullParser &xml);
+  MathCell* ParseSupTag(XmlPullParser &xml);
+  MathCell* ParseSubTag(XmlPullParser &xml);
+  MathCell* ParseAbsTag(XmlPullParser &xml);
+  MathCell* ParseConjugateTag(XmlPullParser &xml);
+  MathCell* ParseTableTag(XmlPullParser &xml);
+  MathCell* ParseAtTag(XmlPullParser &xml);
+  MathCell* ParseDiffTag(XmlPullParser &xml);
+  MathCell* ParseSumTag(XmlPullParser &xml);
+  MathCell* ParseIntTag(XmlPullParser &xml);
+  MathCell* ParseFunTag(XmlPullParser &xml);
+  MathCell* ParseSqrtTag(XmlPullParser &xml);
+  MathCell* ParseLimitTag(XmlPullParser &xml);
+  MathCell* ParseParenTag(XmlPullParser &xml);
+  MathCell* ParseSubSupTag(XmlPullParser &xml);
+  MathCell* ParseImgTag(XmlPullParser &xml);
+  MathCell* ParseSlideTag(XmlPullParser &xml);
+  //! Reads the text a LongOutputCell has written by ToXML() back
+  MathCell* ParseLongOutputTag(XmlPullParser &xml);
+  //! \}
+
+  /*! Is c a control character?
+
+    These are the characters the regular expression [[:cntrl:]] matches:
+    The C0 and C1 control codes and DEL.
+   */
+  static bool IsControlChar(wxUniChar c)
+    {
+      wxUint32 code = c.GetValue();
+      return (code < 0x20) || ((code >= 0x7F) && (code < 0xA0));
+    }
+  //! Replaces all control characters in s by a replacement character
+  static void ReplaceControlChars(wxString &s);
+
   int m_ParserStyle;
   int m_FracStyle;
   //! The maximum number of digits of a number that is to be displayed
   int m_displayedDigits;
+  //! The maximum length of a line of output that is to be displayed, 0 = no limit.
+  int m_maxLength;
   bool m_highlight;
   wxFileSystem *m_fileSystem; // used for loading pictures in <img> and <slide>
 };
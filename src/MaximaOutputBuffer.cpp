@@ -0,0 +1,283 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "MaximaOutputBuffer.h"
+
+MaximaOutputBuffer::MaximaOutputBuffer()
+{
+  m_start = 0;
+#if wxUSE_UNICODE
+  m_pendingLength = 0;
+#endif
+}
+
+void MaximaOutputBuffer::Append(const wxString &data)
+{
+  m_data += data;
+}
+
+#if wxUSE_UNICODE
+void MaximaOutputBuffer::AppendUTF8(const char *data, size_t length)
+{
+  const unsigned char *bytes = (const unsigned char *) data;
+
+  // Every byte results in at most one wxChar. A sequence that has been
+  // started in the last packet might add a few replacement characters.
+  if (m_decoded.size() < length + 8)
+    m_decoded.resize(length + 8);
+  size_t out = 0;
+  size_t pos = 0;
+
+  // Complete the sequence the last packet has ended in.
+  if (m_pendingLength > 0)
+  {
+    size_t pending = m_pendingLength;
+    while ((m_pendingLength < 4) && (pos < length))
+      m_pendingBytes[m_pendingLength++] = bytes[pos++];
+    size_t used = DecodeUTF8(m_pendingBytes, m_pendingLength, out);
+    if (used == 0)
+      // Still incomplete: All of data fit into m_pendingBytes.
+      return;
+    // The bytes of data that haven't been used yet are decoded below.
+    if (used < pending)
+      used = pending;
+    pos = used - pending;
+    m_pendingLength = 0;
+  }
+
+  pos += DecodeUTF8(bytes + pos, length - pos, out);
+
+  // Keep an incomplete sequence at the end for the next packet.
+  while (pos < length)
+    m_pendingBytes[m_pendingLength++] = bytes[pos++];
+
+  m_data.append(&m_decoded[0], out);
+}
+
+void MaximaOutputBuffer::PutChar(wxUint32 code, size_t &out)
+{
+#if wxSIZEOF_WCHAR_T == 2
+  if (code >= 0x10000)
+  {
+    code -= 0x10000;
+    m_decoded[out++] = (wxChar) (0xD800 + (code >> 10));
+    m_decoded[out++] = (wxChar) (0xDC00 + (code & 0x3FF));
+    return;
+  }
+#endif
+  m_decoded[out++] = (wxChar) code;
+}
+
+size_t MaximaOutputBuffer::DecodeUTF8(const unsigned char *data, size_t length,
+                                      size_t &out)
+{
+  size_t pos = 0;
+  while (pos < length)
+  {
+    unsigned char ch = data[pos];
+
+    // Most of maxima's output is plain ASCII.
+    if (ch < 0x80)
+    {
+      m_decoded[out++] = ch;
+      pos++;
+      continue;
+    }
+
+    size_t sequenceLength;
+    wxUint32 code;
+    wxUint32 minCode;
+    if ((ch >= 0xC2) && (ch <= 0xDF))
+    {
+      sequenceLength = 2;
+      code = ch & 0x1F;
+      minCode = 0x80;
+    }
+    else if ((ch >= 0xE0) && (ch <= 0xEF))
+    {
+      sequenceLength = 3;
+      code = ch & 0x0F;
+      minCode = 0x800;
+    }
+    else if ((ch >= 0xF0) && (ch <= 0xF4))
+    {
+      sequenceLength = 4;
+      code = ch & 0x07;
+      minCode = 0x10000;
+    }
+    else
+    {
+      // A stray continuation byte or a byte that never occurs in UTF-8
+      PutChar(0xFFFD, out);
+      pos++;
+      continue;
+    }
+
+    size_t i;
+    for (i = 1; (i < sequenceLength) && (pos + i < length); i++)
+    {
+      if ((data[pos + i] & 0xC0) != 0x80)
+        break;
+      code = (code << 6) | (data[pos + i] & 0x3F);
+    }
+
+    if (i < sequenceLength)
+    {
+      // The rest of the sequence is still on its way.
+      if (pos + i == length)
+        return pos;
+      // The sequence has been interrupted by a byte that doesn't belong to it.
+      PutChar(0xFFFD, out);
+      pos += i;
+      continue;
+    }
+
+    // Overlong encodings, UTF-16 surrogates and codes beyond unicode
+    if ((code < minCode) || ((code >= 0xD800) && (code <= 0xDFFF)) ||
+        (code > 0x10FFFF))
+      code = 0xFFFD;
+    PutChar(code, out);
+    pos += sequenceLength;
+  }
+  return pos;
+}
+#endif
+
+int MaximaOutputBuffer::Find(const wxString &marker, size_t from)
+{
+  size_t start = m_start + from;
+  if (start > m_data.Length())
+    return wxNOT_FOUND;
+
+  // The cache only tells that there is no marker between the start of the
+  // unconsumed data and the cached position.
+  std::map<wxString, size_t>::iterator it = m_searchedUntil.find(marker);
+  if ((it != m_searchedUntil.end()) && (it->second > start))
+    start = it->second;
+
+  size_t pos = m_data.find(marker, start);
+  if (pos == wxString::npos)
+  {
+    // The last few characters might be the beginning of a marker whose
+    // rest is still on its way.
+    if (from == 0)
+    {
+      size_t searched = m_data.Length();
+      if (searched >= start + marker.Length())
+        searched -= marker.Length() - 1;
+      else
+        searched = start;
+      m_searchedUntil[marker] = searched;
+    }
+    return wxNOT_FOUND;
+  }
+
+  // A search that didn't start at the beginning of the data doesn't know if
+  // there is a marker in front of from.
+  if (from == 0)
+    m_searchedUntil[marker] = pos;
+  return pos - m_start;
+}
+
+bool MaximaOutputBuffer::IsSameAs(const wxString &str) const
+{
+  if (str.Length() != Length())
+    return false;
+  return m_data.compare(m_start, str.Length(), str) == 0;
+}
+
+void MaximaOutputBuffer::Consume(size_t len)
+{
+  m_start += len;
+  if (m_start > m_data.Length())
+    m_start = m_data.Length();
+
+  // Positions in front of the new start don't tell anything any more.
+  std::map<wxString, size_t>::iterator it = m_searchedUntil.begin();
+  while (it != m_searchedUntil.end())
+  {
+    if (it->second < m_start)
+      m_searchedUntil.erase(it++);
+    else
+      ++it;
+  }
+  Compact();
+}
+
+void MaximaOutputBuffer::Remove(size_t start, size_t len)
+{
+  start += m_start;
+  m_data.erase(start, len);
+
+  // Everything behind the removed part has moved so we have to search
+  // it again. The text in front of the removed part now is joined to the
+  // text behind it => a marker might begin up to its length - 1 characters
+  // in front of start.
+  for (std::map<wxString, size_t>::iterator it = m_searchedUntil.begin();
+       it != m_searchedUntil.end(); ++it)
+  {
+    size_t overlap = it->first.Length() - 1;
+    size_t searchFrom = m_start;
+    if (start > m_start + overlap)
+      searchFrom = start - overlap;
+    if (it->second > searchFrom)
+      it->second = searchFrom;
+  }
+}
+
+void MaximaOutputBuffer::Clear()
+{
+  DropData();
+#if wxUSE_UNICODE
+  m_pendingLength = 0;
+#endif
+}
+
+void MaximaOutputBuffer::DropData()
+{
+  m_data = wxEmptyString;
+  m_start = 0;
+  m_searchedUntil.clear();
+}
+
+void MaximaOutputBuffer::Compact()
+{
+  // The start of a multibyte sequence that is still on its way isn't part
+  // of m_data => it survives this.
+  if (m_start == m_data.Length())
+  {
+    DropData();
+    return;
+  }
+
+  if (m_start < m_data.Length() - m_start)
+    return;
+
+  m_data.erase(0, m_start);
+  for (std::map<wxString, size_t>::iterator it = m_searchedUntil.begin();
+       it != m_searchedUntil.end(); ++it)
+  {
+    if (it->second > m_start)
+      it->second -= m_start;
+    else
+      it->second = 0;
+  }
+  m_start = 0;
+}
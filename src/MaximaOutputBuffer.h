@@ -0,0 +1,143 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+  The buffer the data we receive from maxima's socket is collected in.
+*/
+
+#ifndef MAXIMAOUTPUTBUFFER_H
+#define MAXIMAOUTPUTBUFFER_H
+
+#include <wx/wx.h>
+#include <wx/string.h>
+#include <map>
+#include <vector>
+
+/*! A buffer for the data maxima sends us that can be scanned incrementally
+
+  Maxima's output arrives in small packets. Before we can display anything
+  we have to search the data for markers like the end of a math cell or the
+  prompt prefix and suffix. Searching the whole accumulated data from the start
+  every time a new packet arrives would make the time needed for long outputs
+  grow quadratically with their length. Instead this buffer remembers for every
+  marker up to which position it has already been searched for so every
+  character is inspected only once per marker.
+
+  Data is consumed from the front by moving a start offset instead of copying
+  the rest of the data: The memory is compacted only once the consumed part
+  outweighs the unconsumed one.
+*/
+class MaximaOutputBuffer
+{
+public:
+  MaximaOutputBuffer();
+
+  //! Appends newly received data to the end of the buffer
+  void Append(const wxString &data);
+
+#if wxUSE_UNICODE
+  /*! Decodes UTF-8 data we got from the socket and appends it to the buffer
+
+    The data doesn't need to end at a character boundary: An incomplete
+    multibyte sequence at its end is kept until the next call completes it.
+    Invalid sequences are replaced by U+FFFD.
+  */
+  void AppendUTF8(const char *data, size_t length);
+#endif
+
+  /*! Searches for the next occurrence of marker
+
+    The search is resumed at the position the last unsuccessful search for
+    the same marker has stopped at.
+    \param from Where to start searching, relative to the start of the
+                unconsumed data.
+    \return The position of the marker relative to the start of the unconsumed
+    data or wxNOT_FOUND.
+  */
+  int Find(const wxString &marker, size_t from = 0);
+
+  //! Returns the first len characters of the unconsumed data
+  wxString Left(size_t len) const
+    {
+      return m_data.Mid(m_start, len);
+    }
+  //! Returns len characters of the unconsumed data starting at start
+  wxString Mid(size_t start, size_t len) const
+    {
+      return m_data.Mid(m_start + start, len);
+    }
+  //! Returns a copy of all data that hasn't been consumed yet
+  wxString GetString() const
+    {
+      return m_data.Mid(m_start);
+    }
+  //! Is the unconsumed data equal to str?
+  bool IsSameAs(const wxString &str) const;
+
+  //! Removes len characters from the front of the buffer
+  void Consume(size_t len);
+  //! Removes the len characters starting at start from the buffer
+  void Remove(size_t start, size_t len);
+  //! Discards all data
+  void Clear();
+
+  //! The number of characters that haven't been consumed yet
+  size_t Length() const
+    {
+      return m_data.Length() - m_start;
+    }
+  bool IsEmpty() const
+    {
+      return Length() == 0;
+    }
+
+private:
+  //! Drops the consumed part of m_data if it is bigger than the rest
+  void Compact();
+  //! Discards all data but keeps an incomplete multibyte sequence
+  void DropData();
+#if wxUSE_UNICODE
+  /*! Decodes the UTF-8 data to m_decoded, starting at index out
+
+    Stops in front of an incomplete sequence at the end of data.
+    \return The number of bytes that have been decoded.
+  */
+  size_t DecodeUTF8(const unsigned char *data, size_t length, size_t &out);
+  //! Appends the character code to m_decoded at index out
+  void PutChar(wxUint32 code, size_t &out);
+  //! The start of a multibyte sequence the last packet has ended in
+  unsigned char m_pendingBytes[4];
+  //! The number of valid bytes in m_pendingBytes
+  size_t m_pendingLength;
+  //! The buffer DecodeUTF8() writes to. Is kept in order to avoid allocations.
+  std::vector<wxChar> m_decoded;
+#endif
+  //! The data. Everything before m_start already has been consumed.
+  wxString m_data;
+  //! The position of the first character in m_data that hasn't been consumed yet
+  size_t m_start;
+  /*! The position in m_data each marker has to be searched for from on.
+
+    Positions are absolute indices into m_data.
+  */
+  std::map<wxString, size_t> m_searchedUntil;
+};
+
+#endif // MAXIMAOUTPUTBUFFER_H
@@ -0,0 +1,210 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "ScaledBitmapCache.h"
+
+ScaledBitmapCache *ScaledBitmapCache::m_cache = NULL;
+
+ScaledBitmapCache *ScaledBitmapCache::Get()
+{
+  if (m_cache == NULL)
+    m_cache = new ScaledBitmapCache();
+  return m_cache;
+}
+
+ScaledBitmapCache::ScaledBitmapCache()
+{
+  m_worker = NULL;
+  m_budget = SCALEDBITMAPCACHE_DEFAULT_BUDGET;
+  m_memoryUsage = 0;
+  m_nextSerial = 0;
+  m_useCounter = 0;
+}
+
+ScaledBitmapCache::Worker::Worker(wxEvtHandler *handler, int id) :
+  wxThread(wxTHREAD_JOINABLE)
+{
+  m_handler = handler;
+  m_id = id;
+}
+
+wxThread::ExitCode ScaledBitmapCache::Worker::Entry()
+{
+  Job *job;
+  while ((m_jobs.Receive(job) == wxMSGQUEUE_NO_ERROR) && (job != NULL))
+  {
+    job->m_image = Rescale(job->m_image, job->m_size);
+    m_results.Post(job);
+    wxQueueEvent(m_handler, new wxThreadEvent(wxEVT_THREAD, m_id));
+  }
+  return 0;
+}
+
+wxImage ScaledBitmapCache::Rescale(const wxImage &image, wxSize size)
+{
+  return image.Scale(size.x, size.y, wxIMAGE_QUALITY_BICUBIC);
+}
+
+void ScaledBitmapCache::SetHandler(wxEvtHandler *handler, int id)
+{
+  StopWorker();
+  if (handler == NULL)
+    return;
+
+  m_worker = new Worker(handler, id);
+  if (m_worker->Run() != wxTHREAD_NO_ERROR)
+  {
+    delete m_worker;
+    m_worker = NULL;
+  }
+}
+
+void ScaledBitmapCache::StopWorker()
+{
+  if (m_worker == NULL)
+    return;
+
+  m_worker->m_jobs.Post(NULL);
+  m_worker->Wait();
+
+  Job *job;
+  while (m_worker->m_jobs.ReceiveTimeout(0, job) == wxMSGQUEUE_NO_ERROR)
+    delete job;
+  while (m_worker->m_results.ReceiveTimeout(0, job) == wxMSGQUEUE_NO_ERROR)
+    delete job;
+  delete m_worker;
+  m_worker = NULL;
+
+  // Nobody will improve the previews any more.
+  EntryMap::iterator it = m_entries.begin();
+  while (it != m_entries.end())
+  {
+    if (it->second.m_highQuality)
+      ++it;
+    else
+    {
+      m_memoryUsage -= MemoryUsage(it->second.m_size);
+      m_entries.erase(it++);
+    }
+  }
+}
+
+const wxBitmap &ScaledBitmapCache::GetScaled(const Image *source, wxSize size,
+                                             const wxRect &where, bool preview)
+{
+  EntryMap::iterator found = m_entries.find(source);
+  if ((found != m_entries.end()) && (found->second.m_size == size) &&
+      (found->second.m_highQuality || (preview && (m_worker != NULL))))
+  {
+    found->second.m_where = where;
+    found->second.m_lastUse = ++m_useCounter;
+    return found->second.m_bitmap;
+  }
+
+  if (found != m_entries.end())
+    m_memoryUsage -= MemoryUsage(found->second.m_size);
+
+  Entry &entry = m_entries[source];
+  entry.m_size = size;
+  entry.m_serial = ++m_nextSerial;
+  entry.m_where = where;
+  entry.m_lastUse = ++m_useCounter;
+  m_memoryUsage += MemoryUsage(size);
+
+  if (preview && (m_worker != NULL))
+  {
+    // The job gets an image that doesn't share its data with anything the
+    // main thread still uses: Reference counting isn't thread-safe.
+    Job *job = new Job;
+    job->m_source = source;
+    job->m_serial = entry.m_serial;
+    job->m_size = size;
+    job->m_image = source->ToImage();
+    entry.m_bitmap = wxBitmap(job->m_image.Scale(size.x, size.y, wxIMAGE_QUALITY_NEAREST));
+    entry.m_highQuality = false;
+    m_worker->m_jobs.Post(job);
+  }
+  else
+  {
+    entry.m_bitmap = wxBitmap(Rescale(source->ToImage(), size));
+    entry.m_highQuality = true;
+  }
+
+  KeepBudget(source);
+  return m_entries[source].m_bitmap;
+}
+
+void ScaledBitmapCache::Forget(const Image *source)
+{
+  EntryMap::iterator found = m_entries.find(source);
+  if (found == m_entries.end())
+    return;
+  m_memoryUsage -= MemoryUsage(found->second.m_size);
+  m_entries.erase(found);
+}
+
+std::vector<wxRect> ScaledBitmapCache::TakeResults()
+{
+  std::vector<wxRect> improved;
+  if (m_worker == NULL)
+    return improved;
+
+  Job *job;
+  while (m_worker->m_results.ReceiveTimeout(0, job) == wxMSGQUEUE_NO_ERROR)
+  {
+    // The image might have been deleted or drawn with another size meanwhile.
+    EntryMap::iterator found = m_entries.find(job->m_source);
+    if ((found != m_entries.end()) && (found->second.m_serial == job->m_serial))
+    {
+      found->second.m_bitmap = wxBitmap(job->m_image);
+      found->second.m_highQuality = true;
+      improved.push_back(found->second.m_where);
+    }
+    delete job;
+  }
+  return improved;
+}
+
+void ScaledBitmapCache::SetBudget(size_t budget)
+{
+  m_budget = budget;
+  KeepBudget(NULL);
+}
+
+void ScaledBitmapCache::KeepBudget(const Image *keep)
+{
+  while (m_memoryUsage > m_budget)
+  {
+    // There are only as many entries as there are large images => a linear
+    // search is fast enough.
+    EntryMap::iterator oldest = m_entries.end();
+    for (EntryMap::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+      if (it->first == keep)
+        continue;
+      if ((oldest == m_entries.end()) || (it->second.m_lastUse < oldest->second.m_lastUse))
+        oldest = it;
+    }
+    if (oldest == m_entries.end())
+      return;
+    m_memoryUsage -= MemoryUsage(oldest->second.m_size);
+    m_entries.erase(oldest);
+  }
+}
@@ -0,0 +1,170 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+  The definition of the class ScaledBitmapCache that keeps the rescaled
+  versions of the images in the worksheet.
+*/
+
+#ifndef SCALEDBITMAPCACHE_H
+#define SCALEDBITMAPCACHE_H
+
+#include <wx/wx.h>
+#include <wx/image.h>
+#include <wx/thread.h>
+#include <wx/msgqueue.h>
+#include "Image.h"
+#include <map>
+#include <vector>
+
+//! The amount of memory all scaled bitmaps may take together [bytes]
+#define SCALEDBITMAPCACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+/*! The rescaled versions of the images of ImgCells and SlideShows
+
+  Images that are larger than the canvas are drawn scaled down. Rescaling
+  them with a good quality is much too slow to be done on every paint. This
+  cache therefore keeps one scaled bitmap per image and only produces a new
+  one if the size the image is drawn with changes, which only happens on
+  resizing the window or zooming.
+
+  On the first request a cheap nearest-neighbour preview is returned while
+  a worker thread rescales the image with bicubic interpolation. When it is
+  done the cache sends a wxThreadEvent to its handler which has to call
+  TakeResults() and repaint the rectangles it returns.
+
+  If the scaled bitmaps together need more memory than the budget allows
+  the ones that haven't been drawn for the longest time are dropped.
+
+  All functions have to be called from the main thread.
+*/
+class ScaledBitmapCache
+{
+public:
+  //! Returns the cache all images share. It is created on the first call.
+  static ScaledBitmapCache *Get();
+
+  /*! Sets the event handler that is informed when a bitmap is ready
+
+    Starts the worker thread. NULL stops the worker thread: All bitmaps are
+    then rescaled with full quality immediately.
+
+    \param handler The handler that gets a wxThreadEvent with the id id
+    \param id      The id of these events
+  */
+  void SetHandler(wxEvtHandler *handler, int id);
+
+  /*! Returns the image source scaled to size
+
+    \param source  The image. Is identified by its address: It calls Forget()
+                   when it is deleted. Is only decoded if there is no
+                   scaled version of the right size.
+    \param size    The size the image is to be drawn with.
+    \param where   The rectangle the image is drawn to. Is returned by
+                   TakeResults() once the high-quality version is ready.
+    \param preview Is a quickly scaled version acceptable for now? Must be
+                   false for printing and exporting.
+
+    The reference is valid until the next call.
+  */
+  const wxBitmap &GetScaled(const Image *source, wxSize size,
+                            const wxRect &where, bool preview = true);
+  //! Drops the scaled version of source
+  void Forget(const Image *source);
+  /*! Stores the bitmaps the worker thread has finished
+
+    \return The rectangles the images that have been improved were drawn to.
+  */
+  std::vector<wxRect> TakeResults();
+
+  //! Sets the amount of memory all scaled bitmaps may take [bytes]
+  void SetBudget(size_t budget);
+  //! The memory all scaled bitmaps currently take [bytes]
+  size_t GetMemoryUsage() { return m_memoryUsage; }
+
+private:
+  //! A rescaling job for the worker thread
+  class Job
+  {
+  public:
+    //! The image the job belongs to. Is only used as a key.
+    const Image *m_source;
+    //! The serial number of the cache entry the job belongs to
+    unsigned long m_serial;
+    //! The image that is to be scaled; Is scaled in place.
+    wxImage m_image;
+    wxSize m_size;
+  };
+
+  //! The thread that does the bicubic rescaling
+  class Worker : public wxThread
+  {
+  public:
+    Worker(wxEvtHandler *handler, int id);
+    //! The jobs that wait for being done. A NULL job terminates the thread.
+    wxMessageQueue<Job *> m_jobs;
+    //! The jobs that have been done
+    wxMessageQueue<Job *> m_results;
+  protected:
+    virtual ExitCode Entry();
+  private:
+    wxEvtHandler *m_handler;
+    int m_id;
+  };
+
+  //! A scaled version of an image
+  class Entry
+  {
+  public:
+    wxBitmap m_bitmap;
+    wxSize m_size;
+    //! Has the bitmap been scaled with full quality?
+    bool m_highQuality;
+    //! Tells results for a deleted image apart from those for a new one at the same address
+    unsigned long m_serial;
+    //! Where the image has been drawn last
+    wxRect m_where;
+    unsigned long m_lastUse;
+  };
+
+  ScaledBitmapCache();
+
+  //! Rescales an image with full quality
+  static wxImage Rescale(const wxImage &image, wxSize size);
+  //! The memory a bitmap of this size takes [bytes]
+  static size_t MemoryUsage(wxSize size) { return (size_t) size.x * size.y * 4; }
+  //! Drops the bitmaps that haven't been used for the longest time until the budget is kept
+  void KeepBudget(const Image *keep);
+  //! Stops the worker thread and drops the jobs it hasn't finished
+  void StopWorker();
+
+  typedef std::map<const Image *, Entry> EntryMap;
+  EntryMap m_entries;
+  Worker *m_worker;
+  size_t m_budget;
+  size_t m_memoryUsage;
+  unsigned long m_nextSerial;
+  unsigned long m_useCounter;
+
+  //! The cache Get() returns
+  static ScaledBitmapCache *m_cache;
+};
+
+#endif // SCALEDBITMAPCACHE_H
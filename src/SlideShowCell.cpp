@@ -21,11 +21,11 @@
 
 #include "SlideShowCell.h"
 #include "ImgCell.h"
+#include "ScaledBitmapCache.h"
 
 #include <wx/file.h>
 #include <wx/filename.h>
 #include <wx/filesys.h>
-#include <wx/fs_mem.h>
 #include <wx/utils.h>
 #include <wx/clipbrd.h>
 #include <wx/config.h>
@@ -43,7 +43,7 @@ SlideShow::SlideShow(wxFileSystem *filesystem,int framerate) : MathCell()
 SlideShow::~SlideShow()
 {
   for (int i=0; i<m_size; i++)
-    delete m_bitmaps[i];
+    delete m_images[i];
   if (m_next != NULL)
     delete m_next;
 }
@@ -85,88 +85,54 @@ void SlideShow::LoadImages(wxArrayString images)
 {
   m_size = images.GetCount();
 
-  if (m_fileSystem) {
-    for (int i=0; i<m_size; i++)
-    {
-      bool loadedImage = false;
+  // Only the compressed data is read here: A frame is decoded when it is
+  // displayed for the first time.
+  for (int i=0; i<m_size; i++)
+  {
+    Image *image = NULL;
 
+    if (m_fileSystem) {
       wxFSFile *fsfile = m_fileSystem->OpenFile(images[i]);
       if (fsfile) { // open successful
-
-        wxInputStream *istream = fsfile->GetStream();
-        wxImage pngImage(*istream, wxBITMAP_TYPE_PNG);
-        if (pngImage.Ok())
-        {
-          loadedImage = true;
-          m_bitmaps.push_back(new wxBitmap(pngImage));
-        }
+        image = new Image(*fsfile->GetStream());
         delete fsfile;
       }
-
-      if (!loadedImage)
-      {
-        wxBitmap *bitmap = new wxBitmap;
-        bitmap->Create(400, 250);
-
-        wxString error = wxString::Format(_("Error %d"), i);
-
-        wxMemoryDC dc;
-        dc.SelectObject(*bitmap);
-
-        int width = 0, height = 0;
-        dc.GetTextExtent(error, &width, &height);
-        dc.DrawRectangle(0, 0, 400, 250);
-        dc.DrawLine(0, 0,   400, 250);
-        dc.DrawLine(0, 250, 400, 0);
-        dc.DrawText(error, 200 - width/2, 125 - height/2);
-
-        m_bitmaps.push_back(bitmap);
-      }
+    }
+    else if (wxFileExists(images[i]))
+    {
+      image = new Image(images[i]);
+      wxRemoveFile(images[i]);
     }
 
-    m_fileSystem = NULL;
-  }
-  else
-    for (int i=0; i<m_size; i++)
+    if ((image == NULL) || !image->IsOk())
     {
-      bool loadedImage = false;
-
-      if (wxFileExists(images[i]))
-      {
-        wxBitmap *bitmap = new wxBitmap;
-        if (bitmap->LoadFile(images[i], wxBITMAP_TYPE_PNG))
-        {
-          loadedImage = true;
-          m_bitmaps.push_back(bitmap);
-        }
-        else
-          delete bitmap;
-
-        wxRemoveFile(images[i]);
-      }
+      if (image != NULL)
+        delete image;
 
-      if (!loadedImage)
-      {
-        wxBitmap *bitmap = new wxBitmap;
-        bitmap->Create(400, 250);
+      wxBitmap bitmap;
+      bitmap.Create(400, 250);
 
-        wxString error = wxString::Format(_("Error %d"), i);
+      wxString error = wxString::Format(_("Error %d"), i);
 
-        wxMemoryDC dc;
-        dc.SelectObject(*bitmap);
+      wxMemoryDC dc;
+      dc.SelectObject(bitmap);
 
-        int width = 0, height = 0;
-        dc.GetTextExtent(error, &width, &height);
-        
-        dc.DrawRectangle(0, 0, 400, 250);
-        dc.DrawLine(0, 0,   400, 250);
-        dc.DrawLine(0, 250, 400, 0);
-        dc.DrawText(error, 200 - width/2, 125 - height/2);
+      int width = 0, height = 0;
+      dc.GetTextExtent(error, &width, &height);
 
-        m_bitmaps.push_back(bitmap);
-      }
+      dc.DrawRectangle(0, 0, 400, 250);
+      dc.DrawLine(0, 0,   400, 250);
+      dc.DrawLine(0, 250, 400, 0);
+      dc.DrawText(error, 200 - width/2, 125 - height/2);
+
+      dc.SelectObject(wxNullBitmap);
+      image = new Image(bitmap);
     }
 
+    m_images.push_back(image);
+  }
+
+  m_fileSystem = NULL;
   m_displayed = 0;
 }
 
@@ -175,11 +141,8 @@ MathCell* SlideShow::Copy()
   SlideShow* tmp = new SlideShow;
   CopyData(this, tmp);
 
-  for(int i=0;i<m_bitmaps.size();i++)
-  {
-    wxBitmap *image = new wxBitmap(*m_bitmaps[i]);
-    tmp->m_bitmaps.push_back(image);
-  }
+  for(int i=0;i<m_images.size();i++)
+    tmp->m_images.push_back(new Image(*m_images[i]));
 
   tmp->m_size = m_size;
   
@@ -189,10 +152,10 @@ MathCell* SlideShow::Copy()
 void SlideShow::Destroy()
 {
   for (int i=0; i<m_size; i++)
-    if (m_bitmaps[i] != NULL)
+    if (m_images[i] != NULL)
     {
-      delete m_bitmaps[i];
-      m_bitmaps[i] = NULL;
+      delete m_images[i];
+      m_images[i] = NULL;
     }
   m_next = NULL;
 }
@@ -208,10 +171,10 @@ void SlideShow::SetDisplayedIndex(int ind)
 void SlideShow::RecalculateWidths(CellParser& parser, int fontsize)
 {
   int height;
-  if (m_bitmaps[m_displayed] != NULL)
+  if (m_images[m_displayed] != NULL)
   {
-    height = m_bitmaps[m_displayed]->GetHeight();
-    m_width  = m_bitmaps[m_displayed]->GetWidth();
+    height = m_images[m_displayed]->GetHeight();
+    m_width  = m_images[m_displayed]->GetWidth();
   }
   else
   {
@@ -235,10 +198,10 @@ void SlideShow::RecalculateWidths(CellParser& parser, int fontsize)
 void SlideShow::RecalculateSize(CellParser& parser, int fontsize)
 {
   int width;
-  if (m_bitmaps[m_displayed] != NULL)
+  if (m_images[m_displayed] != NULL)
   {
-    m_height = m_bitmaps[m_displayed]->GetHeight();
-    width  = m_bitmaps[m_displayed]->GetWidth();
+    m_height = m_images[m_displayed]->GetHeight();
+    width  = m_images[m_displayed]->GetWidth();
   }
   else
   {
@@ -264,7 +227,7 @@ void SlideShow::RecalculateSize(CellParser& parser, int fontsize)
 
 void SlideShow::Draw(CellParser& parser, wxPoint point, int fontsize)
 {
-  if (DrawThisCell(parser, point) && m_bitmaps[m_displayed] != NULL)
+  if (DrawThisCell(parser, point) && m_images[m_displayed] != NULL)
   {
     wxDC& dc = parser.GetDC();
     wxMemoryDC bitmapDC;
@@ -273,25 +236,24 @@ void SlideShow::Draw(CellParser& parser, wxPoint point, int fontsize)
 
     dc.DrawRectangle(wxRect(point.x, point.y - m_center, m_width, m_height));
 
+    wxRect imageRect(point.x + m_imageBorderWidth, point.y - m_center + m_imageBorderWidth,
+                     m_width - 2 * m_imageBorderWidth, m_height - 2 * m_imageBorderWidth);
     bool rescale=false;
-    if (m_bitmaps[m_displayed] != NULL)
+    if (m_images[m_displayed] != NULL)
     {
-      if(m_bitmaps[m_displayed]->GetHeight() + 2 * m_imageBorderWidth != m_height)
+      if(m_images[m_displayed]->GetHeight() + 2 * m_imageBorderWidth != m_height)
         rescale=true;;
     }               
     
+    // Every frame keeps its rescaled bitmap until the size changes.
     if (rescale)
-    {
-      wxImage img = m_bitmaps[m_displayed]->ConvertToImage();
-      img.Rescale(m_width - 2 * m_imageBorderWidth,m_height - 2 * m_imageBorderWidth,wxIMAGE_QUALITY_BICUBIC);
-      
-      wxBitmap bmp = img;
-      bitmapDC.SelectObject(bmp);
-    }
+      bitmapDC.SelectObjectAsSource(
+        ScaledBitmapCache::Get()->GetScaled(m_images[m_displayed], imageRect.GetSize(),
+                                            imageRect, parser.PreviewImages()));
     else
-      bitmapDC.SelectObject(*m_bitmaps[m_displayed]);
+      bitmapDC.SelectObjectAsSource(m_images[m_displayed]->GetBitmap());
 
-    dc.Blit(point.x + m_imageBorderWidth, point.y - m_center + m_imageBorderWidth,m_width - 2 * m_imageBorderWidth,m_height - 2 * m_imageBorderWidth, &bitmapDC, 0, 0);
+    dc.Blit(imageRect.x, imageRect.y, imageRect.width, imageRect.height, &bitmapDC, 0, 0);
   }
   MathCell::Draw(parser, point, fontsize);
 }
@@ -311,12 +273,7 @@ wxString SlideShow::ToXML()
   wxString images;
 
   for (int i=0; i<m_size; i++) {
-    wxImage image = m_bitmaps[i]->ConvertToImage();
-    wxString basename = ImgCell::WXMXGetNewFileName();
-
-    // add to memory
-    wxMemoryFSHandler::AddFile(basename, image, wxBITMAP_TYPE_PNG);
-
+    wxString basename = ImgCell::WXMXAddImage(m_images[i]);
     images += basename + wxT(";");
   }
 
@@ -328,7 +285,7 @@ wxString SlideShow::ToXML()
 
 wxSize SlideShow::ToImageFile(wxString file)
 {
-  wxImage image = m_bitmaps[m_displayed]->ConvertToImage();
+  wxImage image = m_images[m_displayed]->ToImage();
 
   if(image.SaveFile(file, wxBITMAP_TYPE_PNG))
     return image.GetSize();
@@ -354,7 +311,7 @@ wxSize SlideShow::ToGif(wxString file)
   {
     wxFileName imgname(tmpdir, wxString::Format(wxT("wxm_anim%d.png"), i));
 
-    wxImage image = m_bitmaps[i]->ConvertToImage();
+    wxImage image = m_images[i]->ToImage();
     image.SaveFile(imgname.GetFullPath(), wxBITMAP_TYPE_PNG);
 
     // Saving an animation might need loads of time. Since we use this time
@@ -396,7 +353,7 @@ wxSize SlideShow::ToGif(wxString file)
   if(success)
   {
     if(m_size>0)
-      return m_bitmaps[1]->GetSize();
+      return m_images[1]->GetSize();
     else
     {
       wxSize retval;
@@ -416,7 +373,7 @@ bool SlideShow::CopyToClipboard()
 {
   if (wxTheClipboard->Open())
   {
-    bool res = wxTheClipboard->SetData(new wxBitmapDataObject(*m_bitmaps[m_displayed]));
+    bool res = wxTheClipboard->SetData(new wxBitmapDataObject(m_images[m_displayed]->GetBitmap()));
     wxTheClipboard->Close();
     return res;
   }
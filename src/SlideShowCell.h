@@ -23,6 +23,7 @@
 #define SLIDESHOWCELL_H
 
 #include "MathCell.h"
+#include "Image.h"
 #include <wx/image.h>
 
 #include <wx/filesys.h>
@@ -51,7 +52,7 @@ public:
     *first = *last = this;
   }
   int GetDisplayedIndex() { return m_displayed; }
-  wxImage GetBitmap(int n) { return m_bitmaps[n]->ConvertToImage(); }
+  wxImage GetBitmap(int n) { return m_images[n]->ToImage(); }
   void SetDisplayedIndex(int ind);
   int Length() { return m_size; }
   //! Exports the image the slideshow currently displays
@@ -80,7 +81,8 @@ protected:
   int m_size;
   int m_displayed;
   wxFileSystem *m_fileSystem;
-  vector<wxBitmap*> m_bitmaps;
+  //! The frames. Each of them is only decoded when it is displayed.
+  vector<Image *> m_images;
   void RecalculateSize(CellParser& parser, int fontsize);
   void RecalculateWidths(CellParser& parser, int fontsize);
   void Draw(CellParser& parser, wxPoint point, int fontsize);
@@ -0,0 +1,140 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2004-2015 Andrej Vodopivec <andrej.vodopivec@gmail.com>
+//            (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+  The definition of the style sheet all CellParsers share.
+*/
+
+#ifndef STYLESHEET_H
+#define STYLESHEET_H
+
+#include <wx/wx.h>
+#include <wx/object.h>
+#include <map>
+
+#include "TextStyle.h"
+#include "TextExtentCache.h"
+
+/*! The fonts and colors the worksheet is drawn with
+
+  Reading all styles from the configuration takes about a hundred lookups.
+  Since a CellParser is created for every paint and every layout operation
+  the configuration is read only once into a style sheet that all
+  CellParsers share. Style sheets are never modified: Reload() creates a new
+  one while CellParsers that still exist keep the old one alive through
+  their reference.
+*/
+class StyleSheet : public wxRefCounter
+{
+public:
+  //! Returns the current style sheet. It is created on the first call.
+  static wxObjectDataPtr<StyleSheet> Get();
+  //! Re-reads the configuration. Is to be called whenever it has changed.
+  static void Reload();
+
+  //! Is incremented every time a new style sheet is created.
+  unsigned long GetVersion() const { return m_version; }
+  const style &GetStyle(int st) const { return m_styles[st]; }
+  const wxString &GetFontName() const { return m_fontName; }
+  const wxString &GetMathFontName() const { return m_mathFontName; }
+  int GetDefaultFontSize() const { return m_defaultFontSize; }
+  int GetMathFontSize() const { return m_mathFontSize; }
+  wxFontEncoding GetFontEncoding() const { return m_fontEncoding; }
+  bool CheckTeXFonts() const { return m_TeXFonts; }
+  bool CheckKeepPercent() const { return m_keepPercent; }
+  const wxString &GetTeXCMRI() const { return m_fontCMRI; }
+  const wxString &GetTeXCMSY() const { return m_fontCMSY; }
+  const wxString &GetTeXCMEX() const { return m_fontCMEX; }
+  const wxString &GetTeXCMMI() const { return m_fontCMMI; }
+  const wxString &GetTeXCMTI() const { return m_fontCMTI; }
+
+  /*! Returns a font of the modern family
+
+    Every combination of the parameters is converted to a wxFont only once
+    per style sheet. The reference is valid until the next call.
+  */
+  const wxFont &GetFont(int size, wxFontStyle style, wxFontWeight weight,
+                        bool underlined, const wxString &faceName,
+                        wxFontEncoding encoding = wxFONTENCODING_DEFAULT) const;
+
+  /*! Measures text in the font dc currently uses
+
+    If that font has been created by GetFont() the result is cached.
+  */
+  void GetTextExtent(wxDC &dc, const wxString &text, wxCoord *width, wxCoord *height,
+                     wxCoord *descent = NULL) const;
+  const TextExtentCache &GetTextExtentCache() const { return m_textExtents; }
+
+private:
+  //! The key the fonts in m_fonts are indexed by
+  struct FontKey
+  {
+    int size;
+    //! Style, weight, underlining and encoding
+    int flags;
+    //! The index of the face name in m_faceNames
+    int face;
+    bool operator<(const FontKey &other) const
+      {
+        if (size != other.size)
+          return size < other.size;
+        if (flags != other.flags)
+          return flags < other.flags;
+        return face < other.face;
+      }
+  };
+  struct CachedFont
+  {
+    wxFont font;
+    //! The number the font is known by in m_textExtents
+    int id;
+  };
+  //! The fonts GetFont() has created so far
+  mutable std::map<FontKey, CachedFont> m_fonts;
+  //! Finds the id of a font in m_fonts by the data all copies of it share
+  mutable std::map<const wxObjectRefData *, int> m_fontIds;
+  //! The id the next font that is created gets
+  mutable int m_nextFontId;
+  mutable TextExtentCache m_textExtents;
+  //! All face names GetFont() has been asked for
+  mutable wxArrayString m_faceNames;
+
+  //! Reads the configuration
+  StyleSheet();
+  void ReadStyle();
+
+  //! The style sheet Get() returns
+  static StyleSheet *m_current;
+  //! The version of the newest style sheet
+  static unsigned long m_lastVersion;
+
+  unsigned long m_version;
+  wxString m_fontName;
+  int m_defaultFontSize, m_mathFontSize;
+  wxString m_mathFontName;
+  bool m_TeXFonts;
+  bool m_keepPercent;
+  wxString m_fontCMRI, m_fontCMSY, m_fontCMEX, m_fontCMMI, m_fontCMTI;
+  wxFontEncoding m_fontEncoding;
+  style m_styles[STYLE_NUM];
+};
+
+#endif // STYLESHEET_H
@@ -129,8 +129,8 @@ void SubCell::Draw(CellParser& parser, wxPoint point, int fontsize)
 
 wxString SubCell::ToString()
 {
-  if (m_altCopyText != wxEmptyString) {
-    return m_altCopyText;
+  if (m_altCopyText != NULL) {
+    return *m_altCopyText;
   }
 
   wxString s;
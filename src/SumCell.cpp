@@ -131,9 +131,9 @@ void SumCell::RecalculateWidths(CellParser& parser, int fontsize)
   {
     wxDC& dc = parser.GetDC();
     int fontsize1 = (int) ((fontsize * 1.5 * scale + 0.5));
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-    		          wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
-                      parser.GetTeXCMEX()));
+    dc.SetFont(parser.GetFont(fontsize1,
+                              wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
+                              parser.GetTeXCMEX()));
     dc.GetTextExtent(m_sumStyle == SM_SUM ? wxT(SUM_SIGN) : wxT(PROD_SIGN), &m_signWidth, &m_signSize);
     m_signWCenter = m_signWidth / 2;
     m_signTop = (2* m_signSize) / 5;
@@ -182,9 +182,9 @@ void SumCell::Draw(CellParser& parser, wxPoint point, int fontsize)
     {
       SetForeground(parser);
       int fontsize1 = (int) ((fontsize * 1.5 * scale + 0.5));
-      dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-    		            wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
-                        parser.GetTeXCMEX()));
+      dc.SetFont(parser.GetFont(fontsize1,
+                                wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
+                                parser.GetTeXCMEX()));
       dc.DrawText(m_sumStyle == SM_SUM ? wxT(SUM_SIGN) : wxT(PROD_SIGN),
                   sign.x + m_signWCenter - m_signWidth / 2,
                   sign.y - m_signTop);
@@ -22,12 +22,172 @@
 #include "TextCell.h"
 #include "Setup.h"
 
+//! The fonts the symbols of a TextCell are drawn with
+static const wxString s_symbolFont(wxT("Symbol"));
+static const wxString s_jsMathRomanFont(wxT("jsMath-cmr10"));
+static const wxString s_jsMathItalicFont(wxT("jsMath-cmmi10"));
+static const wxString s_jsMathSymbolFont(wxT("jsMath-cmsy10"));
+
+/*! A text that is displayed as a symbol
+
+  The tables below are sorted by m_name so they can be searched by bisection.
+*/
+class TextCellSymbol
+{
+public:
+  wxString m_name;
+  //! The symbol in Unicode or, for ANSI builds on Windows, in the Symbol font
+  wxString m_alt;
+  //! The symbol in the jsMath fonts
+  wxString m_altJs;
+  //! The jsMath font m_altJs is to be displayed with
+  const wxString *m_texFont;
+  //! Is m_alt only to be used if the % of maxima's constants is hidden?
+  bool m_onlyWithoutPercent;
+};
+
+//! Selects the version of a symbol the current platform can display
+#if wxUSE_UNICODE
+#define SYMBOL(unicode, symbolFont) wxT(unicode)
+#elif defined __WXMSW__
+#define SYMBOL(unicode, symbolFont) wxT(symbolFont)
+#else
+#define SYMBOL(unicode, symbolFont) wxT("")
+#endif
+
+//! Like SYMBOL() for the unicode characters the fonts on Windows lack
+#if wxUSE_UNICODE && defined __WXMSW__
+#define SYMBOL_NOT_MSW(unicode, symbolFont) wxT("")
+#else
+#define SYMBOL_NOT_MSW(unicode, symbolFont) SYMBOL(unicode, symbolFont)
+#endif
+
+//! The greek letters, with or without the leading %
+static const TextCellSymbol s_greekSymbols[] = {
+  {wxT("Alpha"), SYMBOL("\x0391", "\x41"), wxT("A"), &s_jsMathItalicFont, false},
+  {wxT("Beta"), SYMBOL("\x0392", "\x42"), wxT("B"), &s_jsMathItalicFont, false},
+  {wxT("Chi"), SYMBOL("\x03A7", "\x43"), wxT("X"), &s_jsMathItalicFont, false},
+  {wxT("Delta"), SYMBOL("\x0394", "\x44"), wxT("\xC1"), &s_jsMathItalicFont, false},
+  {wxT("Epsilon"), SYMBOL("\x0395", "\x45"), wxT("E"), &s_jsMathItalicFont, false},
+  {wxT("Eta"), SYMBOL("\x0397", "\x48"), wxT("H"), &s_jsMathItalicFont, false},
+  {wxT("Gamma"), SYMBOL("\x0393", "\x47"), wxT("\xC0"), &s_jsMathItalicFont, false},
+  {wxT("Iota"), SYMBOL("\x0399", "\x49"), wxT("I"), &s_jsMathItalicFont, false},
+  {wxT("Kappa"), SYMBOL("\x039A", "\x4B"), wxT("K"), &s_jsMathItalicFont, false},
+  {wxT("Lambda"), SYMBOL("\x039B", "\x4C"), wxT("\xC3"), &s_jsMathItalicFont, false},
+  {wxT("Mu"), SYMBOL("\x039C", "\x4D"), wxT("M"), &s_jsMathItalicFont, false},
+  {wxT("Nu"), SYMBOL("\x039D", "\x4E"), wxT("N"), &s_jsMathItalicFont, false},
+  {wxT("Omega"), SYMBOL("\x03A9", "\x57"), wxT("\xCA"), &s_jsMathItalicFont, false},
+  {wxT("Omicron"), SYMBOL("\x039F", "\x4F"), wxT("O"), &s_jsMathItalicFont, false},
+  {wxT("Phi"), SYMBOL("\x03A6", "\x46"), wxT("\xC8"), &s_jsMathItalicFont, false},
+  {wxT("Pi"), SYMBOL("\x03A0", "\x50"), wxT("\xC5"), &s_jsMathItalicFont, false},
+  {wxT("Psi"), SYMBOL("\x03A8", "\x59"), wxT("\xC9"), &s_jsMathItalicFont, false},
+  {wxT("Rho"), SYMBOL("\x03A1", "\x52"), wxT("P"), &s_jsMathItalicFont, false},
+  {wxT("Sigma"), SYMBOL("\x03A3", "\x53"), wxT("\xC6"), &s_jsMathItalicFont, false},
+  {wxT("Tau"), SYMBOL("\x03A4", "\x54"), wxT("T"), &s_jsMathItalicFont, false},
+  {wxT("Theta"), SYMBOL("\x0398", "\x51"), wxT("\xC2"), &s_jsMathItalicFont, false},
+  {wxT("Upsilon"), SYMBOL("\x03A5", "\x55"), wxT("Y"), &s_jsMathItalicFont, false},
+  {wxT("Xi"), SYMBOL("\x039E", "\x58"), wxT("\xC4"), &s_jsMathItalicFont, false},
+  {wxT("Zeta"), SYMBOL("\x0396", "\x5A"), wxT("Z"), &s_jsMathItalicFont, false},
+  {wxT("alpha"), SYMBOL("\x03B1", "\x61"), wxT("\xCB"), &s_jsMathItalicFont, false},
+  {wxT("beta"), SYMBOL("\x03B2", "\x62"), wxT("\xCC"), &s_jsMathItalicFont, false},
+  {wxT("chi"), SYMBOL("\x03C7", "\x63"), wxT("\xDF"), &s_jsMathItalicFont, false},
+  {wxT("delta"), SYMBOL("\x03B4", "\x64"), wxT("\xCE"), &s_jsMathItalicFont, false},
+  {wxT("epsilon"), SYMBOL("\x03B5", "\x65"), wxT("\xCF"), &s_jsMathItalicFont, false},
+  {wxT("eta"), SYMBOL("\x03B7", "\x68"), wxT("\xD1"), &s_jsMathItalicFont, false},
+  {wxT("gamma"), SYMBOL("\x03B3", "\x67"), wxT("\xCD"), &s_jsMathItalicFont, false},
+  {wxT("iota"), SYMBOL("\x03B9", "\x69"), wxT("\xD3"), &s_jsMathItalicFont, false},
+  {wxT("kappa"), SYMBOL("\x03BA", "\x6B"), wxT("\xD4"), &s_jsMathItalicFont, false},
+  {wxT("lambda"), SYMBOL("\x03BB", "\x6C"), wxT("\xD5"), &s_jsMathItalicFont, false},
+  {wxT("mu"), SYMBOL("\x03BC", "\x6D"), wxT("\xD6"), &s_jsMathItalicFont, false},
+  {wxT("nu"), SYMBOL("\x03BD", "\x6E"), wxT("\xB7"), &s_jsMathItalicFont, false},
+  {wxT("omega"), SYMBOL("\x03C9", "\x77"), wxT("\x21"), &s_jsMathItalicFont, false},
+  {wxT("omicron"), SYMBOL("\x03BF", "\x6F"), wxT("o"), &s_jsMathItalicFont, false},
+  {wxT("phi"), SYMBOL("\x03C6", "\x66"), wxT("\x27"), &s_jsMathItalicFont, false},
+  {wxT("pi"), SYMBOL("\x03C0", "\x70"), wxT("\xD9"), &s_jsMathItalicFont, false},
+  {wxT("psi"), SYMBOL("\x03C8", "\x79"), wxT("\xEF"), &s_jsMathItalicFont, false},
+  {wxT("rho"), SYMBOL("\x03C1", "\x72"), wxT("\xDA"), &s_jsMathItalicFont, false},
+  {wxT("sigma"), SYMBOL("\x03C3", "\x73"), wxT("\xDB"), &s_jsMathItalicFont, false},
+  {wxT("tau"), SYMBOL("\x03C4", "\x74"), wxT("\xDC"), &s_jsMathItalicFont, false},
+  {wxT("theta"), SYMBOL("\x03B8", "\x71"), wxT("\xD2"), &s_jsMathItalicFont, false},
+  {wxT("upsilon"), SYMBOL("\x03C5", "\x75"), wxT("\xB5"), &s_jsMathItalicFont, false},
+  {wxT("xi"), SYMBOL("\x03BE", "\x78"), wxT("\xD8"), &s_jsMathItalicFont, false},
+  {wxT("zeta"), SYMBOL("\x03B6", "\x7A"), wxT("\xB0"), &s_jsMathItalicFont, false},
+};
+
+//! Greek constants maxima doesn't prefix with a %
+static const TextCellSymbol s_greekExceptions[] = {
+  {wxT("gamma"), SYMBOL("\x0393", "\x47"), wxT("\xC0"), &s_jsMathItalicFont, false},
+  {wxT("psi"), SYMBOL("\x03A8", "\x59"), wxT("\xC9"), &s_jsMathItalicFont, false}
+};
+
+//! The symbols the texts of all other styles are displayed as
+static const TextCellSymbol s_symbols[] = {
+  {wxT(" and "), SYMBOL_NOT_MSW(" \x22C0 ", "\xD9"), wxT(""), NULL, false},
+  {wxT(" equiv "), SYMBOL_NOT_MSW(" \x21D4 ", "\xDB"), wxT(""), NULL, false},
+  {wxT(" implies "), SYMBOL_NOT_MSW(" \x21D2 ", "\xDE"), wxT(""), NULL, false},
+  {wxT(" nand "), SYMBOL_NOT_MSW(" \x22BC ", "\xAD"), wxT(""), NULL, false},
+  {wxT(" nor "), SYMBOL_NOT_MSW(" \x22BD ", "\xAF"), wxT(""), NULL, false},
+  {wxT(" or "), SYMBOL_NOT_MSW(" \x22C1 ", "\xDA"), wxT(""), NULL, false},
+  {wxT(" xor "), SYMBOL_NOT_MSW(" \x22BB ", "\xC5"), wxT(""), NULL, false},
+  {wxT("%e"), SYMBOL("e", "e"), wxT(""), NULL, true},
+  {wxT("%i"), SYMBOL("i", "i"), wxT(""), NULL, true},
+  {wxT("%pi"), SYMBOL("\x03C0", "\x70"), wxT("\xD9"), &s_jsMathItalicFont, false},
+  {wxT("+"), SYMBOL("+", ""), wxT("+"), &s_jsMathRomanFont, false},
+  {wxT("->"), SYMBOL_NOT_MSW("\x2192", "\xAE"), wxT("\x21"), &s_jsMathSymbolFont, false},
+  {wxT("<="), SYMBOL("\x2264", "\xA3"), wxT("\xD4"), &s_jsMathSymbolFont, false},
+  {wxT("="), SYMBOL("=", ""), wxT("="), &s_jsMathRomanFont, false},
+  {wxT(">="), SYMBOL("\x2265", "\xB3"), wxT("\xD5"), &s_jsMathSymbolFont, false},
+  {wxT("inf"), SYMBOL("\x221E", "\xA5"), wxT("\x31"), &s_jsMathSymbolFont, false},
+  {wxT("not"), SYMBOL_NOT_MSW("\x00AC", "\xD8"), wxT(""), NULL, false}
+};
+
+//! Searches the part of text that starts at start in a sorted table
+static const TextCellSymbol *LookUpSymbol(const TextCellSymbol *table, size_t count,
+                                          const wxString &text, size_t start)
+{
+  size_t low = 0, high = count;
+  while (low < high)
+  {
+    size_t middle = (low + high) / 2;
+    int cmp = text.compare(start, wxString::npos, table[middle].m_name);
+    if (cmp == 0)
+      return &table[middle];
+    if (cmp < 0)
+      high = middle;
+    else
+      low = middle + 1;
+  }
+  return NULL;
+}
+
+//! Returns the symbol a text of this style is displayed as or NULL
+static const TextCellSymbol *FindSymbol(const wxString &text, int style)
+{
+  if (style == TS_DEFAULT)
+    return NULL;
+
+  if (style == TS_GREEK_CONSTANT)
+  {
+    const TextCellSymbol *symbol =
+      LookUpSymbol(s_greekExceptions, WXSIZEOF(s_greekExceptions), text, 0);
+    if (symbol != NULL)
+      return symbol;
+    return LookUpSymbol(s_greekSymbols, WXSIZEOF(s_greekSymbols), text,
+                        text.StartsWith(wxT("%")) ? 1 : 0);
+  }
+
+  return LookUpSymbol(s_symbols, WXSIZEOF(s_symbols), text, 0);
+}
+
 TextCell::TextCell() : MathCell()
 {
   m_text = wxEmptyString;
   m_fontSize = -1;
   m_highlight = false;
-  m_altJs = m_alt = false;
+  m_altText = m_altJsText = NULL;
+  m_fontname = m_texFontname = NULL;
+  m_symbol = NULL;
+  m_symbolStyle = -1;
 }
 
 TextCell::TextCell(wxString text) : MathCell()
@@ -35,7 +195,10 @@ TextCell::TextCell(wxString text) : MathCell()
   m_text = text;
   m_text.Replace(wxT("\n"), wxEmptyString);
   m_highlight = false;
-  m_altJs = m_alt = false;
+  m_altText = m_altJsText = NULL;
+  m_fontname = m_texFontname = NULL;
+  m_symbol = NULL;
+  m_symbolStyle = -1;
 }
 
 TextCell::~TextCell()
@@ -49,7 +212,9 @@ void TextCell::SetValue(wxString text)
   m_text = text;
   m_width = -1;
   m_text.Replace(wxT("\n"), wxEmptyString);
-  m_alt = m_altJs = false;
+  m_altText = m_altJsText = NULL;
+  m_symbol = NULL;
+  m_symbolStyle = -1;
 }
 
 MathCell* TextCell::Copy()
@@ -79,7 +244,6 @@ void TextCell::RecalculateWidths(CellParser& parser, int fontsize)
   {
     m_fontSize = fontsize;
 
-    wxDC& dc = parser.GetDC();
     double scale = parser.GetScale();
     SetFont(parser, fontsize);
 
@@ -88,48 +252,54 @@ void TextCell::RecalculateWidths(CellParser& parser, int fontsize)
     if ((m_textStyle == TS_LABEL) || (m_textStyle == TS_MAIN_PROMPT)) {
 	  // Check for output annotations (/R/ for CRE and /T/ for Taylor expressions)
       if (m_text.Right(2) != wxT("/ "))
-        dc.GetTextExtent(wxT("(\%oXXX)"), &m_width, &m_height);
+        parser.GetTextExtent(wxT("(\%oXXX)"), &m_width, &m_height);
       else
-        dc.GetTextExtent(wxT("(\%oXXX)/R/"), &m_width, &m_height);
+        parser.GetTextExtent(wxT("(\%oXXX)/R/"), &m_width, &m_height);
       m_fontSizeLabel = m_fontSize;
-      dc.GetTextExtent(m_text, &m_labelWidth, &m_labelHeight);
-      while (m_labelWidth >= m_width) {
-        int fontsize1 = (int) (((double) --m_fontSizeLabel) * scale + 0.5);
-        dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-              parser.IsItalic(m_textStyle),
-              parser.IsBold(m_textStyle),
-              false, //parser.IsUnderlined(m_textStyle),
-              parser.GetFontName(m_textStyle),
-              parser.GetFontEncoding()));
-        dc.GetTextExtent(m_text, &m_labelWidth, &m_labelHeight);
+      parser.GetTextExtent(m_text, &m_labelWidth, &m_labelHeight);
+      if (m_labelWidth >= m_width)
+      {
+        // The width of a text is nearly proportional to the font size =>
+        // we can calculate which size will fit instead of shrinking the
+        // font one step at a time.
+        int fitSize = (int) ((double) m_fontSize * (double) m_width / (double) m_labelWidth);
+        m_fontSizeLabel = MAX(MIN(fitSize, m_fontSize - 1), 1);
+        SetFont(parser, m_fontSizeLabel);
+        parser.GetTextExtent(m_text, &m_labelWidth, &m_labelHeight);
+        // Rounding might have left the label a little too wide.
+        while ((m_labelWidth >= m_width) && (m_fontSizeLabel > 1))
+        {
+          SetFont(parser, --m_fontSizeLabel);
+          parser.GetTextExtent(m_text, &m_labelWidth, &m_labelHeight);
+        }
       }
     }
 
     /// Check if we are using jsMath and have jsMath character
-    else if (m_altJs && parser.CheckTeXFonts())
+    else if ((m_altJsText != NULL) && parser.CheckTeXFonts())
     {
-      dc.GetTextExtent(m_altJsText, &m_width, &m_height);
+      parser.GetTextExtent(*m_altJsText, &m_width, &m_height);
 
-      if (m_texFontname == wxT("jsMath-cmsy10"))
+      if (m_texFontname == &s_jsMathSymbolFont)
         m_height = m_height / 2;
     }
 
     /// We are using a special symbol
-    else if (m_alt)
+    else if (m_altText != NULL)
     {
-      dc.GetTextExtent(m_altText, &m_width, &m_height);
+      parser.GetTextExtent(*m_altText, &m_width, &m_height);
     }
 
     /// Empty string has height of X
     else if (m_text == wxEmptyString)
     {
-      dc.GetTextExtent(wxT("X"), &m_width, &m_height);
+      parser.GetTextExtent(wxT("X"), &m_width, &m_height);
       m_width = 0;
     }
 
     /// This is the default.
     else
-      dc.GetTextExtent(m_text, &m_width, &m_height);
+      parser.GetTextExtent(m_text, &m_width, &m_height);
 
     m_width = m_width + 2 * SCALE_PX(MC_TEXT_PADDING, scale);
     m_height = m_height + 2 * SCALE_PX(MC_TEXT_PADDING, scale);
@@ -169,14 +339,14 @@ void TextCell::Draw(CellParser& parser, wxPoint point, int fontsize)
     }
 
     /// Check if we are using jsMath and have jsMath character
-    else if (m_altJs && parser.CheckTeXFonts())
-      dc.DrawText(m_altJsText,
+    else if ((m_altJsText != NULL) && parser.CheckTeXFonts())
+      dc.DrawText(*m_altJsText,
                   point.x + SCALE_PX(MC_TEXT_PADDING, scale),
                   point.y - m_realCenter + SCALE_PX(MC_TEXT_PADDING, scale));
 
     /// We are using a special symbol
-    else if (m_alt)
-      dc.DrawText(m_altText,
+    else if (m_altText != NULL)
+      dc.DrawText(*m_altText,
                   point.x + SCALE_PX(MC_TEXT_PADDING, scale),
                   point.y - m_realCenter + SCALE_PX(MC_TEXT_PADDING, scale));
 
@@ -230,24 +400,24 @@ void TextCell::SetFont(CellParser& parser, int fontsize)
   fontsize1 = MAX(fontsize1, 1);
 
   // Use jsMath
-  if (m_altJs && parser.CheckTeXFonts())
+  if ((m_altJsText != NULL) && parser.CheckTeXFonts())
   {
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      wxFONTSTYLE_NORMAL,
-                      parser.IsBold(m_textStyle),
-                      parser.IsUnderlined(m_textStyle),
-                      m_texFontname));
+    dc.SetFont(parser.GetFont(fontsize1,
+                              wxFONTSTYLE_NORMAL,
+                              parser.IsBold(m_textStyle),
+                              parser.IsUnderlined(m_textStyle),
+                              *m_texFontname));
   }
 
   // We have an alternative symbol
-  else if (m_alt)
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      wxFONTSTYLE_NORMAL,
-                      parser.IsBold(m_textStyle),
-                      false,
-                      m_fontname != wxEmptyString ?
-                          m_fontname : parser.GetFontName(m_textStyle),
-                      parser.GetFontEncoding()));
+  else if (m_altText != NULL)
+    dc.SetFont(parser.GetFont(fontsize1,
+                              wxFONTSTYLE_NORMAL,
+                              parser.IsBold(m_textStyle),
+                              false,
+                              m_fontname != NULL ?
+                                  *m_fontname : parser.GetFontName(m_textStyle),
+                              parser.GetFontEncoding()));
 
   // Titles, sections, subsections... - don't underline
   else if ((m_textStyle == TS_TITLE) ||
@@ -255,21 +425,21 @@ void TextCell::SetFont(CellParser& parser, int fontsize)
            (m_textStyle == TS_SUBSECTION) ||
            (m_textStyle == TS_SUBSUBSECTION)
     )
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      parser.IsItalic(m_textStyle),
-                      parser.IsBold(m_textStyle),
-                      false,
-                      parser.GetFontName(m_textStyle),
-                      parser.GetFontEncoding()));
+    dc.SetFont(parser.GetFont(fontsize1,
+                              parser.IsItalic(m_textStyle),
+                              parser.IsBold(m_textStyle),
+                              false,
+                              parser.GetFontName(m_textStyle),
+                              parser.GetFontEncoding()));
 
   // Default
   else
-    dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
-                      parser.IsItalic(m_textStyle),
-                      parser.IsBold(m_textStyle),
-                      parser.IsUnderlined(m_textStyle),
-                      parser.GetFontName(m_textStyle),
-                      parser.GetFontEncoding()));
+    dc.SetFont(parser.GetFont(fontsize1,
+                              parser.IsItalic(m_textStyle),
+                              parser.IsBold(m_textStyle),
+                              parser.IsUnderlined(m_textStyle),
+                              parser.GetFontName(m_textStyle),
+                              parser.GetFontEncoding()));
 }
 
 bool TextCell::IsOperator()
@@ -286,8 +456,8 @@ bool TextCell::IsOperator()
 wxString TextCell::ToString()
 {
   wxString text;
-  if (m_altCopyText != wxEmptyString)
-    text = m_altCopyText;
+  if (m_altCopyText != NULL)
+    text = *m_altCopyText;
   else {
     text = m_text;
 #if wxUSE_UNICODE
@@ -488,521 +658,30 @@ bool TextCell::IsShortNum()
 
 void TextCell::SetAltText(CellParser& parser)
 {
-  m_altJs = m_alt = false;
-  if (m_textStyle == TS_DEFAULT)
-    return ;
-
-  /// Greek characters are defined in jsMath, Windows and Unicode
-  if (m_textStyle == TS_GREEK_CONSTANT)
+  // The symbol only has to be looked up again if the text or its style has changed.
+  if (m_symbolStyle != m_textStyle)
   {
-    m_altJs = true;
-    m_altJsText = GetGreekStringTeX();
-    m_texFontname = wxT("jsMath-cmmi10");
-
-#if wxUSE_UNICODE
-    m_alt = true;
-    m_altText = GetGreekStringUnicode();
-#elif defined __WXMSW__
-    m_alt = true;
-    m_altText = GetGreekStringSymbol();
-    m_fontname = wxT("Symbol");
-#endif
-  }
-
-  /// Check for other symbols
-  else {
-    m_altJsText = GetSymbolTeX();
-    if (m_altJsText != wxEmptyString)
-    {
-      if (m_text == wxT("+") || m_text == wxT("="))
-        m_texFontname = wxT("jsMath-cmr10");
-      else if (m_text == wxT("%pi"))
-        m_texFontname = wxT("jsMath-cmmi10");
-      else
-        m_texFontname = wxT("jsMath-cmsy10");
-      m_altJs = true;
-    }
-#if wxUSE_UNICODE
-    m_altText = GetSymbolUnicode(parser.CheckKeepPercent());
-    if (m_altText != wxEmptyString)
-      m_alt = true;
-#elif defined __WXMSW__
-    m_altText = GetSymbolSymbol(parser.CheckKeepPercent());
-    if (m_altText != wxEmptyString)
-    {
-      m_alt = true;
-      m_fontname = wxT("Symbol");
-    }
-#endif
-  }
-}
-
-#if wxUSE_UNICODE
-
-wxString TextCell::GetGreekStringUnicode()
-{
-  wxString txt(m_text);
-
-  if (txt == wxT("gamma"))
-    return wxString(L"\x0393");
-  else if (txt == wxT("psi"))
-    return wxString(L"\x03A8");
-
-  if (txt[0] != '%')
-    txt = wxT("%") + txt;
-
-  if (txt == wxT("%alpha"))
-    return wxString(L"\x03B1");
-  else if (txt == wxT("%beta"))
-    return wxString(L"\x03B2");
-  else if (txt == wxT("%gamma"))
-    return wxString(L"\x03B3");
-  else if (txt == wxT("%delta"))
-    return wxString(L"\x03B4");
-  else if (txt == wxT("%epsilon"))
-    return wxString(L"\x03B5");
-  else if (txt == wxT("%zeta"))
-    return wxString(L"\x03B6");
-  else if (txt == wxT("%eta"))
-    return wxString(L"\x03B7");
-  else if (txt == wxT("%theta"))
-    return wxString(L"\x03B8");
-  else if (txt == wxT("%iota"))
-    return wxString(L"\x03B9");
-  else if (txt == wxT("%kappa"))
-    return wxString(L"\x03BA");
-  else if (txt == wxT("%lambda"))
-    return wxString(L"\x03BB");
-  else if (txt == wxT("%mu"))
-    return wxString(L"\x03BC");
-  else if (txt == wxT("%nu"))
-    return wxString(L"\x03BD");
-  else if (txt == wxT("%xi"))
-    return wxString(L"\x03BE");
-  else if (txt == wxT("%omicron"))
-    return wxString(L"\x03BF");
-  else if (txt == wxT("%pi"))
-    return wxString(L"\x03C0");
-  else if (txt == wxT("%rho"))
-    return wxString(L"\x03C1");
-  else if (txt == wxT("%sigma"))
-    return wxString(L"\x03C3");
-  else if (txt == wxT("%tau"))
-    return wxString(L"\x03C4");
-  else if (txt == wxT("%upsilon"))
-    return wxString(L"\x03C5");
-  else if (txt == wxT("%phi"))
-    return wxString(L"\x03C6");
-  else if (txt == wxT("%chi"))
-    return wxString(L"\x03C7");
-  else if (txt == wxT("%psi"))
-    return wxString(L"\x03C8");
-  else if (txt == wxT("%omega"))
-    return wxString(L"\x03C9");
-  else if (txt == wxT("%Alpha"))
-    return wxString(L"\x0391");
-  else if (txt == wxT("%Beta"))
-    return wxString(L"\x0392");
-  else if (txt == wxT("%Gamma"))
-    return wxString(L"\x0393");
-  else if (txt == wxT("%Delta"))
-    return wxString(L"\x0394");
-  else if (txt == wxT("%Epsilon"))
-    return wxString(L"\x0395");
-  else if (txt == wxT("%Zeta"))
-    return wxString(L"\x0396");
-  else if (txt == wxT("%Eta"))
-    return wxString(L"\x0397");
-  else if (txt == wxT("%Theta"))
-    return wxString(L"\x0398");
-  else if (txt == wxT("%Iota"))
-    return wxString(L"\x0399");
-  else if (txt == wxT("%Kappa"))
-    return wxString(L"\x039A");
-  else if (txt == wxT("%Lambda"))
-    return wxString(L"\x039B");
-  else if (txt == wxT("%Mu"))
-    return wxString(L"\x039C");
-  else if (txt == wxT("%Nu"))
-    return wxString(L"\x039D");
-  else if (txt == wxT("%Xi"))
-    return wxString(L"\x039E");
-  else if (txt == wxT("%Omicron"))
-    return wxString(L"\x039F");
-  else if (txt == wxT("%Pi"))
-    return wxString(L"\x03A0");
-  else if (txt == wxT("%Rho"))
-    return wxString(L"\x03A1");
-  else if (txt == wxT("%Sigma"))
-    return wxString(L"\x03A3");
-  else if (txt == wxT("%Tau"))
-    return wxString(L"\x03A4");
-  else if (txt == wxT("%Upsilon"))
-    return wxString(L"\x03A5");
-  else if (txt == wxT("%Phi"))
-    return wxString(L"\x03A6");
-  else if (txt == wxT("%Chi"))
-    return wxString(L"\x03A7");
-  else if (txt == wxT("%Psi"))
-    return wxString(L"\x03A8");
-  else if (txt == wxT("%Omega"))
-    return wxString(L"\x03A9");
-
-  return wxEmptyString;
-}
-
-wxString TextCell::GetSymbolUnicode(bool keepPercent)
-{
-  if (m_text == wxT("+"))
-    return wxT("+");
-  else if (m_text == wxT("="))
-    return wxT("=");
-  else if (m_text == wxT("inf"))
-    return wxString(L"\x221E");
-  else if (m_text == wxT("%pi"))
-    return wxString(L"\x03C0");
-  else if (m_text == wxT("<="))
-    return wxString(L"\x2264");
-  else if (m_text == wxT(">="))
-    return wxString(L"\x2265");
-#ifndef __WXMSW__
-  else if (m_text == wxT(" and "))
-    return wxString(L" \x22C0 ");
-  else if (m_text == wxT(" or "))
-    return wxString(L" \x22C1 ");
-  else if (m_text == wxT(" xor "))
-    return wxString(L" \x22BB ");
-  else if (m_text == wxT(" nand "))
-    return wxString(L" \x22BC ");
-  else if (m_text == wxT(" nor "))
-    return wxString(L" \x22BD ");
-  else if (m_text == wxT(" implies "))
-    return wxString(L" \x21D2 ");
-  else if (m_text == wxT(" equiv "))
-    return wxString(L" \x21D4 ");
-  else if (m_text == wxT("not"))
-    return wxString(L"\x00AC");
-  else if (m_text == wxT("->"))
-    return wxString(L"\x2192");
-#endif
- /*
-  else if (m_textStyle == TS_SPECIAL_CONSTANT && m_text == wxT("d"))
-    return wxString(L"\x2202");
-  */
-
-  if (!keepPercent) {
-    if (m_text == wxT("%e"))
-      return wxString(L"e");
-    else if (m_text == wxT("%i"))
-      return wxString(L"i");
+    m_symbol = FindSymbol(m_text, m_textStyle);
+    m_symbolStyle = m_textStyle;
   }
 
-  return wxEmptyString;
-}
-
-#elif defined __WXMSW__
+  m_altText = m_altJsText = NULL;
+  m_fontname = NULL;
+  if (m_symbol == NULL)
+    return;
 
-wxString TextCell::GetGreekStringSymbol()
-{
-  if (m_text == wxT("gamma"))
-    return wxT("\x47");
-  else if (m_text == wxT("zeta"))
-    return wxT("\x7A");
-  else if (m_text == wxT("psi"))
-    return wxT("\x59");
-
-  wxString txt(m_text);
-  if (txt[0] != '%')
-    txt = wxT("%") + txt;
-
-  if (txt == wxT("%alpha"))
-    return wxT("\x61");
-  else if (txt == wxT("%beta"))
-    return wxT("\x62");
-  else if (txt == wxT("%gamma"))
-    return wxT("\x67");
-  else if (txt == wxT("%delta"))
-    return wxT("\x64");
-  else if (txt == wxT("%epsilon"))
-    return wxT("\x65");
-  else if (txt == wxT("%zeta"))
-    return wxT("\x7A");
-  else if (txt == wxT("%eta"))
-    return wxT("\x68");
-  else if (txt == wxT("%theta"))
-    return wxT("\x71");
-  else if (txt == wxT("%iota"))
-    return wxT("\x69");
-  else if (txt == wxT("%kappa"))
-    return wxT("\x6B");
-  else if (txt == wxT("%lambda"))
-    return wxT("\x6C");
-  else if (txt == wxT("%mu"))
-    return wxT("\x6D");
-  else if (txt == wxT("%nu"))
-    return wxT("\x6E");
-  else if (txt == wxT("%xi"))
-    return wxT("\x78");
-  else if (txt == wxT("%omicron"))
-    return wxT("\x6F");
-  else if (txt == wxT("%pi"))
-    return wxT("\x70");
-  else if (txt == wxT("%rho"))
-    return wxT("\x72");
-  else if (txt == wxT("%sigma"))
-    return wxT("\x73");
-  else if (txt == wxT("%tau"))
-    return wxT("\x74");
-  else if (txt == wxT("%upsilon"))
-    return wxT("\x75");
-  else if (txt == wxT("%phi"))
-    return wxT("\x66");
-  else if (txt == wxT("%chi"))
-    return wxT("\x63");
-  else if (txt == wxT("%psi"))
-    return wxT("\x79");
-  else if (txt == wxT("%omega"))
-    return wxT("\x77");
-  else if (txt == wxT("%Alpha"))
-    return wxT("\x41");
-  else if (txt == wxT("%Beta"))
-    return wxT("\x42");
-  else if (txt == wxT("%Gamma"))
-    return wxT("\x47");
-  else if (txt == wxT("%Delta"))
-    return wxT("\x44");
-  else if (txt == wxT("%Epsilon"))
-    return wxT("\x45");
-  else if (txt == wxT("%Zeta"))
-    return wxT("\x5A");
-  else if (txt == wxT("%Eta"))
-    return wxT("\x48");
-  else if (txt == wxT("%Theta"))
-    return wxT("\x51");
-  else if (txt == wxT("%Iota"))
-    return wxT("\x49");
-  else if (txt == wxT("%Kappa"))
-    return wxT("\x4B");
-  else if (txt == wxT("%Lambda"))
-    return wxT("\x4C");
-  else if (txt == wxT("%Mu"))
-    return wxT("\x4D");
-  else if (txt == wxT("%Nu"))
-    return wxT("\x4E");
-  else if (txt == wxT("%Xi"))
-    return wxT("\x58");
-  else if (txt == wxT("%Omicron"))
-    return wxT("\x4F");
-  else if (txt == wxT("%Pi"))
-    return wxT("\x50");
-  else if (txt == wxT("%Rho"))
-    return wxT("\x52");
-  else if (txt == wxT("%Sigma"))
-    return wxT("\x53");
-  else if (txt == wxT("%Tau"))
-    return wxT("\x54");
-  else if (txt == wxT("%Upsilon"))
-    return wxT("\x55");
-  else if (txt == wxT("%Phi"))
-    return wxT("\x46");
-  else if (txt == wxT("%Chi"))
-    return wxT("\x43");
-  else if (txt == wxT("%Psi"))
-    return wxT("\x59");
-  else if (txt == wxT("%Omega"))
-    return wxT("\x57");
-
-  return wxEmptyString;
-}
-
-wxString TextCell::GetSymbolSymbol(bool keepPercent)
-{
-  if (m_text == wxT("inf"))
-    return "\xA5";
-  else if (m_text == wxT("%pi"))
-    return "\x70";
-  else if (m_text == wxT("->"))
-    return "\xAE";
-  else if (m_text == wxT(">="))
-    return "\xB3";
-  else if (m_text == wxT("<="))
-    return "\xA3";
-  else if (m_text == wxT(" and "))
-    return "\xD9";
-  else if (m_text == wxT(" or "))
-    return "\xDA";
-  else if (m_text == wxT("not"))
-    return "\xD8";
-  else if (m_text == wxT(" nand "))
-    return "\xAD";
-  else if (m_text == wxT(" nor "))
-    return "\xAF";
-  else if (m_text == wxT(" implies "))
-    return "\xDE";
-  else if (m_text == wxT(" equiv "))
-    return "\xDB";
-  else if (m_text == wxT(" xor "))
-    return "\xC5";
-
-  if (!keepPercent) {
-    if (m_text == wxT("%e"))
-      return wxString(L"e");
-    else if (m_text == wxT("%i"))
-      return wxString(L"i");
+  if (!m_symbol->m_altJs.IsEmpty())
+  {
+    m_altJsText = &m_symbol->m_altJs;
+    m_texFontname = m_symbol->m_texFont;
   }
 
-  return wxEmptyString;
-}
-
+  if (!m_symbol->m_alt.IsEmpty() &&
+      !(m_symbol->m_onlyWithoutPercent && parser.CheckKeepPercent()))
+  {
+    m_altText = &m_symbol->m_alt;
+#if !wxUSE_UNICODE && defined __WXMSW__
+    m_fontname = &s_symbolFont;
 #endif
-
-wxString TextCell::GetGreekStringTeX()
-{
-  if (m_text == wxT("gamma"))
-    return wxT("\xC0");
-  else if (m_text == wxT("zeta"))
-    return wxT("\xB0");
-  else if (m_text == wxT("psi"))
-    return wxT("\xC9");
-
-  wxString txt(m_text);
-  if (txt[0] != '%')
-    txt = wxT("%") + txt;
-
-  if (txt == wxT("%alpha"))
-    return wxT("\xCB");
-  else if (txt == wxT("%beta"))
-    return wxT("\xCC");
-  else if (txt == wxT("%gamma"))
-    return wxT("\xCD");
-  else if (txt == wxT("%delta"))
-    return wxT("\xCE");
-  else if (txt == wxT("%epsilon"))
-    return wxT("\xCF");
-  else if (txt == wxT("%zeta"))
-    return wxT("\xB0");
-  else if (txt == wxT("%eta"))
-    return wxT("\xD1");
-  else if (txt == wxT("%theta"))
-    return wxT("\xD2");
-  else if (txt == wxT("%iota"))
-    return wxT("\xD3");
-  else if (txt == wxT("%kappa"))
-    return wxT("\xD4");
-  else if (txt == wxT("%lambda"))
-    return wxT("\xD5");
-  else if (txt == wxT("%mu"))
-    return wxT("\xD6");
-  else if (txt == wxT("%nu"))
-    return wxT("\xB7");
-  else if (txt == wxT("%xi"))
-    return wxT("\xD8");
-  else if (txt == wxT("%omicron"))
-    return wxT("o");
-  else if (txt == wxT("%pi"))
-    return wxT("\xD9");
-  else if (txt == wxT("%rho"))
-    return wxT("\xDA");
-  else if (txt == wxT("%sigma"))
-    return wxT("\xDB");
-  else if (txt == wxT("%tau"))
-    return wxT("\xDC");
-  else if (txt == wxT("%upsilon"))
-    return wxT("\xB5");
-  else if (txt == wxT("%chi"))
-    return wxT("\xDF");
-  else if (txt == wxT("%psi"))
-    return wxT("\xEF");
-  else if (txt == wxT("%phi"))
-    return wxT("\x27");
-  else if (txt == wxT("%omega"))
-    return wxT("\x21");
-  else if (txt == wxT("%Alpha"))
-    return wxT("A");
-  else if (txt == wxT("%Beta"))
-    return wxT("B");
-  else if (txt == wxT("%Gamma"))
-    return wxT("\xC0");
-  else if (txt == wxT("%Delta"))
-    return wxT("\xC1");
-  else if (txt == wxT("%Epsilon"))
-    return wxT("E");
-  else if (txt == wxT("%Zeta"))
-    return wxT("Z");
-  else if (txt == wxT("%Eta"))
-    return wxT("H");
-  else if (txt == wxT("%Theta"))
-    return wxT("\xC2");
-  else if (txt == wxT("%Iota"))
-    return wxT("I");
-  else if (txt == wxT("%Kappa"))
-    return wxT("K");
-  else if (txt == wxT("%Lambda"))
-    return wxT("\xC3");
-  else if (txt == wxT("%Mu"))
-    return wxT("M");
-  else if (txt == wxT("%Nu"))
-    return wxT("N");
-  else if (txt == wxT("%Xi"))
-    return wxT("\xC4");
-  else if (txt == wxT("%Omicron"))
-    return wxT("O");
-  else if (txt == wxT("%Pi"))
-    return wxT("\xC5");
-  else if (txt == wxT("%Rho"))
-    return wxT("P");
-  else if (txt == wxT("%Sigma"))
-    return wxT("\xC6");
-  else if (txt == wxT("%Tau"))
-    return wxT("T");
-  else if (txt == wxT("%Upsilon"))
-    return wxT("Y");
-  else if (txt == wxT("%Phi"))
-    return wxT("\xC8");
-  else if (txt == wxT("%Chi"))
-    return wxT("X");
-  else if (txt == wxT("%Psi"))
-    return wxT("\xC9");
-  else if (txt == wxT("%Omega"))
-    return wxT("\xCA");
-
-  return wxEmptyString;
-}
-
-wxString TextCell::GetSymbolTeX()
-{
-  if (m_text == wxT("inf"))
-    return wxT("\x31");
-  else if (m_text == wxT("+"))
-    return wxT("+");
-  else if (m_text == wxT("%pi"))
-    return wxT("\xD9");
-  else if (m_text == wxT("="))
-    return wxT("=");
-  else if (m_text == wxT("->"))
-    return wxT("\x21");
-  else if (m_text == wxT(">="))
-    return wxT("\xD5");
-  else if (m_text == wxT("<="))
-    return wxT("\xD4");
-/*
-  else if (m_text == wxT(" and "))
-    return wxT(" \x5E ");
-  else if (m_text == wxT(" or "))
-    return wxT(" \x5F ");
-  else if (m_text == wxT(" nand "))
-    return wxT(" \x22 ");
-  else if (m_text == wxT(" nor "))
-    return wxT(" \x23 ");
-  else if (m_text == wxT(" eq "))
-    return wxT(" \x2C ");
-  else if (m_text == wxT(" implies "))
-    return wxT(" \x29 ");
-  else if (m_text == wxT("not"))
-    return wxT("\x3A");
-  else if (m_text == wxT(" xor "))
-    return wxT("\xC8");
-*/
-
-  return wxEmptyString;
+  }
 }
@@ -24,6 +24,8 @@
 
 #include "MathCell.h"
 
+class TextCellSymbol;
+
 class TextCell : public MathCell
 {
 public:
@@ -42,22 +44,25 @@ public:
   wxString GetDiffPart();
   bool IsOperator();
   wxString GetValue() { return m_text; }
-  wxString GetGreekStringTeX();
-  wxString GetSymbolTeX();
-#if wxUSE_UNICODE
-  wxString GetGreekStringUnicode();
-  wxString GetSymbolUnicode(bool keepPercent);
-#elif defined __WXMSW__
-  wxString GetGreekStringSymbol();
-  wxString GetSymbolSymbol(bool keepPercent);
-#endif
   bool IsShortNum();
 protected:
   void SetAltText(CellParser& parser);
   wxString m_text;
-  wxString m_altText, m_altJsText;
-  wxString m_fontname, m_texFontname;
-  bool m_alt, m_altJs;
+  //! The entry of the symbol table m_text is displayed as or NULL
+  const TextCellSymbol *m_symbol;
+  //! The text style m_symbol has been looked up for; -1 = not looked up yet
+  int m_symbolStyle;
+  /*! The symbol that is displayed instead of m_text or NULL
+
+    Points into the symbol table: There are only a few symbols but many cells.
+   */
+  const wxString *m_altText;
+  //! The symbol that is displayed using the jsMath fonts instead of m_text or NULL
+  const wxString *m_altJsText;
+  //! The font m_altText is to be displayed with. NULL means: The font of the text style.
+  const wxString *m_fontname;
+  //! The jsMath font m_altJsText is to be displayed with
+  const wxString *m_texFontname;
   int m_realCenter;
   int m_fontSize;
   int m_fontSizeTeX;
@@ -0,0 +1,92 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "TextExtentCache.h"
+
+bool TextExtentCache::Key::operator<(const Key &other) const
+{
+  if (font != other.font)
+    return font < other.font;
+  if (ppi.x != other.ppi.x)
+    return ppi.x < other.ppi.x;
+  if (ppi.y != other.ppi.y)
+    return ppi.y < other.ppi.y;
+  if (scaleX != other.scaleX)
+    return scaleX < other.scaleX;
+  if (scaleY != other.scaleY)
+    return scaleY < other.scaleY;
+  return text < other.text;
+}
+
+TextExtentCache::TextExtentCache(size_t capacity)
+{
+  m_capacity = capacity;
+  if (m_capacity < 1)
+    m_capacity = 1;
+  m_hits = 0;
+  m_misses = 0;
+}
+
+void TextExtentCache::GetTextExtent(wxDC &dc, int font, const wxString &text,
+                                    wxCoord *width, wxCoord *height, wxCoord *descent)
+{
+  Key key;
+  key.font = font;
+  key.ppi = dc.GetPPI();
+  dc.GetUserScale(&key.scaleX, &key.scaleY);
+  key.text = text;
+
+  std::map<Key, EntryList::iterator>::iterator found = m_index.find(key);
+  if (found != m_index.end())
+  {
+    m_hits++;
+    // Move the entry to the front of the list
+    m_entries.splice(m_entries.begin(), m_entries, found->second);
+  }
+  else
+  {
+    m_misses++;
+    Entry entry;
+    entry.key = key;
+    dc.GetTextExtent(text, &entry.width, &entry.height, &entry.descent);
+
+    if (m_index.size() >= m_capacity)
+    {
+      m_index.erase(m_entries.back().key);
+      m_entries.pop_back();
+    }
+    m_entries.push_front(entry);
+    found = m_index.insert(std::make_pair(key, m_entries.begin())).first;
+  }
+
+  const Entry &entry = *found->second;
+  if (width != NULL)
+    *width = entry.width;
+  if (height != NULL)
+    *height = entry.height;
+  if (descent != NULL)
+    *descent = entry.descent;
+}
+
+void TextExtentCache::Clear()
+{
+  m_index.clear();
+  m_entries.clear();
+}
@@ -0,0 +1,89 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+  The definition of the cache for the results of wxDC::GetTextExtent().
+*/
+
+#ifndef TEXTEXTENTCACHE_H
+#define TEXTEXTENTCACHE_H
+
+#include <wx/wx.h>
+#include <list>
+#include <map>
+
+//! The number of text extents a TextExtentCache remembers by default
+#define TEXTEXTENTCACHE_DEFAULT_CAPACITY 20000
+
+/*! Remembers the size of the strings that have been measured recently
+
+  Asking the toolkit for the extent of a string is slow and the worksheet
+  asks for the same strings in the same fonts over and over again: on every
+  zoom, every resize and every caret move. The cache is indexed by a number
+  the caller assigns to the font, by the resolution and the user scale of
+  the device context and by the string. If it is full the entry that has
+  been used least recently is dropped.
+*/
+class TextExtentCache
+{
+public:
+  TextExtentCache(size_t capacity = TEXTEXTENTCACHE_DEFAULT_CAPACITY);
+
+  /*! Returns the extent of text in the font dc currently uses
+
+    font is the caller's number for the font the dc uses.
+  */
+  void GetTextExtent(wxDC &dc, int font, const wxString &text,
+                     wxCoord *width, wxCoord *height, wxCoord *descent = NULL);
+  //! Forgets all extents
+  void Clear();
+
+  //! How often a string was found in the cache
+  unsigned long GetHits() const { return m_hits; }
+  //! How often a string had to be measured
+  unsigned long GetMisses() const { return m_misses; }
+  size_t GetCount() const { return m_index.size(); }
+
+private:
+  struct Key
+  {
+    int font;
+    wxSize ppi;
+    double scaleX, scaleY;
+    wxString text;
+    bool operator<(const Key &other) const;
+  };
+  struct Entry
+  {
+    Key key;
+    wxCoord width, height, descent;
+  };
+  typedef std::list<Entry> EntryList;
+
+  //! All entries, the one that has been used most recently first
+  EntryList m_entries;
+  //! Finds the entries in m_entries
+  std::map<Key, EntryList::iterator> m_index;
+  size_t m_capacity;
+  unsigned long m_hits;
+  unsigned long m_misses;
+};
+
+#endif // TEXTEXTENTCACHE_H
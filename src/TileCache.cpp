@@ -0,0 +1,156 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "TileCache.h"
+#include <limits.h>
+
+TileCache::TileCache()
+{
+  m_visibleTiles = 16;
+  m_scaleFactor = 1.0;
+  UpdateCapacity();
+  m_useCounter = 0;
+}
+
+TileCache::~TileCache()
+{
+  Clear();
+}
+
+TileCache::Tile *TileCache::GetTile(int column, int row)
+{
+  std::pair<int, int> key(row, column);
+  TileMap::iterator found = m_tiles.find(key);
+  if (found != m_tiles.end())
+  {
+    found->second->m_lastUse = ++m_useCounter;
+    return found->second;
+  }
+
+  while ((m_tiles.size() >= m_capacity) && !m_tiles.empty())
+    DropOldestTile();
+
+  Tile *tile = new Tile;
+  tile->m_rect = wxRect(column * TILECACHE_TILE_SIZE, row * TILECACHE_TILE_SIZE,
+                        TILECACHE_TILE_SIZE, TILECACHE_TILE_SIZE);
+  tile->m_bitmap.CreateScaled(TILECACHE_TILE_SIZE, TILECACHE_TILE_SIZE, -1, m_scaleFactor);
+  tile->m_dirty = wxRegion(tile->m_rect);
+  tile->m_lastUse = ++m_useCounter;
+  m_tiles[key] = tile;
+  return tile;
+}
+
+void TileCache::DropOldestTile()
+{
+  // There are only a few dozen tiles => a linear search is fast enough.
+  TileMap::iterator oldest = m_tiles.begin();
+  for (TileMap::iterator it = m_tiles.begin(); it != m_tiles.end(); ++it)
+    if (it->second->m_lastUse < oldest->second->m_lastUse)
+      oldest = it;
+  delete oldest->second;
+  m_tiles.erase(oldest);
+}
+
+void TileCache::Invalidate(const wxRect &rect)
+{
+  for (TileMap::iterator it = m_tiles.begin(); it != m_tiles.end(); ++it)
+  {
+    Tile *tile = it->second;
+    if (tile->m_rect.Intersects(rect))
+      tile->m_dirty.Union(tile->m_rect.Intersect(rect));
+  }
+}
+
+void TileCache::InvalidateBand(int top, int bottom)
+{
+  for (TileMap::iterator it = m_tiles.begin(); it != m_tiles.end(); ++it)
+  {
+    Tile *tile = it->second;
+    if ((tile->m_rect.GetBottom() < top) || (tile->m_rect.GetTop() > bottom))
+      continue;
+
+    // wxRect::SetTop() keeps the height => the bottom has to be set afterwards.
+    wxRect dirty(tile->m_rect);
+    dirty.SetTop(wxMax(top, tile->m_rect.GetTop()));
+    dirty.SetBottom(wxMin(bottom, tile->m_rect.GetBottom()));
+    tile->m_dirty.Union(dirty);
+  }
+}
+
+void TileCache::InvalidateBelow(int y)
+{
+  InvalidateBand(y, INT_MAX);
+}
+
+void TileCache::InvalidateAll()
+{
+  for (TileMap::iterator it = m_tiles.begin(); it != m_tiles.end(); ++it)
+    it->second->m_dirty = wxRegion(it->second->m_rect);
+}
+
+void TileCache::Clear()
+{
+  for (TileMap::iterator it = m_tiles.begin(); it != m_tiles.end(); ++it)
+    delete it->second;
+  m_tiles.clear();
+}
+
+void TileCache::SetScaleFactor(double scale)
+{
+  if (scale != m_scaleFactor)
+  {
+    Clear();
+    m_buffer = wxNullBitmap;
+    m_bufferSize = wxSize(0, 0);
+    m_scaleFactor = scale;
+    UpdateCapacity();
+  }
+}
+
+wxBitmap &TileCache::GetBuffer(const wxSize &size)
+{
+  if ((size.x > m_bufferSize.x) || (size.y > m_bufferSize.y))
+  {
+    // Growing the buffer in both directions at once avoids creating it
+    // again and again if the size of the requests alternates.
+    m_bufferSize.x = wxMax(size.x, m_bufferSize.x);
+    m_bufferSize.y = wxMax(size.y, m_bufferSize.y);
+    m_buffer.CreateScaled(m_bufferSize.x, m_bufferSize.y, -1, m_scaleFactor);
+  }
+  return m_buffer;
+}
+
+void TileCache::SetVisibleTiles(size_t tiles)
+{
+  m_visibleTiles = wxMax(tiles, (size_t) 1);
+  UpdateCapacity();
+}
+
+void TileCache::UpdateCapacity()
+{
+  // A tile has 4 bytes per pixel; CreateScaled() multiplies both of its
+  // dimensions by the scale factor.
+  double tileSize = TILECACHE_TILE_SIZE * m_scaleFactor;
+  size_t tileBytes = wxMax((size_t) (tileSize * tileSize * 4), (size_t) 1);
+  m_capacity = wxMin(3 * m_visibleTiles, (size_t) TILECACHE_MAX_MEMORY / tileBytes);
+  m_capacity = wxMax(m_capacity, m_visibleTiles);
+  while (m_tiles.size() > m_capacity)
+    DropOldestTile();
+}
@@ -0,0 +1,122 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+  The definition of the class TileCache that keeps rendered parts of the
+  worksheet.
+*/
+
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <wx/wx.h>
+#include <map>
+
+//! The width and height of a tile [pixels]
+#define TILECACHE_TILE_SIZE 256
+//! The memory the tiles may take [bytes], unless the visible ones need more
+#define TILECACHE_MAX_MEMORY (64 * 1024 * 1024)
+
+/*! Bitmaps of the parts of the worksheet that have been drawn already
+
+  The worksheet is divided into square tiles. A tile remembers which part of
+  it is out of date. When the worksheet is repainted only these parts are
+  drawn again; everything else is copied from the tiles. This way scrolling
+  back to a part of the worksheet that already has been visible and
+  uncovering the window are as fast as copying a bitmap.
+
+  All coordinates are worksheet coordinates, not window coordinates.
+*/
+class TileCache
+{
+public:
+  //! A rendered part of the worksheet
+  class Tile
+  {
+  public:
+    wxBitmap m_bitmap;
+    //! The part of the worksheet this tile shows
+    wxRect m_rect;
+    //! The part of m_rect that has to be drawn again
+    wxRegion m_dirty;
+    //! When the tile was used for the last time. Tiles that haven't been used for long are dropped first.
+    unsigned long m_lastUse;
+  };
+
+  TileCache();
+  ~TileCache();
+
+  /*! Returns the tile at a column and row of the tile grid
+
+    Creates the tile if it doesn't exist. A new tile is dirty as a whole.
+   */
+  Tile *GetTile(int column, int row);
+  //! Marks a part of the worksheet as having to be drawn again
+  void Invalidate(const wxRect &rect);
+  //! Marks the whole width of the worksheet between top and bottom as having to be drawn again
+  void InvalidateBand(int top, int bottom);
+  //! Marks everything from the y coordinate y down as having to be drawn again
+  void InvalidateBelow(int y);
+  //! Marks everything as having to be drawn again
+  void InvalidateAll();
+  //! Drops all tiles
+  void Clear();
+  /*! Sets the scale of the screen
+
+    The tiles are created with this content scale factor. Dropping all
+    tiles if it changes.
+   */
+  void SetScaleFactor(double scale);
+  /*! Sets the number of tiles the window can show at once
+
+    The cache keeps the tiles of about three screens, as far as they fit
+    into TILECACHE_MAX_MEMORY at the current scale, but never fewer than
+    the visible ones.
+   */
+  void SetVisibleTiles(size_t tiles);
+  /*! Returns a bitmap with at least the given size and the current scale
+
+    Parts of several tiles can be drawn to it at once and then be copied to
+    the tiles. Is kept until the scale changes.
+   */
+  wxBitmap &GetBuffer(const wxSize &size);
+
+private:
+  typedef std::map<std::pair<int, int>, Tile *> TileMap;
+  //! The tiles, indexed by (row, column)
+  TileMap m_tiles;
+  //! Drops the tile that hasn't been used for the longest time
+  void DropOldestTile();
+  //! Calculates m_capacity from m_visibleTiles and m_scaleFactor
+  void UpdateCapacity();
+  //! The number of tiles that are kept at most
+  size_t m_capacity;
+  //! The number of tiles the window can show at once
+  size_t m_visibleTiles;
+  double m_scaleFactor;
+  //! Is increased every time a tile is used
+  unsigned long m_useCounter;
+  //! The bitmap GetBuffer() returns
+  wxBitmap m_buffer;
+  //! The size m_buffer has been created with
+  wxSize m_bufferSize;
+};
+
+#endif // TILECACHE_H
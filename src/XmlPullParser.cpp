@@ -0,0 +1,538 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+
+#include "XmlPullParser.h"
+
+const wxChar XmlPullParser::CompactFrameStart;
+const wxChar XmlPullParser::CompactFrameEnd;
+
+//! The control characters the compact frames are made of
+enum
+{
+  COMPACT_START_TAG = 0x0E,  // SO
+  COMPACT_END_TAG = 0x0F,    // SI
+  COMPACT_ESCAPE = 0x10,     // DLE
+  COMPACT_ATTRIBUTE = 0x11,  // DC1
+  COMPACT_NAME = 0x1A,       // SUB
+  COMPACT_SEPARATOR = 0x1F   // US
+};
+
+//! The elements that have a one-character code in compact frames
+static const wxChar *compactTags[] =
+{
+  wxT("mth"), wxT("v"), wxT("t"), wxT("n"), wxT("h"), wxT("p"), wxT("f"),
+  wxT("e"), wxT("i"), wxT("g"), wxT("s"), wxT("q"), wxT("d"), wxT("a"),
+  wxT("r"), wxT("fn"), wxT("sm"), wxT("st"), wxT("in"), wxT("ie"), wxT("at"),
+  wxT("cj"), wxT("lm"), wxT("tb"), wxT("hl"), wxT("fnm"), wxT("lbl"),
+  wxT("img"), wxT("line"), wxT("slide"), wxT("ascii"), wxT("mspace"),
+  wxT("mtr"), wxT("mtd")
+};
+
+XmlPullParser::XmlPullParser(const wxString &data) : m_data(data)
+{
+  m_pos = m_data.begin();
+  m_end = m_data.end();
+  m_token = EndOfDocument;
+  m_emptyElement = false;
+  m_compact = IsCompactFrame(data);
+
+  if (m_compact)
+  {
+    // Skip the header: The payload's length is only needed for finding the
+    // end of the frame in maxima's output.
+    while ((m_pos != m_end) && (*m_pos != wxT(':')))
+      ++m_pos;
+    wxString::const_iterator last = m_end;
+    if ((m_pos == m_end) || (*(--last) != CompactFrameEnd))
+      Fail();
+    else
+    {
+      ++m_pos;
+      m_end = last;
+    }
+  }
+}
+
+wxString XmlPullParser::CompactStartTag(const wxString &name)
+{
+  wxString tag = wxString(wxUniChar(COMPACT_START_TAG));
+  for (unsigned int i = 0; i < sizeof(compactTags) / sizeof(compactTags[0]); i++)
+    if (name == compactTags[i])
+      return tag + wxUniChar(i + 33);
+  return tag + wxUniChar(COMPACT_NAME) + name + wxUniChar(COMPACT_SEPARATOR);
+}
+
+XmlPullParser::Token XmlPullParser::Fail()
+{
+  m_pos = m_end;
+  return m_token = Error;
+}
+
+XmlPullParser::Token XmlPullParser::Next()
+{
+  if (m_token == Error)
+    return m_token;
+
+  m_attributeNames.Clear();
+  m_attributeValues.Clear();
+
+  if (m_compact)
+    return NextCompact();
+
+  // The end tag of an empty-element tag like <mspace/>
+  if (m_emptyElement)
+  {
+    m_emptyElement = false;
+    m_openElements.RemoveAt(m_openElements.GetCount() - 1);
+    return m_token = EndTag;
+  }
+
+  while (true)
+  {
+    if (m_pos == m_end)
+    {
+      if (!m_openElements.IsEmpty())
+        return Fail();
+      return m_token = EndOfDocument;
+    }
+
+    if (*m_pos == wxT('<'))
+    {
+      ++m_pos;
+      if (m_pos == m_end)
+        return Fail();
+
+      if (*m_pos == wxT('/'))
+      {
+        ++m_pos;
+        return ReadEndTag();
+      }
+
+      if ((*m_pos == wxT('!')) || (*m_pos == wxT('?')))
+      {
+        if (ReadSpecial() != EndOfDocument)
+          return m_token;
+        continue;
+      }
+
+      return ReadStartTag();
+    }
+
+    // Whitespace-only text is skipped.
+    if (ReadText())
+      return m_token;
+  }
+}
+
+XmlPullParser::Token XmlPullParser::NextCompact()
+{
+  while (true)
+  {
+    if (m_pos == m_end)
+    {
+      if (!m_openElements.IsEmpty())
+        return Fail();
+      return m_token = EndOfDocument;
+    }
+
+    if (*m_pos == wxUniChar(COMPACT_START_TAG))
+    {
+      ++m_pos;
+      if (m_pos == m_end)
+        return Fail();
+
+      wxUniChar code = *m_pos;
+      ++m_pos;
+      if (code == wxUniChar(COMPACT_NAME))
+      {
+        wxString::const_iterator start = m_pos;
+        while ((m_pos != m_end) && (*m_pos != wxUniChar(COMPACT_SEPARATOR)))
+          ++m_pos;
+        if (m_pos == m_end)
+          return Fail();
+        m_name = wxString(start, m_pos);
+        ++m_pos;
+      }
+      else
+      {
+        unsigned int index = (unsigned int) code.GetValue() - 33;
+        if (index >= sizeof(compactTags) / sizeof(compactTags[0]))
+          return Fail();
+        m_name = compactTags[index];
+      }
+
+      while ((m_pos != m_end) && (*m_pos == wxUniChar(COMPACT_ATTRIBUTE)))
+      {
+        ++m_pos;
+        wxString::const_iterator start = m_pos;
+        while ((m_pos != m_end) && (*m_pos != wxUniChar(COMPACT_SEPARATOR)))
+          ++m_pos;
+        if (m_pos == m_end)
+          return Fail();
+        wxString name(start, m_pos);
+        ++m_pos;
+
+        wxString value;
+        ReadCompactString(value);
+        if ((m_pos == m_end) || (*m_pos != wxUniChar(COMPACT_SEPARATOR)))
+          return Fail();
+        ++m_pos;
+
+        m_attributeNames.Add(name);
+        m_attributeValues.Add(value);
+      }
+
+      m_openElements.Add(m_name);
+      return m_token = StartTag;
+    }
+
+    if (*m_pos == wxUniChar(COMPACT_END_TAG))
+    {
+      ++m_pos;
+      if (m_openElements.IsEmpty())
+        return Fail();
+      m_name = m_openElements.Last();
+      m_openElements.RemoveAt(m_openElements.GetCount() - 1);
+      return m_token = EndTag;
+    }
+
+    m_text.Clear();
+    if (ReadCompactString(m_text))
+      return m_token = Text;
+    if ((m_pos != m_end) && (*m_pos == wxUniChar(COMPACT_SEPARATOR)))
+      return Fail();
+  }
+}
+
+bool XmlPullParser::ReadCompactString(wxString &str)
+{
+  bool whitespaceOnly = true;
+
+  while ((m_pos != m_end) &&
+         (*m_pos != wxUniChar(COMPACT_START_TAG)) &&
+         (*m_pos != wxUniChar(COMPACT_END_TAG)) &&
+         (*m_pos != wxUniChar(COMPACT_SEPARATOR)))
+  {
+    wxUniChar ch = *m_pos;
+    ++m_pos;
+    if ((ch == wxUniChar(COMPACT_ESCAPE)) && (m_pos != m_end))
+    {
+      wxUniChar escaped = *m_pos;
+      ch = wxUniChar(escaped.GetValue() ^ 0x40);
+      ++m_pos;
+    }
+
+    // Newlines are dropped and other control characters replaced the same
+    // way wxMaxima::DoConsoleAppend() and MathParser::ParseLine() treat xml.
+    if (ch == wxT('\n'))
+      continue;
+    wxUint32 code = ch.GetValue();
+    if ((code < 0x20) || ((code >= 0x7F) && (code < 0xA0)))
+#if wxUSE_UNICODE
+      ch = wxT('\xFFFD');
+#else
+      ch = wxT('?');
+#endif
+
+    if (ch != wxT(' '))
+      whitespaceOnly = false;
+    str += ch;
+  }
+
+  return !whitespaceOnly;
+}
+
+bool XmlPullParser::LookingAt(const wxChar *str) const
+{
+  wxString::const_iterator pos = m_pos;
+  while (*str)
+  {
+    if ((pos == m_end) || (*pos != *str))
+      return false;
+    ++pos;
+    ++str;
+  }
+  return true;
+}
+
+void XmlPullParser::SkipSpace()
+{
+  while ((m_pos != m_end) &&
+         ((*m_pos == wxT(' ')) || (*m_pos == wxT('\t')) ||
+          (*m_pos == wxT('\r')) || (*m_pos == wxT('\n'))))
+    ++m_pos;
+}
+
+bool XmlPullParser::ReadName(wxString &name)
+{
+  wxString::const_iterator start = m_pos;
+  while ((m_pos != m_end) &&
+         (*m_pos != wxT(' ')) && (*m_pos != wxT('\t')) &&
+         (*m_pos != wxT('\r')) && (*m_pos != wxT('\n')) &&
+         (*m_pos != wxT('/')) && (*m_pos != wxT('>')) &&
+         (*m_pos != wxT('=')) && (*m_pos != wxT('<')))
+    ++m_pos;
+  name = wxString(start, m_pos);
+  return !name.IsEmpty();
+}
+
+XmlPullParser::Token XmlPullParser::ReadSpecial()
+{
+  const wxChar *terminator;
+  bool cdata = false;
+
+  if (LookingAt(wxT("![CDATA[")))
+  {
+    m_pos += 8;
+    terminator = wxT("]]>");
+    cdata = true;
+  }
+  else if (LookingAt(wxT("!--")))
+    terminator = wxT("-->");
+  else if (*m_pos == wxT('?'))
+    terminator = wxT("?>");
+  else
+    terminator = wxT(">");
+
+  wxString::const_iterator start = m_pos;
+  while (!LookingAt(terminator))
+  {
+    if (m_pos == m_end)
+      return Fail();
+    ++m_pos;
+  }
+
+  if (cdata)
+    m_text = wxString(start, m_pos);
+  m_pos += wxStrlen(terminator);
+
+  if (cdata)
+    return m_token = Text;
+  return EndOfDocument;
+}
+
+XmlPullParser::Token XmlPullParser::ReadStartTag()
+{
+  if (!ReadName(m_name))
+    return Fail();
+
+  while (true)
+  {
+    SkipSpace();
+    if (m_pos == m_end)
+      return Fail();
+
+    if (*m_pos == wxT('>'))
+    {
+      ++m_pos;
+      break;
+    }
+
+    if (*m_pos == wxT('/'))
+    {
+      ++m_pos;
+      if ((m_pos == m_end) || (*m_pos != wxT('>')))
+        return Fail();
+      ++m_pos;
+      m_emptyElement = true;
+      break;
+    }
+
+    wxString name;
+    if (!ReadName(name))
+      return Fail();
+    SkipSpace();
+    if ((m_pos == m_end) || (*m_pos != wxT('=')))
+      return Fail();
+    ++m_pos;
+    SkipSpace();
+    if ((m_pos == m_end) || ((*m_pos != wxT('"')) && (*m_pos != wxT('\''))))
+      return Fail();
+    wxUniChar quote = *m_pos;
+    ++m_pos;
+
+    wxString value;
+    while (true)
+    {
+      if (m_pos == m_end)
+        return Fail();
+      if (*m_pos == quote)
+      {
+        ++m_pos;
+        break;
+      }
+      if (*m_pos == wxT('&'))
+      {
+        if (!ReadEntity(value))
+          return Fail();
+      }
+      else
+      {
+        value += *m_pos;
+        ++m_pos;
+      }
+    }
+    m_attributeNames.Add(name);
+    m_attributeValues.Add(value);
+  }
+
+  m_openElements.Add(m_name);
+  return m_token = StartTag;
+}
+
+XmlPullParser::Token XmlPullParser::ReadEndTag()
+{
+  if (!ReadName(m_name))
+    return Fail();
+  SkipSpace();
+  if ((m_pos == m_end) || (*m_pos != wxT('>')))
+    return Fail();
+  ++m_pos;
+
+  if (m_openElements.IsEmpty() || (m_openElements.Last() != m_name))
+    return Fail();
+  m_openElements.RemoveAt(m_openElements.GetCount() - 1);
+  return m_token = EndTag;
+}
+
+bool XmlPullParser::ReadText()
+{
+  bool whitespaceOnly = true;
+  m_text.Clear();
+
+  wxString::const_iterator start = m_pos;
+  while ((m_pos != m_end) && (*m_pos != wxT('<')))
+  {
+    if (*m_pos == wxT('&'))
+    {
+      m_text += wxString(start, m_pos);
+      if (!ReadEntity(m_text))
+      {
+        Fail();
+        return true;
+      }
+      whitespaceOnly = false;
+      start = m_pos;
+    }
+    else
+    {
+      if ((*m_pos != wxT(' ')) && (*m_pos != wxT('\t')) &&
+          (*m_pos != wxT('\r')) && (*m_pos != wxT('\n')))
+        whitespaceOnly = false;
+      ++m_pos;
+    }
+  }
+  m_text += wxString(start, m_pos);
+
+  if (whitespaceOnly)
+    return false;
+
+  m_token = Text;
+  return true;
+}
+
+bool XmlPullParser::ReadEntity(wxString &str)
+{
+  // Skip the '&'
+  ++m_pos;
+  wxString::const_iterator start = m_pos;
+  while ((m_pos != m_end) && (*m_pos != wxT(';')))
+  {
+    if (*m_pos == wxT('<'))
+      return false;
+    ++m_pos;
+  }
+  if (m_pos == m_end)
+    return false;
+  wxString entity(start, m_pos);
+  // Skip the ';'
+  ++m_pos;
+
+  if (entity == wxT("lt"))
+    str += wxT('<');
+  else if (entity == wxT("gt"))
+    str += wxT('>');
+  else if (entity == wxT("amp"))
+    str += wxT('&');
+  else if (entity == wxT("quot"))
+    str += wxT('"');
+  else if (entity == wxT("apos"))
+    str += wxT('\'');
+  else if (entity.StartsWith(wxT("#x")) || entity.StartsWith(wxT("#X")))
+  {
+    unsigned long code;
+    if (!entity.Mid(2).ToULong(&code, 16))
+      return false;
+    str += wxUniChar(code);
+  }
+  else if (entity.StartsWith(wxT("#")))
+  {
+    unsigned long code;
+    if (!entity.Mid(1).ToULong(&code))
+      return false;
+    str += wxUniChar(code);
+  }
+  else
+    return false;
+
+  return true;
+}
+
+bool XmlPullParser::GetAttribute(const wxString &name, wxString *value) const
+{
+  int index = m_attributeNames.Index(name);
+  if (index == wxNOT_FOUND)
+    return false;
+  *value = m_attributeValues[index];
+  return true;
+}
+
+wxString XmlPullParser::GetAttribute(const wxString &name,
+                                     const wxString &defaultValue) const
+{
+  wxString value;
+  if (GetAttribute(name, &value))
+    return value;
+  return defaultValue;
+}
+
+void XmlPullParser::SkipNode()
+{
+  int depth = 0;
+  do
+  {
+    if (m_token == StartTag)
+      depth++;
+    else if (m_token == EndTag)
+      depth--;
+    else if (m_token != Text)
+      return;
+    Next();
+  } while (depth > 0);
+}
+
+void XmlPullParser::FinishElement()
+{
+  while (AtNode())
+    SkipNode();
+  if (m_token == EndTag)
+    Next();
+}
@@ -0,0 +1,179 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+
+/*! \file
+  A minimal pull parser for the xml maxima sends us.
+*/
+
+#ifndef XMLPULLPARSER_H
+#define XMLPULLPARSER_H
+
+#include <wx/wx.h>
+#include <wx/string.h>
+#include <wx/arrstr.h>
+
+/*! A non-validating pull parser for xml fragments
+
+  wxXmlDocument builds a complete DOM tree that for math-heavy output is
+  several times the size of the cell tree that is generated from it.
+  This parser instead hands out the xml tokens one by one so MathParser can
+  create the cells directly while reading through the data.
+
+  Whitespace-only text is skipped the same way wxXmlDocument does by default.
+  Empty-element tags like \<mspace/\> are reported as a start tag that is
+  immediately followed by an end tag.
+
+  The parser also reads the compact frames wxmathml.lisp sends instead of
+  \<mth\> elements if wxMaxima has asked it to:
+
+   - A frame is STX, the length of the payload as a decimal number, a ':',
+     the payload and ETX.
+   - In the payload SO followed by a one-character code starts an element;
+     the code is the element's index in the tag table plus 33. Elements that
+     aren't in the table are written as SO SUB name US instead.
+   - Each attribute is written as DC1 name US value US directly after the
+     start tag.
+   - SI ends the innermost element that is still open.
+   - In text and attribute values DLE followed by a character c stands for
+     the character c^0x40. This way neither a control character nor a '<'
+     is ever sent verbatim.
+
+  The tag table has to match *wxxml-compact-tags* in wxmathml.lisp.
+*/
+class XmlPullParser
+{
+public:
+  //! The kinds of tokens this parser can return
+  enum Token
+  {
+    StartTag,
+    EndTag,
+    Text,
+    EndOfDocument,
+    //! The data wasn't well-formed xml. Once this token is reached it is never left.
+    Error
+  };
+
+  //! Creates a parser that reads from data. data has to outlive the parser.
+  explicit XmlPullParser(const wxString &data);
+
+  //! The character a compact frame starts with
+  static const wxChar CompactFrameStart = wxT('\x02');
+  //! The character a compact frame ends with
+  static const wxChar CompactFrameEnd = wxT('\x03');
+  //! Is data a compact frame instead of xml?
+  static bool IsCompactFrame(const wxString &data)
+    {
+      return data.StartsWith(wxString(CompactFrameStart));
+    }
+  //! The start tag of an element in a compact frame
+  static wxString CompactStartTag(const wxString &name);
+
+  //! Advances to the next token and returns it.
+  Token Next();
+  //! The current token
+  Token GetToken() const
+    {
+      return m_token;
+    }
+  //! Does the current token start a node (an element or text)?
+  bool AtNode() const
+    {
+      return (m_token == StartTag) || (m_token == Text);
+    }
+  //! The name of the current start or end tag
+  const wxString &GetName() const
+    {
+      return m_name;
+    }
+  //! The contents of the current text token with all entities decoded
+  const wxString &GetText() const
+    {
+      return m_text;
+    }
+  //! Does the current start tag have attributes?
+  bool HasAttributes() const
+    {
+      return !m_attributeNames.IsEmpty();
+    }
+  //! Reads an attribute of the current start tag
+  bool GetAttribute(const wxString &name, wxString *value) const;
+  //! Reads an attribute of the current start tag
+  wxString GetAttribute(const wxString &name, const wxString &defaultValue) const;
+
+  /*! Skips the current node
+
+    If the current token is a start tag everything up to and including the
+    matching end tag is skipped.
+  */
+  void SkipNode();
+  /*! Skips the rest of the current element
+
+    Is to be called when positioned inside an element: All children that
+    haven't been read, yet, and the element's end tag are skipped.
+  */
+  void FinishElement();
+
+private:
+  //! Next() for compact frames
+  Token NextCompact();
+  /*! Reads text or an attribute value from a compact frame
+
+    Stops at the next SO, SI or US.
+    \return false if the text consisted only of whitespace.
+   */
+  bool ReadCompactString(wxString &str);
+  //! Reads a start tag. m_pos points to the character following the '<'.
+  Token ReadStartTag();
+  //! Reads an end tag. m_pos points to the character following the "</".
+  Token ReadEndTag();
+  //! Skips comments and processing instructions or reads CDATA.
+  Token ReadSpecial();
+  //! Reads text up to the next '<'
+  bool ReadText();
+  //! Reads a name. Returns false if there was no name.
+  bool ReadName(wxString &name);
+  //! Decodes the entity m_pos points to and appends it to str.
+  bool ReadEntity(wxString &str);
+  //! Skips whitespace
+  void SkipSpace();
+  //! Does the data at m_pos start with str?
+  bool LookingAt(const wxChar *str) const;
+  //! Sets the error state
+  Token Fail();
+
+  const wxString &m_data;
+  wxString::const_iterator m_pos;
+  wxString::const_iterator m_end;
+  Token m_token;
+  wxString m_name;
+  wxString m_text;
+  wxArrayString m_attributeNames;
+  wxArrayString m_attributeValues;
+  //! The names of all elements that have been opened but not closed yet.
+  wxArrayString m_openElements;
+  //! True if the current start tag was an empty-element tag
+  bool m_emptyElement;
+  //! True if we read a compact frame instead of xml
+  bool m_compact;
+};
+
+#endif // XMLPULLPARSER_H
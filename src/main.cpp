@@ -32,6 +32,7 @@
 
 #include "wxMaxima.h"
 #include "Setup.h"
+#include "CellArena.h"
 
 // On wxGTK2 we support printing only if wxWidgets is compiled with gnome_print.
 // We have to force gnome_print support to be linked in static builds of wxMaxima.
@@ -71,6 +72,8 @@ bool MyApp::OnInit()
       { wxCMD_LINE_SWITCH, "h", "help", "show this help message", wxCMD_LINE_VAL_NONE},
       { wxCMD_LINE_OPTION, "o", "open", "open a file" },
       { wxCMD_LINE_SWITCH, "b", "batch","run the file and exit afterwards. Halts on questions and stops on errors." },
+      { wxCMD_LINE_OPTION, "s", "iostats","in batch mode: write the time each command took to this file as JSON" },
+      { wxCMD_LINE_OPTION, "m", "cellmemory","print the memory the cells of a file take and exit" },
 #if defined __WXMSW__
       { wxCMD_LINE_OPTION, "f", "ini", "open an input file" },
 #endif
@@ -161,12 +164,29 @@ bool MyApp::OnInit()
     batchmode = true;
   }
 
+  wxString cellMemoryFile;
+  if (cmdLineParser.Found(wxT("m"), &cellMemoryFile))
+  {
+    wxFileName FileName=cellMemoryFile;
+    FileName.MakeAbsolute();
+    ReportCellMemory(FileName.GetFullPath());
+    return false;
+  }
+
+  wxString ioStatisticsFile;
+  if (cmdLineParser.Found(wxT("s"), &ioStatisticsFile))
+  {
+    wxFileName FileName=ioStatisticsFile;
+    FileName.MakeAbsolute();
+    ioStatisticsFile = FileName.GetFullPath();
+  }
+
   if (cmdLineParser.Found(wxT("o"), &file))
     {
       wxFileName FileName=file;
       FileName.MakeAbsolute();
       wxString CanonicalFilename=FileName.GetFullPath();
-      NewWindow(wxString(CanonicalFilename),batchmode);
+      NewWindow(wxString(CanonicalFilename),batchmode,ioStatisticsFile);
       return true;
     }
   else
@@ -176,7 +196,7 @@ bool MyApp::OnInit()
 	  wxFileName FileName=cmdLineParser.GetParam();
 	  FileName.MakeAbsolute();
 	  wxString CanonicalFilename=FileName.GetFullPath();
-	  NewWindow(CanonicalFilename,batchmode);
+	  NewWindow(CanonicalFilename,batchmode,ioStatisticsFile);
 	}
       else
 	NewWindow();
@@ -184,11 +204,41 @@ bool MyApp::OnInit()
   return true;
 }
 
+void MyApp::ReportCellMemory(wxString file)
+{
+  if (!wxFileExists(file))
+  {
+    wxPrintf(wxT("File not found\n"));
+    return;
+  }
+
+  CellArena::EnableStatistics();
+
+  // The window is never shown and no maxima process is started for it.
+  m_frame = new wxMaxima((wxFrame *)NULL, -1, _("wxMaxima"), wxDefaultPosition);
+
+  long cellsBefore, bytesBefore;
+  CellArena::GetStatistics(cellsBefore, bytesBefore);
+  m_frame->OpenFile(file);
+  long cells, bytes;
+  CellArena::GetStatistics(cells, bytes);
+  cells -= cellsBefore;
+  bytes -= bytesBefore;
+
+  wxPrintf(wxT("cells: %ld\n"), cells);
+  wxPrintf(wxT("bytes in cell objects (without the text the cells contain): %ld\n"), bytes);
+  if (cells > 0)
+    wxPrintf(wxT("bytes per cell object: %.1f\n"), (double) bytes / cells);
+
+  m_frame->Destroy();
+  m_frame = NULL;
+}
+
 #if defined __WXMAC__
 int window_counter = 0;
 #endif
 
-void MyApp::NewWindow(wxString file,bool batchmode)
+void MyApp::NewWindow(wxString file,bool batchmode,wxString ioStatisticsFile)
 {
   int x = 40, y = 40, h = 650, w = 950, m = 0;
   int rs = 0;
@@ -234,6 +284,7 @@ void MyApp::NewWindow(wxString file,bool batchmode)
   }
 
   m_frame->SetBatchMode(batchmode);
+  m_frame->SetIOStatisticsFile(ioStatisticsFile);
 #if defined __WXMAC__
   topLevelWindows.Append(m_frame);
   if (topLevelWindows.GetCount()>1)
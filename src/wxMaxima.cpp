@@ -44,6 +44,9 @@
 #include "SlideShowCell.h"
 #include "PlotFormatWiz.h"
 #include "Dirstructure.h"
+#include "XmlPullParser.h"
+#include "LongOutputCell.h"
+#include "Image.h"
 
 #include <wx/clipbrd.h>
 #include <wx/filedlg.h>
@@ -101,6 +104,42 @@ void wxMaxima::ConfigChanged()
   m_autoSaveInterval = 0;
   config->Read(wxT("autoSaveInterval"), &m_autoSaveInterval);
   m_autoSaveInterval *= 60000;
+
+  m_pipelineEvaluation = false;
+  config->Read(wxT("pipelineEvaluation"), &m_pipelineEvaluation);
+
+  m_MParser.ReadConfig();
+
+  // The decoded images may take this many megabytes; the rest stays compressed.
+  int imageMemoryBudget = IMAGE_DEFAULT_MEMORY_BUDGET / (1024 * 1024);
+  config->Read(wxT("imageMemoryBudget"), &imageMemoryBudget);
+  if (imageMemoryBudget < 1)
+    imageMemoryBudget = 1;
+  Image::SetMemoryBudget((size_t) imageMemoryBudget * 1024 * 1024);
+
+  // All CellParsers that are created from now on use the new fonts and colors.
+  StyleSheet::Reload();
+
+  bool parseInBackground = true;
+  config->Read(wxT("parseInBackground"), &parseInBackground);
+  if (parseInBackground && (m_backgroundParser == NULL))
+  {
+    m_backgroundParser = new BackgroundParser(this, background_parser_id);
+    if (m_backgroundParser->Run() != wxTHREAD_NO_ERROR)
+    {
+      delete m_backgroundParser;
+      m_backgroundParser = NULL;
+    }
+  }
+  else if (!parseInBackground && (m_backgroundParser != NULL))
+  {
+    FlushBackgroundParser();
+    m_backgroundParser->Stop();
+    delete m_backgroundParser;
+    m_backgroundParser = NULL;
+  }
+  if (m_backgroundParser != NULL)
+    m_backgroundParser->CopySettings(m_MParser);
 }
 
 wxMaxima *MyApp::m_frame;
@@ -110,10 +149,12 @@ wxMaxima::wxMaxima(wxWindow *parent, int id, const wxString title,
   wxMaximaFrame(parent, id, title, pos, size)
 {
   wxConfig *config = (wxConfig *)wxConfig::Get();
+  m_backgroundParser = NULL;
   ConfigChanged();
   m_unsuccessfullConnectionAttempts = 0;
   m_saving = false;
   m_outputCellsFromCurrentCommand = 0;
+  m_firstPromptInFlight = -1;
   m_CWD = wxEmptyString;
   m_port = 4010;
   m_pid = -1;
@@ -181,6 +222,12 @@ wxMaxima::wxMaxima(wxWindow *parent, int id, const wxString title,
 
 wxMaxima::~wxMaxima()
 {
+  if (m_backgroundParser != NULL)
+  {
+    m_backgroundParser->Stop();
+    delete m_backgroundParser;
+  }
+
   if (m_client != NULL)
     m_client->Destroy();
 
@@ -310,19 +357,16 @@ void wxMaxima::ConsoleAppend(wxString s, int type)
     return ;
   }
 
-  // If we already have output more lines than we are allowed to we a inform the user
-  // about this and return.
-  if(m_outputCellsFromCurrentCommand++ == m_maxOutputCellsPerCommand)
-  {
-    DoRawConsoleAppend(_("... [suppressed additional lines since the output is longer than allowed in the configuration] "), MC_TYPE_ERROR);
-    return; 
-  };
+  // Output that exceeds the number of cells we are allowed to create for a
+  // command is collected as plain text and displayed by a single
+  // LongOutputCell that only draws the lines that are visible.
+  bool longOutput = false;
+  if (type == MC_TYPE_DEFAULT)
+    longOutput = (m_maxOutputCellsPerCommand >= 0) &&
+      (m_outputCellsFromCurrentCommand++ >= m_maxOutputCellsPerCommand);
+  else
+    FlushLongOutput();
 
-  // If we already have output more lines than we are allowed to and we already
-  // have informed the user about this we return immediately
-  if(m_outputCellsFromCurrentCommand > m_maxOutputCellsPerCommand)
-    return;
-  
   if (type != MC_TYPE_ERROR)
     StatusMaximaBusy(parsing);
 
@@ -331,12 +375,19 @@ void wxMaxima::ConsoleAppend(wxString s, int type)
     while (s.Length() > 0)
     {
       int start = s.Find(wxT("<mth"));
+      int frameStart = s.Find(XmlPullParser::CompactFrameStart);
+      bool compact = (frameStart != wxNOT_FOUND) &&
+        ((start == wxNOT_FOUND) || (frameStart < start));
+      if (compact)
+        start = frameStart;
 
       if (start == wxNOT_FOUND) {
         t = s;
         t.Trim();
         t.Trim(false);
-        if (t.Length())
+        if (longOutput)
+          m_longOutput += s;
+        else if (t.Length())
           DoRawConsoleAppend(s, MC_TYPE_DEFAULT);
         s = wxEmptyString;
       }
@@ -349,19 +400,37 @@ void wxMaxima::ConsoleAppend(wxString s, int type)
         wxString pre1(pre);
         pre1.Trim();
         pre1.Trim(false);
-        if (pre1.Length())
+        if (longOutput)
+          m_longOutput += pre;
+        else if (pre1.Length())
           DoRawConsoleAppend(pre, MC_TYPE_DEFAULT);
 
+        if (compact)
+        {
+          // A compact frame ends with the first ETX.
+          size_t end = s.find(XmlPullParser::CompactFrameEnd, start);
+          if (end == wxString::npos)
+            end = s.Length();
+          if (longOutput)
+            m_longOutput += LongOutputCell::XmlToText(s.SubString(start, end)) + wxT("\n");
+          else
+            DoConsoleAppend(s.SubString(start, end), type, false);
+          s = s.SubString(end + 1, s.Length());
+          continue;
+        }
+
         // If the math tag ends inside this string we add the whole tag.
         int end = s.Find(wxT("</mth>"));
         if (end == wxNOT_FOUND)
           end = s.Length();
         else
           end += 5;
-        wxString rest = s.SubString(start, end);
+        wxString rest = wxT("<span>") + s.SubString(start, end) + wxT("</span>");
 
-        DoConsoleAppend(wxT("<span>") + rest +
-                        wxT("</span>"), type, false);
+        if (longOutput)
+          m_longOutput += LongOutputCell::XmlToText(rest) + wxT("\n");
+        else
+          DoConsoleAppend(rest, type, false);
         s = s.SubString(end + 1, s.Length());
       }
     }
@@ -393,8 +462,26 @@ void wxMaxima::DoConsoleAppend(wxString s, int type, bool newLine,
 
   s.Replace(wxT("\n"), wxT(""), true);
 
-  cell = m_MParser.ParseLine(s, type);
+  // Math is parsed in the background. Everything else might influence what
+  // we do next and therefore is handled immediately.
+  if ((m_backgroundParser != NULL) && (type == MC_TYPE_DEFAULT))
+  {
+    m_backgroundParser->Parse(s, type, newLine, bigSkip,
+                              m_console->GetOutputArena());
+    return;
+  }
+
+  FlushBackgroundParser();
+  {
+    IOTimer timer(m_console->m_ioStatistics, IOStatistics::parse);
+    CellArena::Scope arena(m_console->GetOutputArena());
+    cell = m_MParser.ParseLine(s, type);
+  }
+  InsertParsedOutput(cell, newLine, bigSkip);
+}
 
+void wxMaxima::InsertParsedOutput(MathCell *cell, bool newLine, bool bigSkip)
+{
   if (cell == NULL)
   {
     wxMessageBox(_("There was an error in generated XML!\n\n"
@@ -407,9 +494,52 @@ void wxMaxima::DoConsoleAppend(wxString s, int type, bool newLine,
   m_console->InsertLine(cell, newLine || cell->BreakLineHere());
 }
 
+void wxMaxima::InsertBackgroundParserResult(ParserJob *job)
+{
+  // Images have to be loaded by the main thread.
+  if (!job->m_parseInBackground)
+  {
+    // The thread might be parsing the next job into the same arena.
+    m_backgroundParser->WaitUntilIdle();
+    wxLongLong start = IOStatistics::Now();
+    CellArena::Scope arena(m_console->GetOutputArena());
+    job->m_cell = m_MParser.ParseLine(job->m_xml, job->m_type);
+    job->m_parseTime = IOStatistics::Now() - start;
+  }
+  m_console->m_ioStatistics->AddTime(IOStatistics::parse, job->m_parseTime);
+
+  MathCell *cell = job->m_cell;
+  job->m_cell = NULL;
+  InsertParsedOutput(cell, job->m_newLine, job->m_bigSkip);
+  delete job;
+}
+
+void wxMaxima::OnBackgroundParserEvent(wxThreadEvent& event)
+{
+  if (m_backgroundParser == NULL)
+    return;
+
+  ParserJob *job;
+  while ((job = m_backgroundParser->GetResult()) != NULL)
+    InsertBackgroundParserResult(job);
+}
+
+void wxMaxima::FlushBackgroundParser()
+{
+  if (m_backgroundParser == NULL)
+    return;
+
+  ParserJob *job;
+  while ((job = m_backgroundParser->WaitForResult()) != NULL)
+    InsertBackgroundParserResult(job);
+}
+
 void wxMaxima::DoRawConsoleAppend(wxString s, int type)
 {
+  FlushBackgroundParser();
+
   bool scrollToCaret = (!m_console->FollowEvaluation()&&m_console->CaretVisibleIs());
+  CellArena::Scope arena(m_console->GetOutputArena());
 
   if (type == MC_TYPE_MAIN_PROMPT)
   {
@@ -448,6 +578,22 @@ void wxMaxima::DoRawConsoleAppend(wxString s, int type)
   if(scrollToCaret) m_console -> ScrollToCaret();
 }
 
+void wxMaxima::FlushLongOutput()
+{
+  m_longOutput.Trim();
+  m_longOutput.Trim(false);
+  if (m_longOutput.IsEmpty())
+    return;
+
+  FlushBackgroundParser();
+
+  CellArena::Scope arena(m_console->GetOutputArena());
+  LongOutputCell *cell = new LongOutputCell(m_longOutput);
+  cell->SetType(MC_TYPE_DEFAULT);
+  m_longOutput = wxEmptyString;
+  m_console->InsertLine(cell, true);
+}
+
 /*! Remove empty statements
  *
  * We need to remove any statement which would be considered empty
@@ -599,18 +745,22 @@ void wxMaxima::ClientEvent(wxSocketEvent& event)
       SanitizeSocketBuffer(buffer, read);
 
 #if wxUSE_UNICODE
-      m_currentOutput += wxString(buffer, wxConvUTF8);
+      // A multibyte character might be split between two packets => the
+      // buffer keeps the start of such a character until the rest arrives.
+      m_currentOutput.AppendUTF8(buffer, read);
 #else
-      m_currentOutput += wxString(buffer, *wxConvCurrent);
+      m_currentOutput.Append(wxString(buffer, *wxConvCurrent));
 #endif
+      m_console->m_ioStatistics->AddWakeup();
+      m_console->m_ioStatistics->AddBytes(read);
 
       if (!m_dispReadOut &&
-	  (m_currentOutput != wxT("\n")) &&
-	  (m_currentOutput != wxT("<wxxml-symbols></wxxml-symbols>"))) {
+	  (!m_currentOutput.IsSameAs(wxT("\n"))) &&
+	  (!m_currentOutput.IsSameAs(wxT("<wxxml-symbols></wxxml-symbols>")))) {
 	StatusMaximaBusy(transferring);
         m_dispReadOut = true;
       }
-      if (m_first && m_currentOutput.Find(m_firstPrompt) > -1)
+      if (m_first && m_currentOutput.Find(m_firstPrompt) != wxNOT_FOUND)
       {
         ReadFirstPrompt(m_currentOutput);
         if(m_batchmode)
@@ -630,6 +780,11 @@ void wxMaxima::ClientEvent(wxSocketEvent& event)
     break;
 
   case wxSOCKET_LOST:
+    FlushLongOutput();
+    FlushBackgroundParser();
+    m_console->FlushOutput();
+    m_commandsInFlight.Clear();
+    m_console->m_ioStatistics->CommandsAborted();
     m_console->m_evaluationQueue->Clear();
     // Inform the user that the evaluation queue is empty.
     EvaluationQueueLength(0);
@@ -770,6 +925,8 @@ bool wxMaxima::StartMaxima()
 
   m_console->QuestionAnswered();
   m_console->SetWorkingGroup(NULL);
+  m_commandsInFlight.Clear();
+  m_console->m_ioStatistics->CommandsAborted();
 
   m_variablesOK = false;
   wxString command = GetCommand();;
@@ -871,8 +1028,9 @@ void wxMaxima::CleanUp()
 ///  Dealing with stuff read from the socket
 ///--------------------------------------------------------------------------------
 
-void wxMaxima::ReadFirstPrompt(wxString &data)
+void wxMaxima::ReadFirstPrompt(MaximaOutputBuffer &output)
 {
+  wxString data = output.GetString();
 #if defined(__WXMSW__)
   int start = data.Find(wxT("Maxima"));
   if (start == wxNOT_FOUND)
@@ -899,7 +1057,7 @@ void wxMaxima::ReadFirstPrompt(wxString &data)
   m_inLispMode = false;
   StatusMaximaBusy(waiting);
   m_closing = false; // when restarting maxima this is temporarily true
-  data = wxEmptyString;
+  output.Clear();
   m_console->EnableEdit(true);
 
   if (m_openFile.Length())
@@ -921,7 +1079,7 @@ void wxMaxima::ReadFirstPrompt(wxString &data)
 /***
  * Checks if maxima displayed a new chunk of math
  */
-void wxMaxima::ReadMath(wxString &data)
+void wxMaxima::ReadMath(MaximaOutputBuffer &data)
 {
 
   // Skip all data before the last prompt in the data string.
@@ -952,7 +1110,12 @@ void wxMaxima::ReadMath(wxString &data)
         bool abortOnError = true;
         wxConfig::Get()->Read(wxT("abortOnError"), &abortOnError);
         if(abortOnError || m_batchmode)
+        {
           m_console->m_evaluationQueue->Clear();
+          // The guards in front of the commands we have sent after the failed
+          // one make maxima skip them => They won't get a prompt.
+          SkipCommandsInFlight(1);
+        }
         SetBatchMode(false);
         // Inform the user that the evaluation queue is empty.
         EvaluationQueueLength(0);
@@ -964,28 +1127,65 @@ void wxMaxima::ReadMath(wxString &data)
     if(normalOutput!=wxEmptyString)
       ConsoleAppend(normalOutput, MC_TYPE_DEFAULT);
 
-    data = data.SubString(end + m_promptPrefix.Length(),
-                                                data.Length());
+    data.Consume(end + m_promptPrefix.Length());
   }
   
   // If we did find a prompt in the last step we leave this function again.
   if (m_readingPrompt)
     return ;
 
-  // Append everything untill the "end of math" marker to the console.
+  // Append everything untill the "end of math" marker or the end of a
+  // compact frame to the console.
   wxString mth = wxT("</mth>");
-  end = data.Find(mth);
-  while (end > -1)
+  wxString frameStart(XmlPullParser::CompactFrameStart);
+  while (true)
   {
-    wxString o = data.Left(end);
-    ConsoleAppend(o + mth, MC_TYPE_DEFAULT);
-    data = data.SubString(end + mth.Length(),
-                          data.Length());
     end = data.Find(mth);
+    int start = data.Find(frameStart);
+    if ((start != wxNOT_FOUND) && ((end == wxNOT_FOUND) || (start < end)))
+    {
+      int frameEnd = FindCompactFrameEnd(data, start);
+      if (frameEnd == wxNOT_FOUND)
+        break;
+      wxString o = data.Left(frameEnd + 1);
+      data.Consume(frameEnd + 1);
+      ConsoleAppend(o, MC_TYPE_DEFAULT);
+    }
+    else if (end != wxNOT_FOUND)
+    {
+      wxString o = data.Left(end);
+      data.Consume(end + mth.Length());
+      ConsoleAppend(o + mth, MC_TYPE_DEFAULT);
+    }
+    else
+      break;
   }
 }
 
-void wxMaxima::ReadLoadSymbols(wxString &data)
+int wxMaxima::FindCompactFrameEnd(MaximaOutputBuffer &data, int start)
+{
+  // The header tells us where the frame ends so we don't need to search
+  // for the end marker.
+  wxString header = data.Mid(start + 1, 21);
+  int colon = header.Find(wxT(':'));
+  if ((colon == wxNOT_FOUND) && (header.Length() < 21))
+    return wxNOT_FOUND;
+  unsigned long length;
+  if ((colon != wxNOT_FOUND) && header.Left(colon).ToULong(&length))
+  {
+    size_t end = start + colon + 2 + length;
+    if (end >= data.Length())
+      return wxNOT_FOUND;
+    if (data.Mid(end, 1) == wxString(XmlPullParser::CompactFrameEnd))
+      return end;
+  }
+
+  // Maxima counts characters that are encoded as surrogate pairs on MSW only
+  // once => fall back to searching for the end marker.
+  return data.Find(wxString(XmlPullParser::CompactFrameEnd), start);
+}
+
+void wxMaxima::ReadLoadSymbols(MaximaOutputBuffer &data)
 {
   int start;
   while ((start = data.Find(wxT("<wxxml-symbols>"))) != wxNOT_FOUND)
@@ -994,11 +1194,10 @@ void wxMaxima::ReadLoadSymbols(wxString &data)
     if (end != wxNOT_FOUND)
     {
       // Put the symbols into a separate string
-      wxString symbols = data.SubString(start + 15, end - 1);
+      wxString symbols = data.Mid(start + 15, end - start - 15);
 
       // Remove the symbols from the data string
-      data = data.SubString(0, start-1) +
-        data.SubString(end + 16, data.Length());
+      data.Remove(start, end + 16 - start);
 
       // Send each symbol to the console
       wxStringTokenizer templates(symbols, wxT("$"));
@@ -1013,7 +1212,7 @@ void wxMaxima::ReadLoadSymbols(wxString &data)
 /***
  * Checks if maxima displayed a new prompt.
  */
-void wxMaxima::ReadPrompt(wxString &data)
+void wxMaxima::ReadPrompt(MaximaOutputBuffer &data)
 {
   // If we got a prompt our connection to maxima was successful. 
   m_unsuccessfullConnectionAttempts = 0;
@@ -1022,6 +1221,11 @@ void wxMaxima::ReadPrompt(wxString &data)
   int end = data.Find(m_promptSuffix);
   if (end > -1)
   {
+    // All output that belongs to the last command has to be in place
+    // before we advance the evaluation queue.
+    FlushLongOutput();
+    FlushBackgroundParser();
+    m_console->FlushOutput();
     m_readingPrompt = false;
     wxString o = data.Left(end);
     if (o != wxT("\n") && o.Length())
@@ -1034,12 +1238,49 @@ void wxMaxima::ReadPrompt(wxString &data)
         //m_lastPrompt = o.Mid(1,o.Length()-1);
         //m_lastPrompt.Replace(wxT(")"), wxT(":"), false);
         m_lastPrompt = o;
-        // remove the event maxima has just processed from the evaluation queue
-        m_console->m_evaluationQueue->RemoveFirst();
+
+        // Normally the prompt follows the oldest command in flight. But if
+        // maxima has finished more commands without displaying a prompt the
+        // label tells us so.
+        size_t finished = 1;
+        long number = GetPromptNumber(o);
+        if((number >= 0) && (m_firstPromptInFlight >= 0) &&
+           (number > m_firstPromptInFlight) &&
+           (number - m_firstPromptInFlight < (long) m_commandsInFlight.GetCount()))
+          finished = number - m_firstPromptInFlight + 1;
+
+        // remove the commands maxima has just processed from the evaluation queue.
+        // If the queue has been cleared while they were running the prompt
+        // doesn't belong to any command in the queue.
+        GroupCell *evaluated = m_console->m_evaluationQueue->GetCell();
+        for(size_t i = 0; i < finished; i++)
+        {
+          if(m_console->m_evaluationQueue->CommandsSent() > 0)
+            m_console->m_evaluationQueue->RemoveFirst();
+          if(!m_commandsInFlight.IsEmpty())
+          {
+            m_commandsInFlight.RemoveAt(0);
+            m_console->m_ioStatistics->PromptReceived();
+          }
+        }
+        // The prompts of the commands that are still in flight follow this one.
+        if(number >= 0)
+          m_firstPromptInFlight = number + 1;
+        else
+          m_firstPromptInFlight = -1;
+        // Only the queue markers of the cell maxima has evaluated and of the
+        // cell it evaluates next might have changed.
+        m_console->RefreshGroup(evaluated);
+        m_console->RefreshGroup(m_console->m_evaluationQueue->GetCell());
         // if we remove a command from the evaluation queue the next output line will be the
         // first from the next command.
         m_outputCellsFromCurrentCommand = 0;
-        if (m_console->m_evaluationQueue->Empty()) { // queue empty?
+        if (!m_commandsInFlight.IsEmpty())
+        {
+          // Maxima still works on commands we have sent together with this one.
+          m_ready = false;
+        }
+        else if (m_console->m_evaluationQueue->Empty()) { // queue empty?
           StatusMaximaBusy(waiting);
           if(m_console->FollowEvaluation())
           {
@@ -1064,17 +1305,17 @@ void wxMaxima::ReadPrompt(wxString &data)
           if(m_batchmode)
           {
             SaveFile(false);
+            if(m_ioStatisticsFile != wxEmptyString)
+              m_console->m_ioStatistics->WriteJSON(m_ioStatisticsFile);
             wxCloseEvent *closeEvent;
             closeEvent = new wxCloseEvent();
             GetEventHandler()->QueueEvent(closeEvent);
           }
           // Inform the user that the evaluation queue is empty.
           EvaluationQueueLength(0);
-          m_console->Refresh();
         }
         else { // we don't have an empty queue
           m_ready = false;
-          m_console->Refresh();
           m_console->EnableEdit();
           StatusMaximaBusy(calculating);
           TryEvaluateNextInQueue();
@@ -1082,7 +1323,7 @@ void wxMaxima::ReadPrompt(wxString &data)
 
         m_console->EnableEdit();
 
-        if (m_console->m_evaluationQueue->Empty())
+        if (m_commandsInFlight.IsEmpty() && (m_console->m_evaluationQueue->Empty()))
         {
           bool open = false;
           wxConfig::Get()->Read(wxT("openHCaret"), &open);
@@ -1093,18 +1334,32 @@ void wxMaxima::ReadPrompt(wxString &data)
 
       // We have a question
       else {
-        m_console->QuestionAnswered();
-        m_console->QuestionPending(true);
+        // If we have sent more commands maxima reads the answer from the
+        // command that follows the one that has asked the question.
+        bool answered = (m_commandsInFlight.GetCount() > 1);
+        if(!answered)
+        {
+          m_console->QuestionAnswered();
+          m_console->QuestionPending(true);
+        }
         if (o.Find(wxT("<mth>")) > -1)
           DoConsoleAppend(o, MC_TYPE_PROMPT);
         else
           DoRawConsoleAppend(o, MC_TYPE_PROMPT);
-	if(m_console->ScrolledAwayFromEvaluation())
+        if(answered)
+        {
+          DropCommandsInFlight(1, 1);
+          m_ready = false;
+        }
+        else
         {
-          if(m_console->m_mainToolBar)
-            m_console->m_mainToolBar->EnableTool(ToolBar::tb_follow,true);
+          if(m_console->ScrolledAwayFromEvaluation())
+          {
+            if(m_console->m_mainToolBar)
+              m_console->m_mainToolBar->EnableTool(ToolBar::tb_follow,true);
+          }
+          StatusMaximaBusy(userinput);
         }
-        StatusMaximaBusy(userinput);
       }
 
       if (o.StartsWith(wxT("\nMAXIMA>")))
@@ -1122,8 +1377,7 @@ void wxMaxima::ReadPrompt(wxString &data)
       }
     }
     
-    data = data.SubString(end + m_promptSuffix.Length(),
-                          data.Length());
+    data.Consume(end + m_promptSuffix.Length());
   }
 }
 
@@ -1258,12 +1512,22 @@ bool wxMaxima::OpenWXMXFile(wxString file, MathCtrl *document, bool clearDocumen
   document->Freeze();
 
   // open wxmx file
-  wxXmlDocument xmldoc;
+  wxString contents;
 
   wxFileSystem fs;
   wxFSFile *fsfile = fs.OpenFile(wxT("file:") + file + wxT("#zip:content.xml"));
 
-  if ((fsfile == NULL) || (!xmldoc.Load(*(fsfile->GetStream())))) {
+  if (fsfile != NULL)
+  {
+    // The cells are created while reading through the xml so we don't need
+    // to build a wxXmlDocument first.
+    wxStringOutputStream contentsStream(&contents);
+    contentsStream.Write(*(fsfile->GetStream()));
+  }
+
+  XmlPullParser xml(contents);
+
+  if ((fsfile == NULL) || (xml.Next() != XmlPullParser::StartTag)) {
     wxEndBusyCursor();
     document->Thaw();
     delete fsfile;
@@ -1277,7 +1541,7 @@ bool wxMaxima::OpenWXMXFile(wxString file, MathCtrl *document, bool clearDocumen
   delete fsfile;
 
   // start processing the XML file
-  if (xmldoc.GetRoot()->GetName() != wxT("wxMaximaDocument")) {
+  if (xml.GetName() != wxT("wxMaximaDocument")) {
     wxEndBusyCursor();
     document->Thaw();
     wxMessageBox(_("wxMaxima encountered an error loading ") + file, _("Error"),
@@ -1288,8 +1552,8 @@ bool wxMaxima::OpenWXMXFile(wxString file, MathCtrl *document, bool clearDocumen
   }
 
   // read document version and complain
-  wxString docversion = xmldoc.GetRoot()->GetAttribute(wxT("version"), wxT("1.0"));
-  wxString ActiveCellNumber_String = xmldoc.GetRoot()->GetAttribute(wxT("activecell"), wxT("-1"));
+  wxString docversion = xml.GetAttribute(wxT("version"), wxT("1.0"));
+  wxString ActiveCellNumber_String = xml.GetAttribute(wxT("activecell"), wxT("-1"));
   long ActiveCellNumber;
   if(!ActiveCellNumber_String.ToLong(&ActiveCellNumber))
     ActiveCellNumber = -1;
@@ -1319,9 +1583,22 @@ bool wxMaxima::OpenWXMXFile(wxString file, MathCtrl *document, bool clearDocumen
   }
 
   // read zoom factor
-  wxString doczoom = xmldoc.GetRoot()->GetAttribute(wxT("zoom"),wxT("100"));
-  wxXmlNode *xmlcells = xmldoc.GetRoot()->GetChildren();
-  GroupCell *tree = CreateTreeFromXMLNode(xmlcells, file);
+  wxString doczoom = xml.GetAttribute(wxT("zoom"),wxT("100"));
+  xml.Next();
+  GroupCell *tree = CreateTreeFromXML(xml, file);
+  xml.FinishElement();
+
+  // The xml is broken.
+  if (xml.GetToken() != XmlPullParser::EndOfDocument) {
+    document->DestroyTree(tree);
+    wxEndBusyCursor();
+    document->Thaw();
+    wxMessageBox(_("wxMaxima encountered an error loading ") + file, _("Error"),
+                 wxOK | wxICON_EXCLAMATION);
+    StatusMaximaBusy(waiting);
+    SetStatusText(_("File could not be opened"), 1);
+    return false;
+  }
 
   // from here on code is identical for wxm and wxmx
   if (clearDocument) {
@@ -1373,7 +1650,7 @@ bool wxMaxima::OpenWXMXFile(wxString file, MathCtrl *document, bool clearDocumen
   return true;
 }
 
-GroupCell* wxMaxima::CreateTreeFromXMLNode(wxXmlNode *xmlcells, wxString wxmxfilename)
+GroupCell* wxMaxima::CreateTreeFromXML(XmlPullParser &xml, wxString wxmxfilename)
 {
   MathParser mp(wxmxfilename);
   MathCell *tree = NULL;
@@ -1381,25 +1658,25 @@ GroupCell* wxMaxima::CreateTreeFromXMLNode(wxXmlNode *xmlcells, wxString wxmxfil
 
   bool warning = true;
 
-  if (xmlcells) {
-    last = tree = mp.ParseTag(xmlcells, false); // first cell
-    while (xmlcells->GetNext()) {
-      xmlcells = xmlcells->GetNext();
-      MathCell *cell = mp.ParseTag(xmlcells, false);
+  while (xml.AtNode()) {
+    MathCell *cell = mp.ParseTag(xml, false);
 
-      if (cell != NULL)
+    if (cell != NULL)
+    {
+      if (tree == NULL)
+        tree = cell;
+      else
       {
         last->m_next = last->m_nextToDraw = cell;
         last->m_next->m_previous = last->m_next->m_previousToDraw = last;
-
-        last = last->m_next;
-      }
-      else if (warning)
-      {
-        wxMessageBox(_("Parts of the document will not be loaded correctly!"), _("Warning"),
-                     wxOK | wxICON_WARNING);
-        warning = false;
       }
+      last = cell;
+    }
+    else if (warning)
+    {
+      wxMessageBox(_("Parts of the document will not be loaded correctly!"), _("Warning"),
+                   wxOK | wxICON_WARNING);
+      warning = false;
     }
   }
 
@@ -1600,7 +1877,7 @@ GroupCell* wxMaxima::CreateTreeFromWXMCode(wxArrayString* wxmLines)
 /***
  * This works only for gcl by default - other lisps have different prompts.
  */
-void wxMaxima::ReadLispError(wxString &data)
+void wxMaxima::ReadLispError(MaximaOutputBuffer &data)
 {
   static const wxString lispError = wxT("dbl:MAXIMA>>"); // gcl
   int end = data.Find(lispError);
@@ -1611,7 +1888,10 @@ void wxMaxima::ReadLispError(wxString &data)
     wxString o = data.Left(end);
     ConsoleAppend(o, MC_TYPE_DEFAULT);
     ConsoleAppend(lispError, MC_TYPE_ERROR);
-    data = wxEmptyString;
+    data.Consume(data.Length());
+    // The lisp debugger reads the commands we have sent after the one that
+    // has caused the error.
+    DropCommandsInFlight(1, m_commandsInFlight.GetCount());
 
     bool abortOnError = false;
     wxConfig::Get()->Read(wxT("abortOnError"), &abortOnError);
@@ -1705,6 +1985,13 @@ void wxMaxima::SetupVariables()
              wxT("/share/wxMaxima/wxmathml\")"));
 #endif
 
+#if wxUSE_UNICODE
+  // Offer wxmathml.lisp to send math as compact frames instead of xml. If it
+  // is too old to know about them it declines and continues sending xml
+  // that we understand as well.
+  SendMaxima(wxT(":lisp-quiet (if (fboundp 'wx-offer-framing) (wx-offer-framing \"compact\" \"xml\"))"));
+#endif
+
   if (m_currentFile != wxEmptyString)
   {
     wxString filename(m_currentFile);
@@ -2121,7 +2408,7 @@ void wxMaxima::UpdateMenus(wxUpdateUIEvent& event)
   menubar->Enable(menu_save_id, (!m_fileSaved)&&(!m_saving));
   menubar->Enable(menu_export_html, !m_saving);
 
-  for (int id = menu_pane_math; id<=menu_pane_format; id++)
+  for (int id = menu_pane_math; id<=menu_pane_diagnostics; id++)
     menubar->Check(id, IsPaneDisplayed(static_cast<Event>(id)));
   if (GetToolBar() != NULL)
   {
@@ -2704,10 +2991,10 @@ void wxMaxima::EditMenu(wxCommandEvent& event)
       configW->WriteSettings();
       // Write the changes in the configuration to the disk.
       config->Flush();
+      ConfigChanged();
       // Refresh the display as the settings that affect it might have changed.
       m_console->RecalculateForce();
       m_console->Refresh();
-      ConfigChanged();
     }
 
     configW->Destroy();
@@ -2962,6 +3249,12 @@ void wxMaxima::MaximaMenu(wxCommandEvent& event)
   {
   case menu_triggerEvaluation:
     m_console->QuestionAnswered();
+    // Maxima already has got the commands we are waiting for => we don't
+    // send them again but continue with the ones that follow them.
+    while(m_console->m_evaluationQueue->CommandsSent() > 0)
+      m_console->m_evaluationQueue->RemoveFirst();
+    m_commandsInFlight.Clear();
+    m_console->m_ioStatistics->CommandsAborted();
     TryEvaluateNextInQueue();
     break;
   case ToolBar::menu_restart_id:
@@ -5025,9 +5318,6 @@ void wxMaxima::TryEvaluateNextInQueue()
     m_maximaStdoutPollTimer.Stop();
     // Inform the user that the evaluation queue length now is 0.
     EvaluationQueueLength(0);
-    // The cell from the last evaluation might still be shown in it's "evaluating" state
-    // so let's refresh the console to update the display of this.
-    m_console->Refresh();
     return; //empty queue
   }
 
@@ -5039,6 +5329,11 @@ void wxMaxima::TryEvaluateNextInQueue()
   if(m_console->QuestionPending())
     return;
 
+  // If maxima still works on commands we have sent in one go we will
+  // be called again as soon as it has finished them.
+  if(!m_commandsInFlight.IsEmpty())
+    return;
+
   // Maxima is connected and the queue contains an item.
 
   // From now on we look every second if we got some output from a crashing
@@ -5071,7 +5366,46 @@ void wxMaxima::TryEvaluateNextInQueue()
       
       m_console->SetWorkingGroup(tmp);
       tmp->GetPrompt()->SetValue(m_lastPrompt);
+
+      // Maxima reads its input line by line so we can hand it the commands that
+      // follow without waiting for it to finish the current one first. This
+      // saves one round trip to maxima per command. Commands that have been
+      // sent cannot be recalled any more if one of them fails => if an error
+      // is to abort the evaluation each of them is preceded by a guard that
+      // makes maxima skip it if a command in front of it has failed.
+      bool abortOnError = true;
+      wxConfig::Get()->Read(wxT("abortOnError"), &abortOnError);
+      bool pipeline = m_pipelineEvaluation && !m_inLispMode;
+      bool guarded = abortOnError || m_batchmode;
+      if(pipeline && guarded)
+        SendMaxima(wxT(":lisp-quiet (wx-batch-start)"), false);
+
       SendMaxima(text, true);
+      m_console->m_ioStatistics->CommandSent(text);
+      m_commandsInFlight.Add(text);
+      m_firstPromptInFlight = GetPromptNumber(m_lastPrompt);
+      if(m_firstPromptInFlight >= 0)
+        m_firstPromptInFlight++;
+
+      if(pipeline)
+      {
+        while(m_commandsInFlight.GetCount() < MAX_COMMANDS_IN_FLIGHT)
+        {
+          wxString next = m_console->m_evaluationQueue->GetCommand(m_commandsInFlight.GetCount());
+          next.Trim(true);
+          next.Trim(false);
+          if((next == wxEmptyString) || (next == wxT(";")) || (next == wxT("$")) ||
+             (next.StartsWith(wxT(":lisp"))) ||
+             (!next.EndsWith(wxT(";")) && !next.EndsWith(wxT("$"))))
+            break;
+          if(guarded)
+            SendMaxima(wxT(":lisp-quiet (wx-batch-guard)"), false);
+          SendMaxima(next, true);
+          m_console->m_ioStatistics->CommandSent(next);
+          m_commandsInFlight.Add(next);
+        }
+      }
+      m_console->m_evaluationQueue->SetCommandsSent(m_commandsInFlight.GetCount());
     }
     else
     {
@@ -5087,7 +5421,7 @@ void wxMaxima::TryEvaluateNextInQueue()
         
       m_console->SetWorkingGroup(NULL);
       m_console->Recalculate();
-      m_console->Refresh();
+      m_console->RefreshGroup(tmp);
       bool abortOnError = false;
       wxConfig::Get()->Read(wxT("abortOnError"), &abortOnError);
       SetBatchMode(false);
@@ -5097,10 +5431,12 @@ void wxMaxima::TryEvaluateNextInQueue()
       {
         m_console->m_evaluationQueue->Clear();
         StatusMaximaBusy(waiting);
+        m_console->Refresh();
       }
       else
       {
         m_console->m_evaluationQueue->RemoveFirst();
+        m_console->RefreshGroup(m_console->m_evaluationQueue->GetCell());
         m_outputCellsFromCurrentCommand = 0;
         TryEvaluateNextInQueue();
       }
@@ -5109,11 +5445,51 @@ void wxMaxima::TryEvaluateNextInQueue()
   else
   {
     m_console->m_evaluationQueue->RemoveFirst();
+    m_console->RefreshGroup(tmp);
+    m_console->RefreshGroup(m_console->m_evaluationQueue->GetCell());
     m_outputCellsFromCurrentCommand = 0;
     TryEvaluateNextInQueue();
   }
 }
 
+void wxMaxima::DropCommandsInFlight(size_t index, size_t count)
+{
+  while((count > 0) && (index < m_commandsInFlight.GetCount()))
+  {
+    ConsoleAppend(wxString::Format(_("Maxima has read \"%s\" as input to a question or to the lisp debugger. It therefore hasn't been evaluated."),
+                                   m_commandsInFlight[index]),
+                  MC_TYPE_ERROR);
+    m_commandsInFlight.RemoveAt(index);
+    m_console->m_evaluationQueue->RemoveSentCommand(index);
+    m_console->m_ioStatistics->PromptReceived(index);
+    count--;
+  }
+}
+
+void wxMaxima::SkipCommandsInFlight(size_t index)
+{
+  while(index < m_commandsInFlight.GetCount())
+  {
+    m_commandsInFlight.RemoveAt(index);
+    m_console->m_evaluationQueue->RemoveSentCommand(index);
+    m_console->m_ioStatistics->PromptReceived(index);
+  }
+}
+
+long wxMaxima::GetPromptNumber(wxString prompt)
+{
+  prompt.Trim(true);
+  if(prompt.EndsWith(wxT(")")))
+    prompt = prompt.Left(prompt.Length() - 1);
+  size_t start = prompt.Length();
+  while((start > 0) && wxIsdigit(prompt[start - 1]))
+    start--;
+  long number;
+  if(!prompt.Mid(start).ToLong(&number))
+    return -1;
+  return number;
+}
+
 void wxMaxima::InsertMenu(wxCommandEvent& event)
 {
   if(event.GetEventType() != (wxEVT_MENU))
@@ -5300,9 +5676,7 @@ void wxMaxima::SliderEvent(wxScrollEvent &ev)
   {
     cell->SetDisplayedIndex(ev.GetPosition());
 
-    wxRect rect = cell->GetRect();
-    m_console->CalcScrolledPosition(rect.x, rect.y, &rect.x, &rect.y);
-    m_console->RefreshRect(rect);
+    m_console->RefreshCell(cell);
   }
 }
 
@@ -5665,6 +6039,7 @@ EVT_TOOL(ToolBar::tb_find, wxMaxima::EditMenu)
 EVT_TOOL(ToolBar::tb_follow,wxMaxima::OnFollow)
 EVT_SOCKET(socket_server_id, wxMaxima::ServerEvent)
 EVT_SOCKET(socket_client_id, wxMaxima::ClientEvent)
+EVT_THREAD(background_parser_id, wxMaxima::OnBackgroundParserEvent)
 /* These commands somehow caused the menu to be updated six times on every
    keypress and the tool bar to be updated six times on every menu update
 
@@ -5691,6 +6066,7 @@ EVT_UPDATE_UI(menu_pane_stats, wxMaxima::UpdateMenus)
 EVT_UPDATE_UI(menu_pane_history, wxMaxima::UpdateMenus)
 EVT_UPDATE_UI(menu_pane_structure, wxMaxima::UpdateMenus)
 EVT_UPDATE_UI(menu_pane_format, wxMaxima::UpdateMenus)
+EVT_UPDATE_UI(menu_pane_diagnostics, wxMaxima::UpdateMenus)
 EVT_UPDATE_UI(menu_remove_output, wxMaxima::UpdateMenus)
 #if defined (__WXMSW__) || defined (__WXGTK20__) || defined (__WXMAC__)
 EVT_UPDATE_UI(ToolBar::tb_print, wxMaxima::UpdateToolBar)
@@ -24,6 +24,8 @@
 
 #include "wxMaximaFrame.h"
 #include "MathParser.h"
+#include "MaximaOutputBuffer.h"
+#include "BackgroundParser.h"
 
 #include <wx/socket.h>
 #include <wx/config.h>
@@ -40,6 +42,8 @@
 #include <wx/html/helpctrl.h>
 
 #define SOCKET_SIZE 1024
+//! The maximum number of commands that are sent to maxima without waiting for their prompts
+#define MAX_COMMANDS_IN_FLIGHT 50
 #define DOCUMENT_VERSION_MAJOR 1
 /*! The part of the .wxmx format version number that appears after the dot.
   
@@ -121,6 +125,11 @@ public:
   {
     m_batchmode = batch;
   }
+  //! The file the I/O statistics are written to when batch mode has finished
+  void SetIOStatisticsFile(wxString file)
+  {
+    m_ioStatisticsFile = file;
+  }
   void StripComments(wxString& s);
   void SendMaxima(wxString s, bool history = false);
   void OpenFile(wxString file,
@@ -132,12 +141,33 @@ private:
   int m_outputCellsFromCurrentCommand;
   //! The maximum number of lines per command we will display 
   int m_maxOutputCellsPerCommand;
+  /*! The output that exceeded m_maxOutputCellsPerCommand as plain text
+
+    Is displayed by a LongOutputCell as soon as FlushLongOutput() is called.
+   */
+  wxString m_longOutput;
+  /*! Send all commands of a cell to maxima at once?
+
+    If this is false or if evaluation is to be aborted on errors we wait for
+    the prompt that follows each command before sending the next one.
+   */
+  bool m_pipelineEvaluation;
+  //! The commands we have sent to maxima but didn't get a prompt for yet, the oldest first
+  wxArrayString m_commandsInFlight;
+  /*! The number in the input label of the prompt that follows the oldest command in flight
+
+    The prompts that follow the other commands are expected to be numbered
+    consecutively. -1 means: Unknown.
+   */
+  long m_firstPromptInFlight;
   //! The number of consecutive unsucessfull attempts to connect to the maxima server
   int m_unsuccessfullConnectionAttempts;
   //! The current working directory maxima's file I/O is relative to.
   wxString m_CWD;
   //! Are we in batch mode?
   bool m_batchmode;
+  //! The file SetIOStatisticsFile() has set
+  wxString m_ioStatisticsFile;
   //! Can we display the "ready" prompt right now?
   bool m_ready;
   /*! A human-readable presentation of eventual unmatched-parenthesis type errors
@@ -204,14 +234,34 @@ protected:
   /*! Is triggered on Input or disconnect from maxima
 
     The data we get from maxima is split into small packets we append to m_currentOutput 
-    until we got a full line we can display.
+    until we got a full line we can display. m_currentOutput remembers how far it has
+    already been searched for each marker so long outputs don't need to be scanned
+    over and over again.
    */
   void ClientEvent(wxSocketEvent& event);
 
   void ConsoleAppend(wxString s, int type);        //!< append maxima output to console
+  /*! Parses xml output from maxima and appends it to the console
+
+    Math is handed over to m_backgroundParser, if there is one.
+   */
   void DoConsoleAppend(wxString s, int type,       //
                        bool newLine = true, bool bigSkip = true);
   void DoRawConsoleAppend(wxString s, int type);   //
+  //! Appends the collected m_longOutput to the console as a LongOutputCell
+  void FlushLongOutput();
+  //! Appends the cells a parser has generated to the console
+  void InsertParsedOutput(MathCell *cell, bool newLine, bool bigSkip);
+  //! Appends the output m_backgroundParser has finished parsing to the console
+  void InsertBackgroundParserResult(ParserJob *job);
+  //! Is triggered when m_backgroundParser has finished parsing a chunk of output
+  void OnBackgroundParserEvent(wxThreadEvent& event);
+  /*! Waits until m_backgroundParser has parsed all output and appends it to the console
+
+    Needs to be called before anything that isn't handled by the background parser
+    is appended to the console or the order of the output would be mixed up.
+   */
+  void FlushBackgroundParser();
 
   /*! Spawn the "configure" menu.
 
@@ -231,6 +281,25 @@ protected:
 
   //! Try to evaluate the next command for maxima that is in the evaluation queue
   void TryEvaluateNextInQueue();
+  /*! Forgets about commands in flight maxima has read as input to something else
+
+    If maxima asks a question or enters the lisp debugger it reads the answer
+    from the commands we have sent after the current one. These commands are
+    removed from the evaluation queue and the user is informed that they haven't
+    been evaluated.
+    \param index The index of the first of these commands in m_commandsInFlight
+    \param count The number of commands
+   */
+  void DropCommandsInFlight(size_t index, size_t count);
+  /*! Forgets about the commands in flight maxima has been told to skip
+
+    If an error aborts the evaluation the guards we have sent in front of
+    the commands that follow the failed one make maxima skip them.
+    \param index The index of the first of these commands in m_commandsInFlight
+   */
+  void SkipCommandsInFlight(size_t index);
+  //! The number in the input label of a main prompt like "(%i12) " or -1
+  static long GetPromptNumber(wxString prompt);
   //! Trigger execution of the evaluation queue
   void TriggerEvaluation();
   void TryUpdateInspector();
@@ -252,21 +321,27 @@ protected:
      - it discards all data until this point
      - and it prepares the worksheet for editing.
 
-     \param data The string ReadFirstPrompt() does read its data from. 
+     \param data The buffer ReadFirstPrompt() does read its data from.
                   After leaving this function data is empty again.
    */
-  void ReadFirstPrompt(wxString &data);
+  void ReadFirstPrompt(MaximaOutputBuffer &data);
   /* Reads the input and the output prompt from Maxima.
    */
-  void ReadPrompt(wxString &data);
+  void ReadPrompt(MaximaOutputBuffer &data);
   /* Reads the math cell's contents from Maxima.
      
      Math cells are enclosed between the tags \<mth\> and \</mth\>. If we 
    */
-  void ReadMath(wxString &data);                   //!< reads the math that is contained in data
-  void ReadLispError(wxString &data);              //!< read lisp errors (no prompt prefix/suffix)
+  void ReadMath(MaximaOutputBuffer &data);         //!< reads the math that is contained in data
+  /*! Finds the end of the compact frame that starts at start
+
+    \return The position of the frame's last character or wxNOT_FOUND if
+    the frame hasn't been received completely, yet.
+   */
+  int FindCompactFrameEnd(MaximaOutputBuffer &data, int start);
+  void ReadLispError(MaximaOutputBuffer &data);    //!< read lisp errors (no prompt prefix/suffix)
   //! Reads autocompletion templates we get on load of a package
-  void ReadLoadSymbols(wxString &data);
+  void ReadLoadSymbols(MaximaOutputBuffer &data);
 #ifndef __WXMSW__
   //!< reads the output the maxima command sends to stdout
   void ReadProcessOutput();                        
@@ -290,7 +365,11 @@ protected:
   bool OpenWXMFile(wxString file, MathCtrl *document, bool clearDocument = true);
   //! Opens a wxmx file
   bool OpenWXMXFile(wxString file, MathCtrl *document, bool clearDocument = true);
-  GroupCell* CreateTreeFromXMLNode(wxXmlNode *xmlcells, wxString wxmxfilename = wxEmptyString);
+  /*! Creates a tree of GroupCells from the \<cell\> elements a pull parser points at
+
+    On return the parser points at the token after the last cell.
+  */
+  GroupCell* CreateTreeFromXML(XmlPullParser &xml, wxString wxmxfilename = wxEmptyString);
   GroupCell* CreateTreeFromWXMCode(wxArrayString *wxmLines);
   /*! Saves the current file
 
@@ -320,7 +399,8 @@ protected:
   int m_port;
   //! Are we currently saving the file?
   bool m_saving;
-  wxString m_currentOutput;
+  //! The data we got from maxima that hasn't been processed yet.
+  MaximaOutputBuffer m_currentOutput;
   wxString m_promptSuffix;
   wxString m_promptPrefix;
   wxString m_firstPrompt;
@@ -330,6 +410,11 @@ protected:
   wxString m_lastPrompt;
   wxString m_lastPath;
   MathParser m_MParser;
+  /*! The thread that converts maxima's output to cells
+
+    NULL if output is to be parsed in the main thread.
+   */
+  BackgroundParser *m_backgroundParser;
   wxPrintData* m_printData;
   bool m_closing;
   wxString m_openFile;
@@ -377,8 +462,15 @@ public:
 
     \param file The file name
     \param batchmode Do we want to execute the file and save it, but halt on error?
+    \param ioStatisticsFile The file the I/O statistics are written to in batch mode
+   */
+  void NewWindow(wxString file = wxEmptyString,bool batchmode=false,
+                 wxString ioStatisticsFile = wxEmptyString);
+  /*! Loads a file and prints how much memory its cells take
+
+    Is used for checking how the memory a large worksheet needs develops.
    */
-  void NewWindow(wxString file = wxEmptyString,bool batchmode=false);
+  void ReportCellMemory(wxString file);
   //! Is called by atExit and tries to close down the maxima process if wxMaxima has crashed.
   static void Cleanup_Static();
   //! A pointer to the currently running wxMaxima instance
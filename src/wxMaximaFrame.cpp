@@ -44,6 +44,9 @@ wxMaximaFrame::wxMaximaFrame(wxWindow* parent, int id, const wxString& title,
   // history
   m_history = new History(this, -1);
 
+  // The statistics of the communication with maxima
+  m_diagnostics = new DiagnosticsPane(this, -1, m_console->m_ioStatistics);
+
   // The table of contents
   m_console->m_structure = new Structure(this, -1);
 
@@ -300,6 +303,15 @@ void wxMaximaFrame::do_layout()
                     PaneBorder(true).
                     Right());
 
+  m_manager.AddPane(m_diagnostics,
+                    wxAuiPaneInfo().Name(wxT("diagnostics")).
+                    Caption(_("Diagnostics")).
+                    Show(false).
+                    TopDockable(true).
+                    BottomDockable(true).
+                    PaneBorder(true).
+                    Bottom());
+
   m_manager.AddPane(CreateStatPane(),
                     wxAuiPaneInfo().Name(wxT("stats")).
                     Caption(_("Statistics")).
@@ -536,6 +548,7 @@ void wxMaximaFrame::SetupMenu()
   m_Maxima_Panes_Sub->AppendCheckItem(menu_pane_history, _("History\tAlt-Shift-I"));
   m_Maxima_Panes_Sub->AppendCheckItem(menu_pane_structure,  _("Table of contents\tAlt-Shift-T"));
   m_Maxima_Panes_Sub->AppendCheckItem(menu_pane_format, _("Insert Cell\tAlt-Shift-C"));
+  m_Maxima_Panes_Sub->AppendCheckItem(menu_pane_diagnostics, _("Diagnostics"));
   m_Maxima_Panes_Sub->AppendSeparator();
   m_Maxima_Panes_Sub->AppendCheckItem(menu_show_toolbar, _("Toolbar\tAlt-Shift-B"));
   m_MaximaMenu->Append(wxNewId(), _("Panes"), m_Maxima_Panes_Sub);
@@ -997,6 +1010,9 @@ bool wxMaximaFrame::IsPaneDisplayed(Event id)
   case menu_pane_format:
     displayed = m_manager.GetPane(wxT("format")).IsShown();
     break;
+  case menu_pane_diagnostics:
+    displayed = m_manager.GetPane(wxT("diagnostics")).IsShown();
+    break;
   default:
     wxASSERT(false);
     break;
@@ -1026,12 +1042,18 @@ void wxMaximaFrame::ShowPane(Event id, bool show)
   case menu_pane_format:
     m_manager.GetPane(wxT("format")).Show(show);
     break;
+  case menu_pane_diagnostics:
+    m_manager.GetPane(wxT("diagnostics")).Show(show);
+    if (show)
+      m_diagnostics->UpdateDisplay();
+    break;
   case menu_pane_hideall:
     m_manager.GetPane(wxT("math")).Show(false);
     m_manager.GetPane(wxT("history")).Show(false);
     m_manager.GetPane(wxT("structure")).Show(false);
     m_manager.GetPane(wxT("stats")).Show(false);
     m_manager.GetPane(wxT("format")).Show(false);
+    m_manager.GetPane(wxT("diagnostics")).Show(false);
     break;
   default:
     wxASSERT(false);
@@ -34,6 +34,7 @@
 #include "MathCtrl.h"
 #include "Setup.h"
 #include "History.h"
+#include "DiagnosticsPane.h"
 #include "ToolBar.h"
 
 
@@ -77,6 +78,7 @@ public:
     menu_pane_history,		//!< Both the "toggle the history pane" command and the history pane
     menu_pane_structure,       	//!< Both the "toggle the structure pane" command and the structure pane
     menu_pane_format,		//!< Both the "toggle the format pane" command and the format pane
+    menu_pane_diagnostics,	//!< Both the "toggle the diagnostics pane" command and the diagnostics pane
     /*! Both used as the "toggle the stats pane" command and as the ID of the stats pane
 
       Since this enum is also used for iterating over the panes it is vital 
@@ -86,6 +88,7 @@ public:
 
     socket_client_id,
     socket_server_id,
+    background_parser_id,
     input_line_id,
     refresh_id,
     menu_new_id,
@@ -442,6 +445,8 @@ protected:
   MathCtrl*     m_console;
   //! The history pane
   History*      m_history;
+  //! The pane that shows the IOStatistics
+  DiagnosticsPane* m_diagnostics;
   wxArrayString m_recentDocuments;
   wxMenu*       m_recentDocumentsMenu;
 };